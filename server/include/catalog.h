@@ -0,0 +1,141 @@
+/*
+ * OTT Streaming Server - In-Memory Video Catalog
+ *
+ * Immutable snapshot of the videos and genres tables. Readers pin the
+ * current snapshot with catalog_acquire() and never take a lock while
+ * using it; catalog changes (scanner, metadata, HLS status) mark it
+ * stale and the next reader publishes a rebuilt snapshot by swapping
+ * the pointer. Old snapshots are freed when their last reader releases.
+ *
+ * Each snapshot also keeps the JSON of every video object without the
+ * per-user fields, so list responses copy those bytes instead of
+ * formatting each field on every request.
+ *
+ * The title search index is rebuilt with each snapshot, reusing the
+ * previous one when videos were only added.
+ *
+ * View counts change with every new viewer, not with the catalog: they
+ * and the autocomplete trie ranked by them live in a separate ranking
+ * snapshot with its own entity tag. It is reloaded when the catalog
+ * changes and at most every SUGGEST_REFRESH_INTERVAL seconds otherwise.
+ *
+ * Every snapshot carries a hash of its content; responses built only
+ * from the catalog use it as their entity tag (catalog_etag).
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "database.h"
+#include "search_index.h"
+#include "suggest_trie.h"
+#include <time.h>
+
+typedef struct {
+    int genre_id;
+    char name[64];
+    char description[256];
+    int* members;           // Video indexes, ordered by title
+    int member_count;
+} CatalogGenre;
+
+typedef struct Catalog {
+    Video* videos;          // Ordered by video_id
+    int video_count;
+    char* fragments;        // Pre-serialized video objects (json_video_fragment)
+    size_t* fragment_offsets;   // Video i: fragments[offsets[i] .. offsets[i + 1])
+    int* by_title;          // Video indexes, ordered by title
+    SearchIndex* search;    // Title n-gram index (search_index.h)
+    CatalogGenre* genres;   // Ordered by name
+    int genre_count;
+    unsigned long long digest;  // Content hash (video fragments and genre rows)
+    char etag[MAX_ETAG_LEN];    // Entity tag of this snapshot (see catalog_etag)
+    int refcount;           // Pinned readers + 1 while published
+} Catalog;
+
+typedef struct CatalogRanking {
+    const Catalog* catalog; // Snapshot the video indexes refer to (pinned)
+    int* views;             // Per video: watch_history rows (viewers)
+    SuggestTrie* suggest;   // Title prefix trie ranked by views (suggest_trie.h)
+    time_t loaded;          // When the view counts were read
+    char etag[MAX_ETAG_LEN];    // Entity tag of this ranking (catalog digest + view counts)
+    int refcount;           // Pinned readers + 1 while published
+} CatalogRanking;
+
+/**
+ * Pin the current snapshot (rebuilds it first if stale)
+ * @return Snapshot, or NULL if none could be loaded; pair with catalog_release()
+ */
+const Catalog* catalog_acquire(void);
+
+/**
+ * Unpin a snapshot from catalog_acquire()
+ */
+void catalog_release(const Catalog* catalog);
+
+/**
+ * Mark the snapshot out of date (call after changing videos/genres)
+ */
+void catalog_invalidate(void);
+
+/**
+ * Rebuild and publish the snapshot now
+ * @return 0 on success, -1 on failure (the previous snapshot stays current)
+ */
+int catalog_refresh(void);
+
+/**
+ * Entity tag of the current catalog content (rebuilds first if stale)
+ * Derived from the content, so every prefork worker (and a restart)
+ * answers the same tag for the same catalog.
+ * @return 0 on success, -1 if no snapshot could be loaded
+ */
+int catalog_etag(char* out, size_t size);
+
+/**
+ * Pin the current ranking (reloads it first if the catalog changed or
+ * the view counts are older than SUGGEST_REFRESH_INTERVAL)
+ * @return Ranking, or NULL if none could be loaded; pair with catalog_ranking_release()
+ */
+const CatalogRanking* catalog_ranking_acquire(void);
+
+/**
+ * Unpin a ranking from catalog_ranking_acquire()
+ */
+void catalog_ranking_release(const CatalogRanking* ranking);
+
+/**
+ * Entity tag of the current ranking (responses built from view counts)
+ * @return 0 on success, -1 if no ranking could be loaded
+ */
+int catalog_ranking_etag(char* out, size_t size);
+
+/**
+ * Drop the published snapshot and ranking (shutdown)
+ */
+void catalog_cleanup(void);
+
+/**
+ * Free a snapshot that was never published (loader error path)
+ */
+void catalog_destroy(Catalog* catalog);
+
+/**
+ * Index of video_id in catalog->videos
+ * @return Index, or -1 if not found
+ */
+int catalog_video_index(const Catalog* catalog, int video_id);
+
+/**
+ * Pre-serialized video object at index (see json_builder_add_video_fragment)
+ * @param length Set to the fragment length
+ */
+const char* catalog_video_fragment(const Catalog* catalog, int index, size_t* length);
+
+/**
+ * Find a genre by id
+ * @return Genre, or NULL if not found
+ */
+const CatalogGenre* catalog_find_genre(const Catalog* catalog, int genre_id);
+
+#endif // CATALOG_H
@@ -0,0 +1,139 @@
+/*
+ * OTT Streaming Server - Response Compression
+ *
+ * Content-Encoding negotiation (gzip, brotli) for text responses:
+ *   - Static assets (HTML, CSS, JS) are compressed once at startup into
+ *     .gz/.br siblings, which stream_file() sends in place of the original.
+ *   - JSON bodies above COMPRESS_MIN_SIZE are compressed per response;
+ *     bodies with an entity tag are kept in a small cache, so a repeated
+ *     catalog request is answered without building or compressing again.
+ *   - Streamed catalog lists are compressed chunk by chunk as they are
+ *     sent (StreamCompressor); the output is what the cache keeps.
+ *
+ * Videos, HLS segments and images are never compressed (already are).
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+typedef enum {
+    ENCODING_IDENTITY = 0,
+    ENCODING_GZIP = 1,
+    ENCODING_BROTLI = 2
+} ContentEncoding;
+
+// Accept-Encoding bitmask (HTTPRequest.accept_encoding)
+#define ACCEPT_GZIP (1 << ENCODING_GZIP)
+#define ACCEPT_BROTLI (1 << ENCODING_BROTLI)
+
+typedef struct StreamCompressor StreamCompressor;
+
+// Cached compressed body (immutable; refcounted)
+typedef struct CompressedBody {
+    char* key;                  // Entity tag + resource
+    ContentEncoding encoding;
+    size_t length;
+
+    // Internal (owned by compression.c)
+    int refcount;               // Readers + 1 while cached
+    unsigned long last_used;    // LRU clock
+    char data[];                // Body, then the NUL terminated key
+} CompressedBody;
+
+/**
+ * Parse an Accept-Encoding header value ("gzip, deflate, br;q=0.9")
+ * @return ACCEPT_* bitmask (codings with q=0 are excluded)
+ */
+int parse_accept_encoding(const char* value);
+
+/**
+ * Preferred encoding among the accepted ones (brotli, then gzip)
+ */
+ContentEncoding choose_encoding(int accepted);
+
+/**
+ * Content-Encoding token ("gzip", "br"); NULL for identity
+ */
+const char* encoding_name(ContentEncoding encoding);
+
+/**
+ * Whether a file type benefits from compression (text assets only)
+ */
+int is_compressible_file(const char* filename);
+
+/**
+ * Compress a gathered body
+ * @param level zlib level or brotli quality
+ * @param out Set to a malloc'd buffer (caller frees)
+ * @return Compressed length, or 0 on failure
+ */
+size_t compress_iov(ContentEncoding encoding, int level, const struct iovec* iov, int count, char** out);
+
+/**
+ * Start an incremental compression (gzip or brotli)
+ * All output is kept until stream_compressor_free(), for the cache.
+ * @param level zlib level or brotli quality
+ * @return Compressor, or NULL on failure
+ */
+StreamCompressor* stream_compressor_create(ContentEncoding encoding, int level);
+
+/**
+ * Compress the next part of the body
+ * @return 0 on success, -1 on failure
+ */
+int stream_compressor_write(StreamCompressor* compressor, const char* data, size_t length);
+
+/**
+ * End the stream (trailer, last buffered output)
+ * @return 0 on success, -1 on failure
+ */
+int stream_compressor_finish(StreamCompressor* compressor);
+
+/**
+ * Every compressed byte produced so far
+ * @param length Set to the output length
+ */
+const char* stream_compressor_output(const StreamCompressor* compressor, size_t* length);
+
+ContentEncoding stream_compressor_encoding(const StreamCompressor* compressor);
+
+void stream_compressor_free(StreamCompressor* compressor);
+
+/**
+ * Build .gz/.br siblings for the text assets under root
+ * Siblings that are newer than their source are kept.
+ * @return Number of siblings written, or -1 if root cannot be read
+ */
+int compress_static_assets(const char* root);
+
+/**
+ * Pick the precompressed sibling of filename for the accepted encodings
+ * A sibling older than its source is ignored (the source was edited).
+ * @param out Set to the sibling path
+ * @return Encoding of the sibling, or ENCODING_IDENTITY if none applies
+ */
+ContentEncoding find_static_variant(const char* filename, int accepted, char* out, size_t size);
+
+/**
+ * Look up a cached compressed body; pair with compressed_cache_release()
+ * @return Body, or NULL on a miss
+ */
+CompressedBody* compressed_cache_acquire(const char* etag, const char* resource, ContentEncoding encoding);
+
+/**
+ * Cache a compressed body (replaces the least recently used entry)
+ */
+void compressed_cache_store(const char* etag, const char* resource, ContentEncoding encoding,
+                            const char* data, size_t length);
+
+void compressed_cache_release(CompressedBody* body);
+
+/**
+ * Drop all cached bodies (shutdown)
+ */
+void compressed_cache_cleanup(void);
+
+#endif // COMPRESSION_H
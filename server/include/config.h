@@ -16,7 +16,21 @@
 // ============================================================================
 
 #define SERVER_PORT 8080
-#define SERVER_BACKLOG 10           // Listen queue size
+#define SERVER_BACKLOG 128          // Listen queue size
+
+// ============================================================================
+// Event Loop & Worker Pool Configuration
+// ============================================================================
+
+#define EVENT_LOOP_THREADS 0        // epoll loop threads (0 = one per CPU)
+#define EPOLL_MAX_EVENTS 64         // Events returned per epoll_wait()
+#define WORKER_POOL_THREADS 16      // Threads running blocking handlers
+#define WORKER_QUEUE_CAPACITY 1024  // Pending requests before 503
+#define KEEPALIVE_TIMEOUT 5         // Idle seconds before a connection is closed
+#define KEEPALIVE_MAX_REQUESTS 100  // Requests served per connection
+#define SEND_TIMEOUT 30             // Seconds a response may stall before the connection is closed
+#define PREFORK_WORKERS 0           // Worker processes (0 = single process; --workers N)
+#define PREFORK_MAX_WORKERS 64      // Upper bound for --workers
 
 // ============================================================================
 // Buffer Size Constants
@@ -31,6 +45,12 @@
 #define MAX_COMMAND_LEN 1024        // System command buffer
 #define MAX_JSON_BUFFER 8192        // Large JSON response buffer
 #define MAX_JSON_SMALL_BUFFER 512   // Small JSON/string buffer
+#define JSON_ARENA_CHUNK_SIZE 16384 // Growth step of arena JSON builders
+#define JSON_WRITEV_MAX 64          // iovecs per writev() call (header + chunks)
+#define JSON_STREAM_BUFFER 32768    // Streamed list responses: one HTTP chunk per buffer
+#define JSON_VIDEO_FRAGMENT_MAX 2048 // Pre-serialized video object (3 escaped 255-char strings)
+#define JSON_INDEX_MAX_FIELDS 16    // Top-level members of a parsed request body
+#define JSON_MAX_DEPTH 32           // Nesting limit inside a parsed request body
 #define MAX_COOKIE_LEN 256          // Cookie header buffer
 
 // ============================================================================
@@ -40,9 +60,22 @@
 #define SESSION_RANDOM_BYTES 16             // 128 bits of entropy
 #define SESSION_HEX_LENGTH 32               // 16 bytes * 2 hex chars
 #define SESSION_ID_LENGTH 33                // 32 hex chars + null terminator
-#define MAX_SESSIONS 100                    // Maximum concurrent sessions
+#define MAX_SESSIONS 100000                 // Default session capacity (--max-sessions)
+#define SESSION_CAPACITY_LIMIT 16777216     // Upper bound for --max-sessions
+#define SESSION_STRIPES 16                  // Independently locked parts of the table (power of 2)
+#define SESSION_TOUCH_INTERVAL 30           // Refresh last_accessed at most this often (seconds)
 #define SESSION_TIMEOUT 1800                // 30 minutes in seconds
-#define SESSION_CLEANUP_INTERVAL 300        // Cleanup every 5 minutes
+#define SESSION_CLEANUP_INTERVAL 60         // Background sweep period (seconds)
+#define SESSION_SWEEP_BATCH 4096            // Slots swept per stripe lock hold
+#define SESSION_STORE_PATH "../server/database/sessions.bin"  // Session table file (kept across restarts)
+
+// Stateless session tokens (--session-tokens, see session_token.h)
+#define SESSION_COOKIE_LENGTH 136           // Cookie value buffer: session ID or token + null
+#define SESSION_KEY_PATH "../server/database/session.key"  // HMAC key (copy to every node)
+#define SESSION_KEY_BYTES 32                // HMAC-SHA256 key size
+#define SESSION_TOKEN_TAG_BYTES 16          // Truncated HMAC tag (128 bits)
+#define SESSION_REVOKE_BITS 8388608         // Revocation bloom filter bits per generation (power of 2)
+#define SESSION_REVOKE_PATH "../server/database/revoked.bin"  // Revocation filter file (kept across restarts)
 
 // ============================================================================
 // User Authentication Configuration
@@ -58,7 +91,7 @@
 // Random Number Generation
 // ============================================================================
 
-#define MAX_RANDOM_BYTE_VALUE 256   // Random byte range (0-255)
+#define RANDOM_POOL_BYTES 4096      // Per-thread getrandom() batch (256 session IDs)
 #define HEX_CHARS_PER_BYTE 2        // 1 byte = 2 hex characters
 #define HEX_SHIFT_HIGH 4            // Bit shift for high nibble
 
@@ -79,6 +112,19 @@
 #define DB_PATH "../server/database/ott_server.db"
 #define DB_RETRY_COUNT 3            // Number of retries for DB operations
 #define DB_BUSY_TIMEOUT 5000        // SQLite busy timeout (ms)
+#define DB_STMT_CACHE_SIZE 32       // Prepared statements cached per connection
+
+// Storage profile (applied to every connection at open time)
+#define DB_JOURNAL_MODE "WAL"       // Readers no longer block on writers
+#define DB_SYNCHRONOUS "NORMAL"     // fsync at checkpoint only (safe with WAL)
+#define DB_MMAP_SIZE 268435456      // 256MB memory-mapped reads
+#define DB_CACHE_SIZE_KB 8192       // Page cache per connection (KB)
+#define DB_CHECKPOINT_INTERVAL 10   // Background WAL checkpoint period (seconds, 0 = off)
+
+// Watch-progress write-behind buffer
+#define PROGRESS_BUFFER_CAPACITY 1024   // Pending (user, video) positions before a forced flush
+#define PROGRESS_BUFFER_SLOTS 2048      // Hash slots (power of two, > capacity)
+#define PROGRESS_FLUSH_INTERVAL 3       // Background flush period (seconds)
 
 // ============================================================================
 // HTTP Configuration
@@ -95,6 +141,39 @@
 #define DEFAULT_STREAM_CHUNK_SIZE 65536     // 64KB chunks for streaming
 #define MIN_STREAM_CHUNK_SIZE 4096          // Minimum 4KB chunk
 #define MAX_STREAM_CHUNK_SIZE 1048576       // Maximum 1MB chunk
+#define SENDFILE_CHUNK_SIZE 2097152         // 2MB per sendfile() call (zero-copy path)
+#define MAX_RANGE_SPECS 16                  // Ranges per request (more: Range header ignored)
+#define MAX_RANGE_HEADER_LEN 1024           // Range header buffer
+#define MAX_IF_NONE_MATCH_LEN 512           // If-None-Match header buffer (entity tag list)
+#define MAX_ETAG_LEN 64                     // Quoted entity tag
+#define HTTP_DATE_LEN 32                    // IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT")
+#define FILE_CACHE_CAPACITY 256             // Open fds kept by the file cache (LRU)
+#define FILE_CACHE_BUCKETS 512              // Hash buckets (power of 2)
+#define FILE_CACHE_REVALIDATE_SEC 2         // Re-stat() cached paths at most this often
+
+// ============================================================================
+// Search Configuration
+// ============================================================================
+
+#define SEARCH_MAX_RESULTS 50               // Ranked results per /api/search response
+#define SEARCH_MAX_QUERY_CHARS 64           // Code points of a query used for the lookup
+#define SEARCH_MAX_SEGMENTS 8               // Index segments before they are merged into one
+#define SUGGEST_MAX_RESULTS 10              // Completions per /api/search/suggest response
+#define SUGGEST_REFRESH_INTERVAL 30         // Seconds between view count reloads (autocomplete ranking)
+
+// ============================================================================
+// Compression Configuration
+// ============================================================================
+
+#define CLIENT_DIR "../client"              // Static assets (.gz/.br siblings built at startup)
+#define COMPRESS_MIN_SIZE 1024              // Smaller JSON bodies are sent uncompressed
+#define COMPRESS_GZIP_LEVEL 1               // zlib level for per-request JSON (CPU bound)
+#define COMPRESS_BROTLI_QUALITY 2           // Brotli quality for per-request JSON
+#define COMPRESS_CACHED_GZIP_LEVEL 6        // Levels for cached JSON (once per catalog version)
+#define COMPRESS_CACHED_BROTLI_QUALITY 5
+#define COMPRESS_STATIC_GZIP_LEVEL 9        // zlib level for static assets (built once)
+#define COMPRESS_STATIC_BROTLI_QUALITY 11   // Brotli quality for static assets
+#define COMPRESS_CACHE_ENTRIES 64           // Compressed JSON bodies kept by ETag
 
 // ============================================================================
 // JSON Configuration
@@ -184,5 +263,6 @@ typedef enum {
 #define HTTP_409_CONFLICT "HTTP/1.1 409 Conflict\r\n"
 #define HTTP_416_RANGE_NOT_SATISFIABLE "HTTP/1.1 416 Range Not Satisfiable\r\n"
 #define HTTP_500_INTERNAL_ERROR "HTTP/1.1 500 Internal Server Error\r\n"
+#define HTTP_503_SERVICE_UNAVAILABLE "HTTP/1.1 503 Service Unavailable\r\n"
 
 #endif // CONFIG_H
@@ -6,6 +6,9 @@
 // SHA-256 hash output is 64 hex characters + null terminator
 #define SHA256_HEX_LENGTH 65
 
+// HMAC-SHA256 output (binary)
+#define HMAC_SHA256_LENGTH 32
+
 /**
  * Generate SHA-256 hash of input string
  *
@@ -23,4 +26,37 @@ void sha256_hash(const char* input, char* output_hex);
  */
 int verify_password(const char* input_password, const char* stored_hash);
 
+// HMAC-SHA256 key with the padded key blocks already hashed
+typedef struct HmacKey HmacKey;
+
+/**
+ * Prepare an HMAC-SHA256 key (hashes the inner and outer pad once, so each
+ * MAC costs two SHA-256 compressions less than a one-shot HMAC)
+ *
+ * @return Key, or NULL on failure; free with hmac_sha256_key_free()
+ */
+HmacKey* hmac_sha256_key_create(const unsigned char* key, size_t key_len);
+
+/**
+ * Free a key from hmac_sha256_key_create() (NULL is ignored)
+ */
+void hmac_sha256_key_free(HmacKey* key);
+
+/**
+ * Compute HMAC-SHA256 of data (thread-safe: the key is only read)
+ *
+ * @param output Output buffer (HMAC_SHA256_LENGTH bytes)
+ * @return 0 on success, -1 on failure
+ */
+int hmac_sha256(const HmacKey* key, const unsigned char* data, size_t data_len, unsigned char* output);
+
+/**
+ * Check a (possibly truncated) HMAC-SHA256 tag in constant time
+ *
+ * @param tag Expected tag: the first tag_len bytes of the HMAC
+ * @return 1 if match, 0 if no match
+ */
+int hmac_sha256_verify(const HmacKey* key, const unsigned char* data, size_t data_len,
+                       const unsigned char* tag, size_t tag_len);
+
 #endif // CRYPTO_H
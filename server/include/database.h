@@ -2,8 +2,10 @@
 #define DATABASE_H
 
 #include <stddef.h>
+#include <time.h>
 #include <sqlite3.h>
 #include "config.h"
+#include "json_builder.h"
 
 // Database configuration (DB_PATH is in config.h)
 #define SCHEMA_PATH "database/schema.sql"
@@ -28,8 +30,17 @@ typedef struct {
     char hls_status[20];
 } Video;
 
+// One watch-progress update (batched by progress_buffer.c)
+typedef struct {
+    int user_id;
+    int video_id;
+    int position;
+    time_t updated_at;
+} WatchProgress;
+
 // Database initialization and cleanup
 int init_database(const char* db_path);
+int open_database(const char* db_path);     // Open only (no schema/seed), e.g. per worker process
 void close_database(void);
 
 // User authentication functions
@@ -39,7 +50,7 @@ int update_last_login(int user_id);
 
 // Video management functions
 int get_videos_json(char* json_output, size_t max_len);
-int get_videos_with_history(int user_id, char* json_output, size_t max_len);
+int get_videos_with_history(int user_id, JSONBuilder* builder);
 int get_video_by_id(int video_id, Video* video);
 int get_video_by_filename(const char* filename, Video* video);
 int register_video(const char* filename, const char* title, long file_size);
@@ -48,20 +59,22 @@ int update_video_metadata(const char* filename, int duration, const char* thumbn
 // Watch history functions (Phase 3)
 int get_watch_position(int user_id, int video_id);
 int update_watch_position(int user_id, int video_id, int position);
+int update_watch_positions(const WatchProgress* updates, int count);  // One transaction
 int get_video_filename(int video_id, char* filename, size_t max_len);
 int get_watch_history_json(int user_id, int video_id, char* json_output, size_t max_len);
-int get_recommended_videos(int user_id, char* json_output, size_t max_len);
+int get_recommended_videos(int user_id, JSONBuilder* builder);
 
 // Search functions
-int search_videos(const char* query, char* json_output, size_t max_len);
+int search_videos(const char* query, JSONBuilder* builder);
+int get_search_suggestions(const char* prefix, JSONBuilder* builder);
 
 // Genre functions (Enhancement Phase 1)
-int get_genres_json(char* json_output, size_t max_len);
-int get_videos_by_genre(int genre_id, char* json_output, size_t max_len);
+int get_genres_json(JSONBuilder* builder);
+int get_videos_by_genre(int genre_id, JSONBuilder* builder);
 int assign_genre_to_video(int video_id, int genre_id);
 
 // Watchlist functions (Enhancement Phase 1)
-int get_watchlist(int user_id, char* json_output, size_t max_len);
+int get_watchlist(int user_id, JSONBuilder* builder);
 int add_to_watchlist(int user_id, int video_id);
 int remove_from_watchlist(int user_id, int video_id);
 int is_in_watchlist(int user_id, int video_id);
@@ -70,6 +83,11 @@ int is_in_watchlist(int user_id, int video_id);
 int update_hls_path(int video_id, const char* hls_path, const char* status);
 int get_hls_path(int video_id, char* hls_path, size_t max_len);
 
+// Catalog snapshot loader (see catalog.h)
+struct Catalog;
+struct Catalog* load_catalog(void);
+int* load_view_counts(const struct Catalog* catalog);
+
 // Utility functions
 int execute_sql_file(sqlite3* db, const char* filepath);
 
@@ -0,0 +1,25 @@
+/*
+ * OTT Streaming Server - Event Loop
+ *
+ * epoll-based connection handling. One loop thread per CPU accepts
+ * connections and reads requests on non-blocking sockets; complete
+ * requests are handed to the worker pool, which runs the existing
+ * route handlers through dispatch_route().
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "worker_pool.h"
+
+/**
+ * Run event loops on a listening socket (blocks until the process exits)
+ *
+ * @param server_fd Bound, listening socket (switched to non-blocking)
+ * @param num_loops Number of epoll loop threads (0 = one per online CPU)
+ * @param pool Worker pool that executes request handlers
+ * @return -1 if the loops could not be started
+ */
+int event_loop_run(int server_fd, int num_loops, WorkerPool* pool);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,60 @@
+/*
+ * OTT Streaming Server - Open File Cache
+ *
+ * Shared cache of open file descriptors plus size/mtime, keyed by path.
+ * Hot videos, HLS segments and thumbnails are served without a path
+ * lookup per request: entries are refcounted, LRU-evicted and revalidated
+ * against the filesystem (fstat on every hit, stat of the path at most
+ * every FILE_CACHE_REVALIDATE_SEC seconds).
+ *
+ * Cached fds are shared between threads, so readers must use positional
+ * I/O (sendfile() with an offset pointer, pread()) and never lseek().
+ */
+
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include "config.h"
+#include <time.h>
+#include <sys/types.h>
+
+typedef struct FileCacheEntry {
+    int fd;
+    long size;
+    time_t mtime;
+    mode_t mode;
+    dev_t dev;
+    ino_t ino;
+
+    // Internal (owned by file_cache.c)
+    int refcount;
+    int cached;                 // Linked into the table (0 = detached)
+    long long checked_ms;       // Last stat() of the path
+    struct FileCacheEntry* hash_next;
+    struct FileCacheEntry* lru_prev;
+    struct FileCacheEntry* lru_next;
+    char path[MAX_PATH];
+} FileCacheEntry;
+
+/**
+ * Get an open file by path (cache hit or fresh open)
+ * Must be paired with file_cache_release().
+ *
+ * @param path File path
+ * @return Entry (fd/size/mtime/mode/dev/ino valid), or NULL if the file cannot
+ *         be opened or is a directory
+ */
+FileCacheEntry* file_cache_acquire(const char* path);
+
+/**
+ * Drop a reference taken by file_cache_acquire()
+ * The fd is closed once an evicted/invalidated entry is no longer used.
+ */
+void file_cache_release(FileCacheEntry* entry);
+
+/**
+ * Close all idle cached files (entries still in use are closed on release)
+ */
+void file_cache_cleanup(void);
+
+#endif // FILE_CACHE_H
@@ -11,20 +11,71 @@
 #define JSON_H
 
 #include <stddef.h>
+#include "config.h"
+#include "json_builder.h"
+
+// ============================================================================
+// Request Body Parsing
+// ============================================================================
+
+typedef enum {
+    JSON_VALUE_STRING,
+    JSON_VALUE_NUMBER,
+    JSON_VALUE_BOOL,
+    JSON_VALUE_NULL,
+    JSON_VALUE_OBJECT,
+    JSON_VALUE_ARRAY
+} JSONValueType;
+
+// Zero-copy slice of the parsed body (not NUL terminated)
+typedef struct {
+    const char* data;
+    size_t length;
+} JSONView;
+
+// One top-level member
+typedef struct {
+    JSONView key;               // Without quotes, escapes left as is
+    JSONView value;             // Strings: without quotes, escapes left as is;
+                                // objects/arrays: their whole text
+    JSONValueType type;
+} JSONField;
+
+// Flat index of a body's top-level object
+typedef struct {
+    JSONField fields[JSON_INDEX_MAX_FIELDS];
+    int count;
+} JSONIndex;
 
 /**
- * Parse integer value from JSON string
- * Example: parse_json_int("{\"video_id\":123}", "video_id") returns 123
- * Returns: parsed integer value, or -1 on error
+ * Tokenize a JSON object in one pass and index its top-level members
+ * Nested objects and arrays are validated and skipped; views point into
+ * json, which must outlive the index.
+ * Example: json_index_parse(&index, body, strlen(body))
+ * Returns: 0 on success, -1 if json is not an object or has more than
+ *          JSON_INDEX_MAX_FIELDS members
  */
-int parse_json_int(const char* json, const char* key);
+int json_index_parse(JSONIndex* index, const char* json, size_t length);
 
 /**
- * Parse string value from JSON string
- * Example: parse_json_string("{\"title\":\"Test\"}", "title", buffer, size)
- * Returns: 0 on success, -1 on error
+ * Find a top-level member by key
+ * Returns: field, or NULL if absent
  */
-int parse_json_string(const char* json, const char* key, char* output, size_t max_len);
+const JSONField* json_index_find(const JSONIndex* index, const char* key);
+
+/**
+ * Integer value of a number member (a fraction is truncated)
+ * Example: json_index_int(&index, "video_id", -1)
+ * Returns: value, or fallback if absent, not a number or out of int range
+ */
+int json_index_int(const JSONIndex* index, const char* key, int fallback);
+
+/**
+ * Unescaped value of a string member (truncated to max_len - 1 bytes)
+ * Returns: 0 on success, -1 if absent, not a string, badly escaped or
+ *          holding \u0000 (a C string cannot carry it)
+ */
+int json_index_string(const JSONIndex* index, const char* key, char* output, size_t max_len);
 
 /**
  * Send JSON response with HTTP 200 OK header
@@ -32,6 +83,41 @@ int parse_json_string(const char* json, const char* key, char* output, size_t ma
  */
 void send_json_response(int client_fd, const char* json_body);
 
+/**
+ * Send a builder's output with HTTP 200 OK header
+ * Header and chunks go out with writev(), without joining them first.
+ * A stream builder that already flushed ends its chunked response.
+ * Bodies of at least COMPRESS_MIN_SIZE bytes are compressed when the
+ * client accepts gzip or brotli; with builder->etag and builder->resource
+ * set, the compressed body is cached for send_cached_json(). A streamed
+ * body is compressed chunk by chunk only if it is cached that way:
+ * per-user lists are streamed uncompressed.
+ */
+void send_json_builder_response(int client_fd, const JSONBuilder* builder);
+
+/**
+ * Send the cached compressed body of resource at version etag
+ * Returns: 1 if sent, 0 if the client takes no compression or on a miss
+ */
+int send_cached_json(int client_fd, const char* etag, const char* resource);
+
+/**
+ * Report a builder response failure: a JSON error if nothing was sent yet,
+ * otherwise the chunked response is left unterminated and the connection
+ * is closed
+ */
+void send_json_builder_error(int client_fd, const JSONBuilder* builder,
+                             int status_code, const char* error_message);
+
+/**
+ * Flush a stream builder (called by the builder when its buffer is full)
+ * The first flush sends the header with Transfer-Encoding: chunked and
+ * picks the encoding of the whole response.
+ * Returns: 0 if flushed, 1 if nothing was sent (empty, or the client does
+ *          not accept chunked encoding), -1 on write error
+ */
+int json_stream_flush(JSONBuilder* builder);
+
 /**
  * Send JSON error response with specified HTTP status code
  * Example: send_json_error(client_fd, 404, "Video not found")
@@ -41,8 +127,17 @@ void send_json_error(int client_fd, int status_code, const char* error_message);
 /**
  * Escape special characters in string for JSON
  * Handles: ", \, /, \b, \f, \n, \r, \t
- * Returns: 0 on success, -1 if output buffer too small
+ * Returns: 0 on success (truncated if output is too small), -1 on bad arguments
  */
 int json_escape_string(const char* input, char* output, size_t max_len);
 
+/**
+ * Escape length bytes of input without bounds checks
+ * Runs without special characters are found with SSE2/AVX2 (when the
+ * build enables them) and copied in bulk.
+ * @param output Room for 2 * length + 1 bytes
+ * @return Bytes written, excluding the NUL terminator
+ */
+size_t json_escape_bytes(const char* input, size_t length, char* output);
+
 #endif // JSON_H
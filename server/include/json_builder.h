@@ -4,6 +4,18 @@
  * Reusable JSON generation utilities to reduce code duplication
  * and provide safer JSON construction with automatic escaping.
  *
+ * Two modes:
+ *   json_builder_init()        fixed caller buffer, sets the error flag
+ *                              when full
+ *   json_builder_init_arena()  starts in the caller buffer and continues
+ *                              in JSON_ARENA_CHUNK_SIZE heap chunks; the
+ *                              chunk list is sent as is with writev()
+ *                              (send_json_builder_response in json.h)
+ *   json_builder_init_stream() like arena mode, but once the buffer is
+ *                              full it is sent to the client as an
+ *                              HTTP/1.1 chunk and reused, so memory
+ *                              stays constant for any response size
+ *
  * Author: Network Programming Final Project
  * Date: 2025-11-13
  */
@@ -13,13 +25,35 @@
 
 #include <stddef.h>
 
+// Output chunk (arena mode): written bytes are data[0..length)
+typedef struct JSONChunk {
+    struct JSONChunk* next;
+    char* data;
+    size_t length;
+    size_t capacity;
+} JSONChunk;
+
 // JSON Builder state machine
 typedef struct {
-    char* buffer;               // Output buffer
+    char* buffer;               // Output buffer (arena mode: tail chunk)
     size_t capacity;            // Buffer capacity
     size_t offset;              // Current write position
     int element_count;          // Elements in current array/object
     int error;                  // Error flag
+
+    // Arena mode only
+    int growable;               // New chunks are allocated when full
+    JSONChunk first;            // Caller's initial buffer
+    JSONChunk* tail;            // Chunk being written (length synced on growth)
+    size_t sealed;              // Bytes in the chunks before the tail
+
+    // Stream mode only
+    int stream_fd;              // Client socket (-1 = not streaming)
+    size_t streamed;            // Bytes already sent as chunks (0 = header not sent)
+    struct StreamCompressor* compressor;   // Chunks are compressed (NULL = identity)
+
+    const char* etag;           // ETag response header (NULL = none)
+    const char* resource;       // Compressed body cache key with etag (NULL = not cached)
 } JSONBuilder;
 
 // ============================================================================
@@ -34,6 +68,45 @@ typedef struct {
  */
 void json_builder_init(JSONBuilder* builder, char* buffer, size_t capacity);
 
+/**
+ * Initialize a growable builder (arena mode)
+ * Output starts in buffer and continues in heap chunks, so it is never
+ * truncated. Must not be copied; release with json_builder_free().
+ * @param builder Builder instance to initialize
+ * @param buffer First chunk (typically a stack buffer)
+ * @param capacity First chunk size
+ */
+void json_builder_init_arena(JSONBuilder* builder, char* buffer, size_t capacity);
+
+/**
+ * Initialize a streaming builder
+ * Like arena mode, but when the buffer fills, its content is flushed to
+ * client_fd (see json_stream_flush in json.h) instead of growing. Finish
+ * with send_json_builder_response() or send_json_builder_error().
+ * @param builder Builder instance to initialize
+ * @param client_fd Socket the response is written to
+ * @param buffer Reused output buffer
+ * @param capacity Buffer size
+ */
+void json_builder_init_stream(JSONBuilder* builder, int client_fd, char* buffer, size_t capacity);
+
+/**
+ * Free the heap chunks of an arena builder and a stream's compressor
+ * (no-op for fixed builders)
+ */
+void json_builder_free(JSONBuilder* builder);
+
+/**
+ * Bytes written and not yet streamed out
+ */
+size_t json_builder_length(const JSONBuilder* builder);
+
+/**
+ * Drop the buffered output after it has been sent: frees the heap chunks
+ * and restarts at the beginning of the first buffer
+ */
+void json_builder_rewind(JSONBuilder* builder);
+
 /**
  * Check if builder has encountered an error
  * @return 1 if error occurred, 0 otherwise
@@ -42,7 +115,7 @@ int json_builder_has_error(const JSONBuilder* builder);
 
 /**
  * Get remaining buffer space
- * @return Bytes remaining in buffer
+ * @return Bytes remaining in buffer (SIZE_MAX for arena builders)
  */
 size_t json_builder_remaining(const JSONBuilder* builder);
 
@@ -145,6 +218,36 @@ void json_builder_add_video_object(
     int last_position
 );
 
+/**
+ * Serialize the per-user independent part of a video object, the same
+ * bytes json_builder_add_video_object() writes up to file_size:
+ * {"video_id":1,"title":"...",...,"file_size":123  (no closing brace)
+ * @param output Destination (JSON_VIDEO_FRAGMENT_MAX bytes fit any video)
+ * @return Fragment length, or -1 if output is too small
+ */
+int json_video_fragment(
+    char* output,
+    size_t max_len,
+    int video_id,
+    const char* title,
+    const char* filename,
+    const char* thumbnail,
+    int duration,
+    long file_size
+);
+
+/**
+ * Add a video object from a fragment of json_video_fragment(), appending
+ * only the per-user fields (output equals json_builder_add_video_object)
+ */
+void json_builder_add_video_fragment(
+    JSONBuilder* builder,
+    const char* fragment,
+    size_t length,
+    int watched,
+    int last_position
+);
+
 /**
  * Start a named array field: "key":[
  */
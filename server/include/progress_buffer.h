@@ -0,0 +1,69 @@
+/*
+ * OTT Streaming Server - Watch Progress Write-Behind Buffer
+ *
+ * The player posts its position every few seconds. Instead of one SQLite
+ * transaction per post, updates are coalesced in memory per
+ * (user_id, video_id) and written in one transaction every
+ * PROGRESS_FLUSH_INTERVAL seconds or once PROGRESS_BUFFER_CAPACITY
+ * entries are pending.
+ *
+ * Reads overlay the buffered positions on the watch_history rows, so a
+ * user sees their latest position without forcing a flush. The buffer is
+ * shared by the prefork workers: an update posted to one worker is seen
+ * by all of them.
+ */
+
+#ifndef PROGRESS_BUFFER_H
+#define PROGRESS_BUFFER_H
+
+#include "database.h"
+
+/**
+ * Map the shared buffer (call before forking prefork workers)
+ * @return 0 on success, -1 on failure
+ */
+int progress_buffer_create(void);
+
+/**
+ * Start this process's background flusher (call after the database is open)
+ * Maps the buffer first if progress_buffer_create() was not called.
+ * @return 0 on success, -1 on failure
+ */
+int progress_buffer_init(void);
+
+/**
+ * Record a watch position (replaces any pending value for the same video)
+ * @return 0 on success, -1 if the update could not be stored
+ */
+int progress_buffer_update(int user_id, int video_id, int position);
+
+/**
+ * Buffered position of one video (pending or being written)
+ * Read it before querying watch_history: an entry leaves the buffer only
+ * after its row has committed.
+ * @return 1 if buffered (position set), 0 otherwise
+ */
+int progress_buffer_lookup(int user_id, int video_id, int* position);
+
+/**
+ * Copy every buffered entry of one user (newest per video)
+ * Same ordering rule as progress_buffer_lookup().
+ * @param entries Set to a malloc()ed array (NULL if none); free() it
+ * @return Number of entries, or -1 on allocation failure
+ */
+int progress_buffer_user_entries(int user_id, WatchProgress** entries);
+
+/**
+ * Write all pending updates now
+ * Waits for a batch another thread or worker is writing (or takes it
+ * over if that worker died).
+ * @return 0 on success, -1 if the batch could not be written
+ */
+int progress_buffer_flush(void);
+
+/**
+ * Stop the flusher and write everything still pending (SIGTERM path)
+ */
+void progress_buffer_shutdown(void);
+
+#endif // PROGRESS_BUFFER_H
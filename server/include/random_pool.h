@@ -0,0 +1,24 @@
+/*
+ * OTT Streaming Server - Buffered Secure Random Bytes
+ *
+ * Session IDs, token nonces and ETag tags draw from a per-thread pool of
+ * RANDOM_POOL_BYTES kernel random bytes, refilled with one getrandom()
+ * call when it runs out: a login costs a memcpy instead of opening and
+ * reading /dev/urandom. Handed-out bytes are wiped from the pool, and a
+ * forked child discards the pool it inherited, so prefork workers never
+ * hand out the same bytes.
+ */
+
+#ifndef RANDOM_POOL_H
+#define RANDOM_POOL_H
+
+#include <stddef.h>
+
+/**
+ * Fill out with length cryptographically secure random bytes
+ * Requests larger than a quarter of the pool bypass it.
+ * @return 0 on success, -1 if the kernel cannot supply random bytes
+ */
+int random_bytes(void* out, size_t length);
+
+#endif // RANDOM_POOL_H
@@ -70,6 +70,7 @@ void handle_get_watch_history(int client_fd, HTTPRequest* req, const char* sessi
 void handle_post_logout(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
 void handle_get_recommendations(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
 void handle_get_search(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
+void handle_get_search_suggest(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
 void handle_get_genres(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
 void handle_get_genre_videos(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
 void handle_get_watchlist(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer);
@@ -0,0 +1,52 @@
+/*
+ * OTT Streaming Server - Title Search Index
+ *
+ * In-memory inverted index from character n-grams to video ids, built
+ * with each catalog snapshot. Titles are split into Unicode code points
+ * (ASCII lowercased), so a Hangul syllable counts as one character: "머니"
+ * is a single bigram, just like "ab". Queries return the best matches
+ * (ranked) plus the total number of titles that contain the query.
+ *
+ * The index is made of immutable, refcounted segments. A snapshot that
+ * only adds videos shares the previous snapshot's segments and indexes
+ * just the new titles.
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+struct Catalog;
+
+typedef struct SearchIndex SearchIndex;
+
+typedef struct {
+    int index;              // Video index in the catalog snapshot
+    int score;              // Higher is better
+} SearchHit;
+
+/**
+ * Index the titles of a snapshot
+ * @param previous Index of the previous snapshot (NULL = none): its
+ *                 segments are reused if none of their titles changed
+ * @return Index, or NULL on allocation failure
+ */
+SearchIndex* search_index_build(const struct Catalog* catalog, const SearchIndex* previous);
+
+/**
+ * Free an index (shared segments are freed with their last index)
+ */
+void search_index_free(SearchIndex* index);
+
+/**
+ * Find titles containing query (case-insensitive for ASCII)
+ * Ranking: exact title, then title prefix, then word prefix, then any
+ * substring; shorter titles and earlier matches first within each.
+ *
+ * @param hits Set to the best matches, best first
+ * @param total Set to the number of matching titles
+ * @return Number of hits written (at most max_hits)
+ */
+int search_index_query(const SearchIndex* index, const struct Catalog* catalog, const char* query,
+                       SearchHit* hits, int max_hits, int* total);
+
+#endif // SEARCH_INDEX_H
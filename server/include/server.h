@@ -22,24 +22,41 @@
 #define PORT SERVER_PORT
 #define DB_PATH "../server/database/ott_server.db"
 
-// Range request structure
+// One byte range spec (start == -1: last `end` bytes, end == -1: to end of file)
 typedef struct {
     long start;
     long end;
+} ByteRange;
+
+// Range request structure (one or more specs, RFC 7233)
+typedef struct {
     int has_range;
+    int count;
+    ByteRange specs[MAX_RANGE_SPECS];
 } Range;
 
+// Conditional request validators (RFC 7232)
+typedef struct {
+    char if_none_match[MAX_IF_NONE_MATCH_LEN];  // Entity tag list ("" = absent)
+    time_t if_modified_since;                   // 0 = absent or not a valid date
+} Conditional;
+
 // HTTP request structure
 typedef struct {
     char method[16];
     char path[MAX_PATH];
+    char query[MAX_PATH];       // Raw query string, without '?' ("" = none)
     char version[16];
     Range range;
+    Conditional conditional;
+    int accept_encoding;        // ACCEPT_* bitmask (compression.h)
+    int user_id;                // Session user (-1 = no valid session), set by the event loop
+    char username[USER_ID_LENGTH];
 } HTTPRequest;
 
-// Session structure
+// Session structure (one slot of the shared hash table, see session.c)
 typedef struct {
-    char session_id[SESSION_ID_LENGTH];
+    unsigned char key[SESSION_RANDOM_BYTES];   // Session ID, binary (the cookie carries it as hex)
     int user_id;           // Changed to INT for DB integration
     char username[USER_ID_LENGTH];
     time_t created_at;
@@ -52,22 +69,42 @@ typedef struct {
 // http.c
 HTTPRequest parse_http_request(const char* request);
 int find_header(const char* request, const char* header_name, char* value, size_t value_size);
+int get_query_param(const HTTPRequest* req, const char* name, char* value, size_t value_size);
 const char* get_mime_type(const char* filename);
+int request_wants_keep_alive(const HTTPRequest* req, const char* request);
+void http_set_keep_alive(int enabled);
+int http_keep_alive(void);
+const char* http_connection_header(void);
+void http_set_chunked(int enabled);
+int http_chunked(void);
+void http_set_accept_encoding(int accepted);
+int http_accept_encoding(void);
 // is_path_safe() moved to validation.h
 void send_404(int client_fd);
 void send_403(int client_fd, const char* reason);
+void send_503(int client_fd);
+int http_format_validators(char* out, size_t size, const char* etag, time_t last_modified);
+int http_not_modified(const Conditional* cond, const char* etag, time_t last_modified);
+void send_304(int client_fd, const char* etag, time_t last_modified, int vary);
 
 // streaming.c
+typedef struct FileTransfer FileTransfer;
 Range parse_range(const char* range_header);
-void stream_file(int client_fd, const char* filename, Range range);
+void stream_file(int client_fd, const char* filename, const HTTPRequest* req);
 long get_file_size(const char* filename);
+FileTransfer* stream_take_transfer(void);
+int file_transfer_send(FileTransfer* transfer, int client_fd);
+void file_transfer_free(FileTransfer* transfer);
 
 // session.c
-void init_session_store();
+void init_session_store(int max_sessions, const char* path);
 void cleanup_session_store();
-void generate_session_id(char* session_id);
+int session_sweeper_start();
+void session_sweeper_stop();
+int generate_session_id(char* session_id);
 int create_session(int user_id, const char* username, char* session_id_out, size_t session_id_size);
 int validate_session(const char* session_id);
+int session_lookup(const char* session_id, int* user_id, char* username, size_t username_size);
 void refresh_session(const char* session_id);
 void destroy_session(const char* session_id);
 void cleanup_expired_sessions();
@@ -0,0 +1,65 @@
+/*
+ * OTT Streaming Server - Stateless Session Tokens
+ *
+ * Optional auth mode (--session-tokens): instead of an ID into the shared
+ * session table, the cookie carries the session itself, signed with
+ * HMAC-SHA256:
+ *
+ *   base64url( version | expires | user_id | nonce | name length | username | tag )
+ *
+ * Verifying a token is CPU work only, so any worker (or any node that has
+ * the same key file) accepts it without consulting shared state. Tokens
+ * expire SESSION_TIMEOUT after login (absolute, not idle time).
+ *
+ * Logout adds the token's tag to a revocation bloom filter shared by the
+ * processes of this server and kept in a file, so a restart does not
+ * accept logged-out tokens again; other nodes accept a logged-out token
+ * until it expires. A false positive logs a user out early.
+ */
+
+#ifndef SESSION_TOKEN_H
+#define SESSION_TOKEN_H
+
+#include <stddef.h>
+
+/**
+ * Load the signing key (created on first use) and map the revocation filter
+ * Call once before forking prefork workers.
+ * @param key_path Key file (SESSION_KEY_BYTES random bytes, mode 0600)
+ * @param filter_path Revocation filter file (kept across restarts), or
+ *                    NULL for anonymous shared memory
+ * @return 0 on success, -1 on failure
+ */
+int session_token_init(const char* key_path, const char* filter_path);
+
+/**
+ * Unmap the revocation filter and forget the key
+ */
+void session_token_cleanup(void);
+
+/**
+ * Whether session_token_init() succeeded (token mode is on)
+ */
+int session_token_enabled(void);
+
+/**
+ * Issue a token for a logged-in user
+ * @param out Token (at least SESSION_COOKIE_LENGTH bytes)
+ * @return 0 on success, -1 on failure
+ */
+int session_token_issue(int user_id, const char* username, char* out, size_t out_size);
+
+/**
+ * Check signature, expiry and revocation of a token
+ * @param user_id Set to the token's user (may be NULL)
+ * @param username Set to the token's username (may be NULL)
+ * @return 1 if valid, 0 otherwise
+ */
+int session_token_verify(const char* token, int* user_id, char* username, size_t username_size);
+
+/**
+ * Revoke a token (logout); invalid tokens are ignored
+ */
+void session_token_revoke(const char* token);
+
+#endif // SESSION_TOKEN_H
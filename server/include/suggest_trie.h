@@ -0,0 +1,47 @@
+/*
+ * OTT Streaming Server - Title Autocomplete Trie
+ *
+ * Radix trie over normalized titles (ASCII lowercased, whitespace runs
+ * collapsed to one space), built with each catalog snapshot. Every node
+ * stores the most popular titles below it, so a lookup walks the prefix
+ * and copies a ready list: no subtree traversal, no sorting.
+ *
+ * The whole trie (nodes, ranked lists, edge labels) is one allocation.
+ */
+
+#ifndef SUGGEST_TRIE_H
+#define SUGGEST_TRIE_H
+
+#include <stddef.h>
+
+struct Catalog;
+
+typedef struct SuggestTrie SuggestTrie;
+
+/**
+ * Build the trie of a snapshot's titles
+ * Popularity is views (watch_history rows per video, indexed like
+ * catalog->videos); ties go to the title that sorts first (bytewise,
+ * normalized).
+ * @return Trie, or NULL on allocation failure
+ */
+SuggestTrie* suggest_trie_build(const struct Catalog* catalog, const int* views);
+
+/**
+ * Free a trie
+ */
+void suggest_trie_free(SuggestTrie* trie);
+
+/**
+ * Most popular titles starting with prefix (normalized like the titles)
+ * @param videos Set to catalog video indexes, most popular first
+ * @return Number of videos written (at most max_results and SUGGEST_MAX_RESULTS)
+ */
+int suggest_trie_lookup(const SuggestTrie* trie, const char* prefix, int* videos, int max_results);
+
+/**
+ * Bytes used by the trie allocation
+ */
+size_t suggest_trie_size(const SuggestTrie* trie);
+
+#endif // SUGGEST_TRIE_H
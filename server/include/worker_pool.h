@@ -0,0 +1,43 @@
+/*
+ * OTT Streaming Server - Worker Thread Pool
+ *
+ * Bounded pool of threads for blocking work (SQLite queries, file I/O,
+ * route handlers) so that event loop threads never block.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// Job function executed on a worker thread
+typedef void (*WorkerJob)(void* arg);
+
+// Opaque pool handle (defined in worker_pool.c)
+typedef struct WorkerPool WorkerPool;
+
+/**
+ * Create worker pool and start its threads
+ *
+ * @param num_threads Number of worker threads
+ * @param queue_capacity Maximum number of pending jobs
+ * @return Pool instance, or NULL on failure
+ */
+WorkerPool* worker_pool_create(int num_threads, int queue_capacity);
+
+/**
+ * Queue a job for execution on a worker thread
+ * Never blocks: fails immediately when the queue is full.
+ *
+ * @param pool Worker pool
+ * @param job Function to run
+ * @param arg Argument passed to job
+ * @return 0 on success, -1 if the queue is full or the pool is stopping
+ */
+int worker_pool_submit(WorkerPool* pool, WorkerJob job, void* arg);
+
+/**
+ * Stop accepting jobs, run the ones already queued, join all threads
+ * and free the pool
+ */
+void worker_pool_destroy(WorkerPool* pool);
+
+#endif // WORKER_POOL_H
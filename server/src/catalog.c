@@ -0,0 +1,426 @@
+/*
+ * OTT Streaming Server - In-Memory Video Catalog
+ *
+ * RCU-style publication: `current` points at an immutable snapshot.
+ * publish_lock only covers loading that pointer and taking a reference
+ * (a few instructions); all catalog reads happen without it. Rebuilds
+ * are serialized by rebuild_lock and run outside publish_lock, so
+ * readers keep using the old snapshot until the new one is swapped in.
+ *
+ * The ranking (view counts and autocomplete trie) is published the same
+ * way under ranking_lock. It pins the snapshot its indexes refer to, so
+ * a ranking stays usable after the catalog moves on.
+ */
+
+#include "../include/catalog.h"
+#include "../include/json_builder.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+static Catalog* current = NULL;
+static volatile int stale = 1;              // Catalog tables changed since the last load
+
+static CatalogRanking* ranking = NULL;
+
+static pthread_mutex_t publish_lock = PTHREAD_MUTEX_INITIALIZER;    // current and ranking pointers
+static pthread_mutex_t rebuild_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ranking_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Snapshot Lifetime
+// ============================================================================
+
+void catalog_destroy(Catalog* catalog) {
+    if (!catalog) {
+        return;
+    }
+
+    for (int i = 0; i < catalog->genre_count; i++) {
+        free(catalog->genres[i].members);
+    }
+    free(catalog->genres);
+    search_index_free(catalog->search);
+    free(catalog->fragment_offsets);
+    free(catalog->fragments);
+    free(catalog->by_title);
+    free(catalog->videos);
+    free(catalog);
+}
+
+static Catalog* pin_current(void) {
+    pthread_mutex_lock(&publish_lock);
+    Catalog* catalog = current;
+    if (catalog) {
+        __sync_add_and_fetch(&catalog->refcount, 1);
+    }
+    pthread_mutex_unlock(&publish_lock);
+    return catalog;
+}
+
+static void publish(Catalog* catalog) {
+    pthread_mutex_lock(&publish_lock);
+    Catalog* old = current;
+    current = catalog;
+    pthread_mutex_unlock(&publish_lock);
+
+    // Drop the published reference; pinned readers keep it alive
+    catalog_release(old);
+}
+
+static void ranking_destroy(CatalogRanking* snapshot) {
+    suggest_trie_free(snapshot->suggest);
+    free(snapshot->views);
+    catalog_release(snapshot->catalog);
+    free(snapshot);
+}
+
+static CatalogRanking* pin_ranking(void) {
+    pthread_mutex_lock(&publish_lock);
+    CatalogRanking* snapshot = ranking;
+    if (snapshot) {
+        __sync_add_and_fetch(&snapshot->refcount, 1);
+    }
+    pthread_mutex_unlock(&publish_lock);
+    return snapshot;
+}
+
+static void publish_ranking(CatalogRanking* snapshot) {
+    pthread_mutex_lock(&publish_lock);
+    CatalogRanking* old = ranking;
+    ranking = snapshot;
+    pthread_mutex_unlock(&publish_lock);
+
+    catalog_ranking_release(old);
+}
+
+/**
+ * Serialize the static part of every video object into one buffer
+ * Returns: 0 on success, -1 on allocation failure
+ */
+static int build_fragments(Catalog* catalog) {
+    size_t capacity = (size_t)catalog->video_count * 256 + 1;
+    size_t used = 0;
+
+    catalog->fragments = malloc(capacity);
+    catalog->fragment_offsets = malloc((catalog->video_count + 1) * sizeof(size_t));
+    if (!catalog->fragments || !catalog->fragment_offsets) {
+        return -1;
+    }
+
+    char fragment[JSON_VIDEO_FRAGMENT_MAX];
+    for (int i = 0; i < catalog->video_count; i++) {
+        const Video* video = &catalog->videos[i];
+        int length = json_video_fragment(fragment, sizeof(fragment), video->video_id,
+                                         video->title, video->filename, video->thumbnail_path,
+                                         video->duration, video->file_size);
+        if (length < 0) {
+            return -1;
+        }
+
+        if (used + length > capacity) {
+            capacity = (used + length) * 2;
+            char* grown = realloc(catalog->fragments, capacity);
+            if (!grown) {
+                return -1;
+            }
+            catalog->fragments = grown;
+        }
+
+        memcpy(catalog->fragments + used, fragment, length);
+        catalog->fragment_offsets[i] = used;
+        used += length;
+    }
+    catalog->fragment_offsets[catalog->video_count] = used;
+
+    return 0;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;   // FNV-1a
+    }
+    return hash;
+}
+
+/**
+ * Hash of everything catalog-tagged responses are built from: the video
+ * fragments and the genre rows. Every prefork worker (and a restart)
+ * derives the same tag for the same content.
+ */
+static uint64_t catalog_digest(const Catalog* catalog) {
+    uint64_t hash = 14695981039346656037ULL;
+    hash = hash_bytes(hash, catalog->fragment_offsets,
+                      (catalog->video_count + 1) * sizeof(size_t));
+    hash = hash_bytes(hash, catalog->fragments, catalog->fragment_offsets[catalog->video_count]);
+
+    for (int i = 0; i < catalog->genre_count; i++) {
+        const CatalogGenre* genre = &catalog->genres[i];
+        hash = hash_bytes(hash, &genre->genre_id, sizeof(genre->genre_id));
+        hash = hash_bytes(hash, genre->name, strlen(genre->name) + 1);
+        hash = hash_bytes(hash, genre->description, strlen(genre->description) + 1);
+        hash = hash_bytes(hash, &genre->member_count, sizeof(genre->member_count));
+        hash = hash_bytes(hash, genre->members, genre->member_count * sizeof(int));
+    }
+    return hash;
+}
+
+static void format_etag(char* out, size_t size, char kind, uint64_t digest) {
+    snprintf(out, size, "\"%c%016llx\"", kind, (unsigned long long)digest);
+}
+
+/**
+ * Load a new snapshot from the database and publish it
+ * Caller holds rebuild_lock.
+ */
+static int reload_locked(void) {
+    // Cleared first: a change committed during the load marks it stale again
+    stale = 0;
+    __sync_synchronize();
+
+    Catalog* catalog = load_catalog();
+    if (!catalog) {
+        fprintf(stderr, "⚠️  Failed to load video catalog\n");
+        return -1;
+    }
+
+    if (build_fragments(catalog) != 0) {
+        fprintf(stderr, "⚠️  Failed to serialize video catalog\n");
+        catalog_destroy(catalog);
+        return -1;
+    }
+
+    // Only rebuilders replace `current`, so its index is stable here
+    catalog->search = search_index_build(catalog, current ? current->search : NULL);
+    if (!catalog->search) {
+        fprintf(stderr, "⚠️  Failed to index video titles\n");
+        catalog_destroy(catalog);
+        return -1;
+    }
+
+    catalog->digest = catalog_digest(catalog);
+    format_etag(catalog->etag, sizeof(catalog->etag), 'c', catalog->digest);
+    catalog->refcount = 1;
+    publish(catalog);
+
+    printf("✓ Video catalog loaded: %d videos, %d genres\n",
+           catalog->video_count, catalog->genre_count);
+    return 0;
+}
+
+/**
+ * Rebuild if still needed
+ * @param wait Block on a concurrent rebuild (otherwise keep the old snapshot)
+ */
+static int rebuild(int wait) {
+    if (wait) {
+        pthread_mutex_lock(&rebuild_lock);
+    } else if (pthread_mutex_trylock(&rebuild_lock) != 0) {
+        return 0;
+    }
+
+    // Only rebuilders change `current`, so it is stable under rebuild_lock
+    int result = 0;
+    if (stale || !current) {
+        result = reload_locked();
+    }
+
+    pthread_mutex_unlock(&rebuild_lock);
+    return result;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+const Catalog* catalog_acquire(void) {
+    if (stale) {
+        rebuild(0);
+    }
+
+    Catalog* catalog = pin_current();
+    if (!catalog && rebuild(1) == 0) {
+        catalog = pin_current();
+    }
+    return catalog;
+}
+
+void catalog_release(const Catalog* catalog) {
+    Catalog* snapshot = (Catalog*)catalog;
+    if (snapshot && __sync_sub_and_fetch(&snapshot->refcount, 1) == 0) {
+        catalog_destroy(snapshot);
+    }
+}
+
+void catalog_invalidate(void) {
+    stale = 1;
+    __sync_synchronize();
+}
+
+int catalog_etag(char* out, size_t size) {
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
+        return -1;
+    }
+
+    snprintf(out, size, "%s", catalog->etag);
+    catalog_release(catalog);
+    return 0;
+}
+
+int catalog_refresh(void) {
+    pthread_mutex_lock(&rebuild_lock);
+    int result = reload_locked();
+    pthread_mutex_unlock(&rebuild_lock);
+    return result;
+}
+
+void catalog_cleanup(void) {
+    pthread_mutex_lock(&ranking_lock);
+    publish_ranking(NULL);
+    pthread_mutex_unlock(&ranking_lock);
+
+    pthread_mutex_lock(&rebuild_lock);
+    publish(NULL);
+    stale = 1;
+    pthread_mutex_unlock(&rebuild_lock);
+}
+
+// ============================================================================
+// Ranking
+// ============================================================================
+
+/**
+ * Whether a ranking is built on catalog and its view counts are recent
+ */
+static int ranking_is_current(const CatalogRanking* snapshot, const Catalog* catalog) {
+    return snapshot && snapshot->catalog == catalog &&
+           time(NULL) - snapshot->loaded < SUGGEST_REFRESH_INTERVAL;
+}
+
+/**
+ * Read the view counts of catalog and publish a new ranking
+ * Caller holds ranking_lock; the ranking takes over the caller's pin.
+ */
+static int reload_ranking_locked(const Catalog* catalog) {
+    CatalogRanking* snapshot = calloc(1, sizeof(CatalogRanking));
+    if (!snapshot) {
+        catalog_release(catalog);
+        return -1;
+    }
+
+    snapshot->catalog = catalog;
+    snapshot->loaded = time(NULL);
+    snapshot->views = load_view_counts(catalog);
+    snapshot->suggest = snapshot->views ? suggest_trie_build(catalog, snapshot->views) : NULL;
+    if (!snapshot->suggest) {
+        fprintf(stderr, "⚠️  Failed to build title autocomplete\n");
+        ranking_destroy(snapshot);
+        return -1;
+    }
+
+    // Same catalog and view counts in every worker give the same tag
+    uint64_t digest = hash_bytes(catalog->digest, snapshot->views,
+                                 catalog->video_count * sizeof(int));
+    format_etag(snapshot->etag, sizeof(snapshot->etag), 'r', digest);
+    snapshot->refcount = 1;
+    publish_ranking(snapshot);
+    return 0;
+}
+
+const CatalogRanking* catalog_ranking_acquire(void) {
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
+        return NULL;
+    }
+
+    CatalogRanking* pinned = pin_ranking();
+    if (ranking_is_current(pinned, catalog)) {
+        catalog_release(catalog);
+        return pinned;
+    }
+
+    // One caller reloads; the others keep the old ranking meanwhile
+    if (!pinned) {
+        pthread_mutex_lock(&ranking_lock);
+    } else if (pthread_mutex_trylock(&ranking_lock) != 0) {
+        catalog_release(catalog);
+        return pinned;
+    }
+
+    // Only reloaders change `ranking`, so it is stable under ranking_lock
+    if (ranking_is_current(ranking, catalog)) {
+        catalog_release(catalog);
+    } else {
+        reload_ranking_locked(catalog);
+    }
+    pthread_mutex_unlock(&ranking_lock);
+
+    // A failed reload leaves the old ranking (if any) published
+    CatalogRanking* latest = pin_ranking();
+    catalog_ranking_release(pinned);
+    return latest;
+}
+
+void catalog_ranking_release(const CatalogRanking* snapshot) {
+    CatalogRanking* pinned = (CatalogRanking*)snapshot;
+    if (pinned && __sync_sub_and_fetch(&pinned->refcount, 1) == 0) {
+        ranking_destroy(pinned);
+    }
+}
+
+int catalog_ranking_etag(char* out, size_t size) {
+    const CatalogRanking* snapshot = catalog_ranking_acquire();
+    if (!snapshot) {
+        return -1;
+    }
+
+    snprintf(out, size, "%s", snapshot->etag);
+    catalog_ranking_release(snapshot);
+    return 0;
+}
+
+// ============================================================================
+// Lookups
+// ============================================================================
+
+int catalog_video_index(const Catalog* catalog, int video_id) {
+    int low = 0;
+    int high = catalog->video_count - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int id = catalog->videos[mid].video_id;
+        if (id == video_id) {
+            return mid;
+        }
+        if (id < video_id) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+const char* catalog_video_fragment(const Catalog* catalog, int index, size_t* length) {
+    size_t start = catalog->fragment_offsets[index];
+    *length = catalog->fragment_offsets[index + 1] - start;
+    return catalog->fragments + start;
+}
+
+const CatalogGenre* catalog_find_genre(const Catalog* catalog, int genre_id) {
+    // Few genres: linear scan (the array is ordered by name, not id)
+    for (int i = 0; i < catalog->genre_count; i++) {
+        if (catalog->genres[i].genre_id == genre_id) {
+            return &catalog->genres[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,622 @@
+/*
+ * OTT Streaming Server - Response Compression
+ *
+ * gzip (zlib) and brotli encoders over gathered buffers, the startup pass
+ * that writes precompressed static assets, and the cache of compressed
+ * JSON bodies. The cache is a small array guarded by one mutex; bodies
+ * are refcounted, so an evicted body stays valid until its last send.
+ */
+
+#define _GNU_SOURCE  // nftw(), strncasecmp()
+
+#include "../include/compression.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <brotli/encode.h>
+
+static CompressedBody* cache[COMPRESS_CACHE_ENTRIES];
+static unsigned long cache_clock = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Negotiation
+// ============================================================================
+
+int parse_accept_encoding(const char* value) {
+    int accepted = 0;
+    const char* p = value;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+
+        const char* name = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        size_t length = p - name;
+
+        // Only the q parameter matters: q=0 means "not acceptable"
+        const char* end = strchr(p, ',');
+        if (!end) {
+            end = p + strlen(p);
+        }
+        double q = 1.0;
+        for (const char* param = p; param + 1 < end; param++) {
+            if ((param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = strtod(param + 2, NULL);
+                break;
+            }
+        }
+
+        if (q > 0) {
+            if ((length == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+                (length == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+                accepted |= ACCEPT_GZIP;
+            } else if (length == 2 && strncasecmp(name, "br", 2) == 0) {
+                accepted |= ACCEPT_BROTLI;
+            } else if (length == 1 && *name == '*') {
+                accepted |= ACCEPT_GZIP | ACCEPT_BROTLI;
+            }
+        }
+
+        p = end;
+    }
+
+    return accepted;
+}
+
+ContentEncoding choose_encoding(int accepted) {
+    // Brotli: about 15-20% smaller than gzip on HTML/JSON
+    if (accepted & ACCEPT_BROTLI) {
+        return ENCODING_BROTLI;
+    }
+    if (accepted & ACCEPT_GZIP) {
+        return ENCODING_GZIP;
+    }
+    return ENCODING_IDENTITY;
+}
+
+const char* encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ENCODING_GZIP: return "gzip";
+        case ENCODING_BROTLI: return "br";
+        default: return NULL;
+    }
+}
+
+static const char* encoding_suffix(ContentEncoding encoding) {
+    return encoding == ENCODING_BROTLI ? ".br" : ".gz";
+}
+
+int is_compressible_file(const char* filename) {
+    static const char* extensions[] = {".html", ".css", ".js", ".json", ".svg", ".txt"};
+
+    const char* ext = strrchr(filename, '.');
+    if (!ext) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+        if (strcmp(ext, extensions[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Encoders
+// ============================================================================
+
+static size_t total_length(const struct iovec* iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+static size_t gzip_iov(int level, const struct iovec* iov, int count, char** out) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    // windowBits 15 + 16: gzip header and trailer instead of zlib's
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return 0;
+    }
+
+    size_t capacity = deflateBound(&stream, total_length(iov, count));
+    char* buffer = malloc(capacity);
+    if (!buffer) {
+        deflateEnd(&stream);
+        return 0;
+    }
+
+    stream.next_out = (Bytef*)buffer;
+    stream.avail_out = capacity;
+
+    int result = Z_OK;
+    for (int i = 0; i < count && result == Z_OK; i++) {
+        stream.next_in = (Bytef*)iov[i].iov_base;
+        stream.avail_in = iov[i].iov_len;
+        result = deflate(&stream, Z_NO_FLUSH);
+    }
+    if (result == Z_OK) {
+        result = deflate(&stream, Z_FINISH);
+    }
+
+    size_t length = stream.total_out;
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END) {
+        free(buffer);
+        return 0;
+    }
+
+    *out = buffer;
+    return length;
+}
+
+static size_t brotli_iov(int quality, const struct iovec* iov, int count, char** out) {
+    size_t total = total_length(iov, count);
+    size_t capacity = BrotliEncoderMaxCompressedSize(total);
+    if (capacity == 0) {
+        return 0;
+    }
+
+    BrotliEncoderState* state = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    char* buffer = malloc(capacity);
+    if (!state || !buffer) {
+        BrotliEncoderDestroyInstance(state);
+        free(buffer);
+        return 0;
+    }
+
+    BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY, quality);
+    BrotliEncoderSetParameter(state, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+    BrotliEncoderSetParameter(state, BROTLI_PARAM_SIZE_HINT, total > (1u << 30) ? (1u << 30) : total);
+
+    uint8_t* next_out = (uint8_t*)buffer;
+    size_t avail_out = capacity;
+    int ok = 1;
+
+    for (int i = 0; i < count && ok; i++) {
+        const uint8_t* next_in = iov[i].iov_base;
+        size_t avail_in = iov[i].iov_len;
+        while (ok && avail_in > 0) {
+            ok = BrotliEncoderCompressStream(state, BROTLI_OPERATION_PROCESS, &avail_in, &next_in,
+                                             &avail_out, &next_out, NULL) && avail_out > 0;
+        }
+    }
+
+    while (ok && !BrotliEncoderIsFinished(state)) {
+        size_t avail_in = 0;
+        const uint8_t* next_in = NULL;
+        ok = BrotliEncoderCompressStream(state, BROTLI_OPERATION_FINISH, &avail_in, &next_in,
+                                         &avail_out, &next_out, NULL) &&
+             (avail_out > 0 || BrotliEncoderIsFinished(state));
+    }
+
+    BrotliEncoderDestroyInstance(state);
+
+    if (!ok) {
+        free(buffer);
+        return 0;
+    }
+
+    *out = buffer;
+    return capacity - avail_out;
+}
+
+size_t compress_iov(ContentEncoding encoding, int level, const struct iovec* iov, int count, char** out) {
+    switch (encoding) {
+        case ENCODING_GZIP: return gzip_iov(level, iov, count, out);
+        case ENCODING_BROTLI: return brotli_iov(level, iov, count, out);
+        default: return 0;
+    }
+}
+
+// ============================================================================
+// Incremental Compression
+// ============================================================================
+
+#define STREAM_OUTPUT_SLACK 16384   // Free output space kept before each encoder call
+
+struct StreamCompressor {
+    ContentEncoding encoding;
+    z_stream zlib;
+    BrotliEncoderState* brotli;
+    char* output;               // Every compressed byte so far
+    size_t length;
+    size_t capacity;
+};
+
+/**
+ * Keep at least STREAM_OUTPUT_SLACK bytes free after the output
+ * Returns: 0 on success, -1 on allocation failure
+ */
+static int reserve_output(StreamCompressor* compressor) {
+    if (compressor->capacity - compressor->length >= STREAM_OUTPUT_SLACK) {
+        return 0;
+    }
+
+    size_t capacity = compressor->capacity * 2;
+    if (capacity < compressor->length + STREAM_OUTPUT_SLACK) {
+        capacity = compressor->length + STREAM_OUTPUT_SLACK;
+    }
+    char* output = realloc(compressor->output, capacity);
+    if (!output) {
+        return -1;
+    }
+    compressor->output = output;
+    compressor->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Feed input to the encoder until it is consumed (finish: until the stream ends)
+ * Returns: 0 on success, -1 on failure
+ */
+static int run_encoder(StreamCompressor* compressor, const char* data, size_t length, int finish) {
+    if (compressor->encoding == ENCODING_GZIP) {
+        z_stream* stream = &compressor->zlib;
+        stream->next_in = (Bytef*)data;
+        stream->avail_in = length;
+
+        int result = Z_OK;
+        while (stream->avail_in > 0 || (finish && result != Z_STREAM_END)) {
+            if (reserve_output(compressor) != 0) {
+                return -1;
+            }
+            stream->next_out = (Bytef*)compressor->output + compressor->length;
+            stream->avail_out = compressor->capacity - compressor->length;
+            result = deflate(stream, finish ? Z_FINISH : Z_NO_FLUSH);
+            compressor->length = compressor->capacity - stream->avail_out;
+            if (result == Z_STREAM_ERROR) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    BrotliEncoderState* state = compressor->brotli;
+    BrotliEncoderOperation operation = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+    const uint8_t* next_in = (const uint8_t*)data;
+    size_t avail_in = length;
+
+    while (avail_in > 0 || BrotliEncoderHasMoreOutput(state) ||
+           (finish && !BrotliEncoderIsFinished(state))) {
+        if (reserve_output(compressor) != 0) {
+            return -1;
+        }
+        uint8_t* next_out = (uint8_t*)compressor->output + compressor->length;
+        size_t avail_out = compressor->capacity - compressor->length;
+        if (!BrotliEncoderCompressStream(state, operation, &avail_in, &next_in,
+                                         &avail_out, &next_out, NULL)) {
+            return -1;
+        }
+        compressor->length = compressor->capacity - avail_out;
+    }
+    return 0;
+}
+
+StreamCompressor* stream_compressor_create(ContentEncoding encoding, int level) {
+    StreamCompressor* compressor = calloc(1, sizeof(StreamCompressor));
+    if (!compressor) {
+        return NULL;
+    }
+    compressor->encoding = encoding;
+
+    int ok = 0;
+    if (encoding == ENCODING_GZIP) {
+        // windowBits 15 + 16: gzip header and trailer instead of zlib's
+        ok = deflateInit2(&compressor->zlib, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    } else if (encoding == ENCODING_BROTLI) {
+        compressor->brotli = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+        if (compressor->brotli) {
+            BrotliEncoderSetParameter(compressor->brotli, BROTLI_PARAM_QUALITY, level);
+            BrotliEncoderSetParameter(compressor->brotli, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+            ok = 1;
+        }
+    }
+
+    if (!ok) {
+        free(compressor);
+        return NULL;
+    }
+    return compressor;
+}
+
+int stream_compressor_write(StreamCompressor* compressor, const char* data, size_t length) {
+    return run_encoder(compressor, data, length, 0);
+}
+
+int stream_compressor_finish(StreamCompressor* compressor) {
+    return run_encoder(compressor, NULL, 0, 1);
+}
+
+const char* stream_compressor_output(const StreamCompressor* compressor, size_t* length) {
+    *length = compressor->length;
+    return compressor->output;
+}
+
+ContentEncoding stream_compressor_encoding(const StreamCompressor* compressor) {
+    return compressor->encoding;
+}
+
+void stream_compressor_free(StreamCompressor* compressor) {
+    if (!compressor) {
+        return;
+    }
+    if (compressor->encoding == ENCODING_GZIP) {
+        deflateEnd(&compressor->zlib);
+    } else {
+        BrotliEncoderDestroyInstance(compressor->brotli);
+    }
+    free(compressor->output);
+    free(compressor);
+}
+
+// ============================================================================
+// Precompressed Static Assets
+// ============================================================================
+
+static int static_written = 0;  // compress_static_assets() runs once, before any thread
+
+/**
+ * Read a whole (small) file
+ * Returns: malloc'd contents, or NULL on error
+ */
+static char* read_file(const char* path, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    char* data = malloc(size + 1);
+    size_t done = 0;
+    while (data && done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n <= 0) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        done += n;
+    }
+
+    close(fd);
+    return data;
+}
+
+/**
+ * Write data to path through a temporary file (readers never see a partial sibling)
+ * Returns: 0 on success, -1 on error
+ */
+static int write_file_atomic(const char* path, const char* data, size_t length) {
+    char tmp_path[MAX_PATH + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = write(fd, data + done, length - done);
+        if (n <= 0) {
+            close(fd);
+            unlink(tmp_path);
+            return -1;
+        }
+        done += n;
+    }
+
+    if (close(fd) != 0 || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int compress_asset(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void)ftw;
+
+    if (type != FTW_F || !S_ISREG(st->st_mode) || !is_compressible_file(path)) {
+        return 0;
+    }
+
+    static const ContentEncoding encodings[] = {ENCODING_GZIP, ENCODING_BROTLI};
+    char* data = NULL;
+
+    for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); i++) {
+        char sibling[MAX_PATH];
+        struct stat sibling_st;
+        snprintf(sibling, sizeof(sibling), "%s%s", path, encoding_suffix(encodings[i]));
+
+        if (stat(sibling, &sibling_st) == 0 && sibling_st.st_mtime >= st->st_mtime) {
+            continue;  // Up to date
+        }
+
+        if (!data && !(data = read_file(path, st->st_size))) {
+            fprintf(stderr, "⚠️  Cannot read %s\n", path);
+            return 0;
+        }
+
+        struct iovec iov = {data, st->st_size};
+        int level = encodings[i] == ENCODING_BROTLI ? COMPRESS_STATIC_BROTLI_QUALITY
+                                                    : COMPRESS_STATIC_GZIP_LEVEL;
+        char* compressed = NULL;
+        size_t length = compress_iov(encodings[i], level, &iov, 1, &compressed);
+
+        // Not smaller: no sibling, the original is served instead
+        if (length == 0 || length >= (size_t)st->st_size) {
+            unlink(sibling);
+        } else if (write_file_atomic(sibling, compressed, length) == 0) {
+            static_written++;
+        } else {
+            fprintf(stderr, "⚠️  Cannot write %s\n", sibling);
+        }
+        free(compressed);
+    }
+
+    free(data);
+    return 0;
+}
+
+int compress_static_assets(const char* root) {
+    static_written = 0;
+    if (nftw(root, compress_asset, 16, FTW_PHYS) != 0) {
+        fprintf(stderr, "⚠️  Cannot scan %s for static assets\n", root);
+        return -1;
+    }
+
+    printf("✓ Static assets precompressed: %d file%s written\n",
+           static_written, static_written == 1 ? "" : "s");
+    return static_written;
+}
+
+ContentEncoding find_static_variant(const char* filename, int accepted, char* out, size_t size) {
+    if (!accepted || !is_compressible_file(filename)) {
+        return ENCODING_IDENTITY;
+    }
+
+    struct stat source;
+    if (stat(filename, &source) != 0) {
+        return ENCODING_IDENTITY;
+    }
+
+    static const ContentEncoding preference[] = {ENCODING_BROTLI, ENCODING_GZIP};
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        if (!(accepted & (1 << preference[i]))) {
+            continue;
+        }
+
+        struct stat st;
+        snprintf(out, size, "%s%s", filename, encoding_suffix(preference[i]));
+        if (stat(out, &st) == 0 && S_ISREG(st.st_mode) && st.st_mtime >= source.st_mtime) {
+            return preference[i];
+        }
+    }
+
+    return ENCODING_IDENTITY;
+}
+
+// ============================================================================
+// Compressed Body Cache
+// ============================================================================
+
+static const char* body_key(const CompressedBody* body) {
+    return body->data + body->length;
+}
+
+static int key_matches(const CompressedBody* body, const char* etag, const char* resource,
+                       ContentEncoding encoding) {
+    const char* key = body_key(body);
+    size_t etag_len = strlen(etag);
+    return body->encoding == encoding && strncmp(key, etag, etag_len) == 0 &&
+           key[etag_len] == ' ' && strcmp(key + etag_len + 1, resource) == 0;
+}
+
+CompressedBody* compressed_cache_acquire(const char* etag, const char* resource, ContentEncoding encoding) {
+    CompressedBody* found = NULL;
+
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < COMPRESS_CACHE_ENTRIES; i++) {
+        if (cache[i] && key_matches(cache[i], etag, resource, encoding)) {
+            found = cache[i];
+            found->refcount++;
+            found->last_used = ++cache_clock;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    return found;
+}
+
+void compressed_cache_store(const char* etag, const char* resource, ContentEncoding encoding,
+                            const char* data, size_t length) {
+    size_t key_len = strlen(etag) + 1 + strlen(resource);
+    CompressedBody* body = malloc(sizeof(CompressedBody) + length + key_len + 1);
+    if (!body) {
+        return;
+    }
+
+    body->encoding = encoding;
+    body->length = length;
+    body->refcount = 1;
+    memcpy(body->data, data, length);
+    snprintf(body->data + length, key_len + 1, "%s %s", etag, resource);
+
+    CompressedBody* evicted = NULL;
+
+    pthread_mutex_lock(&cache_lock);
+    int empty = -1;
+    int oldest = -1;
+    for (int i = 0; i < COMPRESS_CACHE_ENTRIES; i++) {
+        if (!cache[i]) {
+            if (empty < 0) {
+                empty = i;
+            }
+            continue;
+        }
+        if (key_matches(cache[i], etag, resource, encoding)) {
+            // Another thread stored the same body meanwhile
+            pthread_mutex_unlock(&cache_lock);
+            free(body);
+            return;
+        }
+        if (oldest < 0 || cache[i]->last_used < cache[oldest]->last_used) {
+            oldest = i;
+        }
+    }
+
+    int slot = empty >= 0 ? empty : oldest;
+    evicted = cache[slot];
+    body->last_used = ++cache_clock;
+    cache[slot] = body;
+    if (evicted && --evicted->refcount > 0) {
+        evicted = NULL;  // Still being sent: the last reader frees it
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    free(evicted);
+}
+
+void compressed_cache_release(CompressedBody* body) {
+    if (!body) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    int last = --body->refcount == 0;
+    pthread_mutex_unlock(&cache_lock);
+
+    if (last) {
+        free(body);
+    }
+}
+
+void compressed_cache_cleanup(void) {
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < COMPRESS_CACHE_ENTRIES; i++) {
+        if (cache[i] && --cache[i]->refcount == 0) {
+            free(cache[i]);
+        }
+        cache[i] = NULL;
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
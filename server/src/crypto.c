@@ -7,6 +7,9 @@
 
 #include "../include/crypto.h"
 #include <openssl/sha.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -65,3 +68,95 @@ int verify_password(const char* input_password, const char* stored_hash) {
     // Use constant-time comparison to prevent timing attacks
     return constant_time_compare(computed_hash, stored_hash, SHA256_HEX_LENGTH - 1);
 }
+
+struct HmacKey {
+    EVP_MD_CTX* inner;      // SHA-256 state after (key ^ ipad)
+    EVP_MD_CTX* outer;      // SHA-256 state after (key ^ opad)
+};
+
+/**
+ * SHA-256 state after hashing one key block XOR pad
+ */
+static EVP_MD_CTX* padded_key_state(const unsigned char* block, unsigned char pad) {
+    unsigned char padded[SHA256_CBLOCK];
+    for (int i = 0; i < SHA256_CBLOCK; i++) {
+        padded[i] = block[i] ^ pad;
+    }
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (ctx && (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1 ||
+                EVP_DigestUpdate(ctx, padded, sizeof(padded)) != 1)) {
+        EVP_MD_CTX_free(ctx);
+        ctx = NULL;
+    }
+    OPENSSL_cleanse(padded, sizeof(padded));
+    return ctx;
+}
+
+/**
+ * Prepare an HMAC-SHA256 key (RFC 2104)
+ */
+HmacKey* hmac_sha256_key_create(const unsigned char* key, size_t key_len) {
+    unsigned char block[SHA256_CBLOCK] = {0};
+
+    // Keys longer than a block are hashed first
+    if (key_len > SHA256_CBLOCK) {
+        SHA256(key, key_len, block);
+    } else {
+        memcpy(block, key, key_len);
+    }
+
+    HmacKey* hmac = calloc(1, sizeof(HmacKey));
+    if (hmac) {
+        hmac->inner = padded_key_state(block, 0x36);
+        hmac->outer = padded_key_state(block, 0x5c);
+        if (!hmac->inner || !hmac->outer) {
+            hmac_sha256_key_free(hmac);
+            hmac = NULL;
+        }
+    }
+    OPENSSL_cleanse(block, sizeof(block));
+    return hmac;
+}
+
+void hmac_sha256_key_free(HmacKey* key) {
+    if (key) {
+        EVP_MD_CTX_free(key->inner);
+        EVP_MD_CTX_free(key->outer);
+        free(key);
+    }
+}
+
+/**
+ * Compute HMAC-SHA256 of data: SHA256(outer | SHA256(inner | data))
+ */
+int hmac_sha256(const HmacKey* key, const unsigned char* data, size_t data_len, unsigned char* output) {
+    unsigned char inner_hash[SHA256_DIGEST_LENGTH];
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+
+    int ok = ctx &&
+             EVP_MD_CTX_copy_ex(ctx, key->inner) == 1 &&
+             EVP_DigestUpdate(ctx, data, data_len) == 1 &&
+             EVP_DigestFinal_ex(ctx, inner_hash, NULL) == 1 &&
+             EVP_MD_CTX_copy_ex(ctx, key->outer) == 1 &&
+             EVP_DigestUpdate(ctx, inner_hash, sizeof(inner_hash)) == 1 &&
+             EVP_DigestFinal_ex(ctx, output, NULL) == 1;
+
+    EVP_MD_CTX_free(ctx);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Check a (possibly truncated) HMAC-SHA256 tag
+ *
+ * Uses constant-time comparison so a forger cannot learn the tag byte by byte.
+ */
+int hmac_sha256_verify(const HmacKey* key, const unsigned char* data, size_t data_len,
+                       const unsigned char* tag, size_t tag_len) {
+    unsigned char computed[HMAC_SHA256_LENGTH];
+
+    if (tag_len == 0 || tag_len > HMAC_SHA256_LENGTH || hmac_sha256(key, data, data_len, computed) != 0) {
+        return 0;
+    }
+    return constant_time_compare((const char*)computed, (const char*)tag, tag_len);
+}
@@ -3,19 +3,317 @@
  * Enhancement Phase 2: SQLite integration
  *
  * Manages users, videos, and watch history
+ *
+ * Connections: `db` is opened once per process (schema, seed) and marks
+ * the database as open. Queries run on a per-thread connection opened on
+ * first use, each with its own prepared-statement cache keyed by SQL
+ * text: statements are prepared once, then only reset and rebound.
+ *
+ * Storage profile: WAL journal, synchronous=NORMAL, mmap and page cache
+ * sizes from config.h. WAL checkpoints run on a background thread, so
+ * request threads never pay for them.
+ *
+ * Catalog data (videos, genres) is served from the in-memory snapshot in
+ * catalog.c; only per-user tables are queried per request. Functions that
+ * change catalog tables call catalog_invalidate().
+ *
+ * Watch positions may still sit in the write-behind buffer
+ * (progress_buffer.c): history reads overlay them on watch_history.
  */
 
 #include "../include/database.h"
+#include "../include/catalog.h"
 #include "../include/config.h"
 #include "../include/crypto.h"
 #include "../include/json.h"
 #include "../include/json_builder.h"
+#include "../include/progress_buffer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
 
-// Global database connection
+// Global database connection (process-wide, used for schema/seed)
 static sqlite3* db = NULL;
+static char db_file[MAX_PATH];
+
+// ============================================================================
+// Per-Thread Connections & Statement Cache
+// ============================================================================
+
+typedef struct {
+    sqlite3* handle;
+    int count;
+    int next_evict;
+    sqlite3_stmt* stmts[DB_STMT_CACHE_SIZE];
+    unsigned char in_use[DB_STMT_CACHE_SIZE];   // Handed out, not yet released
+} ThreadConnection;
+
+static pthread_key_t conn_key;
+static pthread_once_t conn_key_once = PTHREAD_ONCE_INIT;
+
+// Background checkpointer
+static pthread_t checkpoint_thread;
+static int checkpoint_running = 0;
+static int checkpoint_stop = 0;
+static pthread_mutex_t checkpoint_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t checkpoint_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Apply the storage profile (DB_* settings in config.h) to a connection
+ */
+static void apply_storage_profile(sqlite3* handle) {
+    char sql[256];
+
+    sqlite3_busy_timeout(handle, DB_BUSY_TIMEOUT);
+
+    // Checkpoints are done by the background thread when it runs
+    snprintf(sql, sizeof(sql),
+             "PRAGMA synchronous=%s;"
+             "PRAGMA mmap_size=%lld;"
+             "PRAGMA cache_size=-%d;"
+             "PRAGMA wal_autocheckpoint=%d;",
+             DB_SYNCHRONOUS, (long long)DB_MMAP_SIZE, DB_CACHE_SIZE_KB,
+             DB_CHECKPOINT_INTERVAL > 0 ? 0 : 1000);
+
+    char* err_msg = NULL;
+    if (sqlite3_exec(handle, sql, NULL, NULL, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "Failed to apply storage profile: %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+}
+
+static void close_thread_connection(void* arg) {
+    ThreadConnection* conn = (ThreadConnection*)arg;
+    if (!conn) {
+        return;
+    }
+
+    for (int i = 0; i < conn->count; i++) {
+        sqlite3_finalize(conn->stmts[i]);
+    }
+    sqlite3_close(conn->handle);
+    free(conn);
+}
+
+static void create_conn_key(void) {
+    pthread_key_create(&conn_key, close_thread_connection);
+}
+
+/**
+ * Get (or open) the calling thread's connection
+ * Returns: NULL if the database is not open or the connection failed
+ */
+static ThreadConnection* thread_connection(void) {
+    pthread_once(&conn_key_once, create_conn_key);
+
+    ThreadConnection* conn = pthread_getspecific(conn_key);
+    if (conn || !db) {
+        return conn;
+    }
+
+    conn = calloc(1, sizeof(ThreadConnection));
+    if (!conn) {
+        return NULL;
+    }
+
+    // Private to this thread: no SQLite mutex needed
+    int rc = sqlite3_open_v2(db_file, &conn->handle,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot open thread connection: %s\n", sqlite3_errmsg(conn->handle));
+        sqlite3_close(conn->handle);
+        free(conn);
+        return NULL;
+    }
+
+    // Several connections share the file: busy timeout + storage profile
+    apply_storage_profile(conn->handle);
+
+    pthread_setspecific(conn_key, conn);
+    return conn;
+}
+
+/**
+ * Get a prepared statement for sql from the thread's cache
+ * Drop-in for sqlite3_prepare_v2(); pair with db_release().
+ */
+static int db_prepare(const char* sql, sqlite3_stmt** stmt) {
+    *stmt = NULL;
+
+    ThreadConnection* conn = thread_connection();
+    if (!conn) {
+        return SQLITE_ERROR;
+    }
+
+    for (int i = 0; i < conn->count; i++) {
+        const char* cached_sql = sqlite3_sql(conn->stmts[i]);
+        if (cached_sql == sql || strcmp(cached_sql, sql) == 0) {
+            if (!conn->in_use[i]) {
+                conn->in_use[i] = 1;
+                *stmt = conn->stmts[i];
+                return SQLITE_OK;
+            }
+
+            // In use further up the stack: hand out an uncached copy
+            // (one cached statement per SQL text)
+            return sqlite3_prepare_v2(conn->handle, sql, -1, stmt, NULL);
+        }
+    }
+
+    int rc = sqlite3_prepare_v3(conn->handle, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    if (conn->count < DB_STMT_CACHE_SIZE) {
+        conn->in_use[conn->count] = 1;
+        conn->stmts[conn->count++] = *stmt;
+        return SQLITE_OK;
+    }
+
+    // Cache full: replace slots round-robin, skipping handed-out ones
+    // (all in use: the new statement stays uncached)
+    for (int n = 0; n < DB_STMT_CACHE_SIZE; n++) {
+        int slot = (conn->next_evict + n) % DB_STMT_CACHE_SIZE;
+        if (!conn->in_use[slot]) {
+            sqlite3_finalize(conn->stmts[slot]);
+            conn->stmts[slot] = *stmt;
+            conn->in_use[slot] = 1;
+            conn->next_evict = (slot + 1) % DB_STMT_CACHE_SIZE;
+            break;
+        }
+    }
+
+    return SQLITE_OK;
+}
+
+/**
+ * Return a statement from db_prepare(): reset and unbind cached
+ * statements, finalize uncached ones
+ */
+static void db_release(sqlite3_stmt* stmt) {
+    if (!stmt) {
+        return;
+    }
+
+    ThreadConnection* conn = pthread_getspecific(conn_key);
+    for (int i = 0; conn && i < conn->count; i++) {
+        if (conn->stmts[i] == stmt) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            conn->in_use[i] = 0;
+            return;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+/**
+ * Error message of the calling thread's connection
+ */
+static const char* db_errmsg(void) {
+    ThreadConnection* conn = pthread_getspecific(conn_key);
+    return conn ? sqlite3_errmsg(conn->handle) : "database not open";
+}
+
+/**
+ * Run a parameterless statement (BEGIN/COMMIT/ROLLBACK) through the cache
+ * Returns: 0 on success, -1 on error
+ */
+static int db_exec_cached(const char* sql) {
+    sqlite3_stmt* stmt;
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        return -1;
+    }
+
+    int rc = sqlite3_step(stmt);
+    db_release(stmt);
+    return (rc == SQLITE_DONE) ? 0 : -1;
+}
+
+// ============================================================================
+// Background WAL Checkpoints
+// ============================================================================
+
+static void* checkpoint_main(void* arg) {
+    (void)arg;
+    sqlite3* handle = NULL;
+
+    // Shutdown signals must reach a thread that can join this one
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    if (sqlite3_open_v2(db_file, &handle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Checkpoint thread cannot open database: %s\n", sqlite3_errmsg(handle));
+        sqlite3_close(handle);
+        return NULL;
+    }
+    sqlite3_busy_timeout(handle, DB_BUSY_TIMEOUT);
+
+    pthread_mutex_lock(&checkpoint_lock);
+    while (!checkpoint_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += DB_CHECKPOINT_INTERVAL;
+
+        pthread_cond_timedwait(&checkpoint_cond, &checkpoint_lock, &deadline);
+        if (checkpoint_stop) {
+            break;
+        }
+        pthread_mutex_unlock(&checkpoint_lock);
+
+        // PASSIVE: copy what it can without blocking readers or writers
+        int wal_pages = 0, checkpointed = 0;
+        int rc = sqlite3_wal_checkpoint_v2(handle, NULL, SQLITE_CHECKPOINT_PASSIVE,
+                                           &wal_pages, &checkpointed);
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY) {
+            fprintf(stderr, "WAL checkpoint failed: %s\n", sqlite3_errmsg(handle));
+        }
+
+        pthread_mutex_lock(&checkpoint_lock);
+    }
+    pthread_mutex_unlock(&checkpoint_lock);
+
+    // Final checkpoint: leave an empty WAL behind on shutdown
+    sqlite3_wal_checkpoint_v2(handle, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
+    sqlite3_close(handle);
+    return NULL;
+}
+
+static void start_checkpoint_thread(void) {
+    if (DB_CHECKPOINT_INTERVAL <= 0 || checkpoint_running) {
+        return;
+    }
+
+    checkpoint_stop = 0;
+    if (pthread_create(&checkpoint_thread, NULL, checkpoint_main, NULL) != 0) {
+        perror("pthread_create (checkpoint)");
+        return;
+    }
+    checkpoint_running = 1;
+}
+
+/**
+ * Stop the checkpointer (must happen before fork(): threads don't survive it)
+ */
+static void stop_checkpoint_thread(void) {
+    if (!checkpoint_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&checkpoint_lock);
+    checkpoint_stop = 1;
+    pthread_cond_signal(&checkpoint_cond);
+    pthread_mutex_unlock(&checkpoint_lock);
+
+    pthread_join(checkpoint_thread, NULL);
+    checkpoint_running = 0;
+}
 
 /**
  * Execute SQL commands from a file
@@ -56,10 +354,7 @@ int execute_sql_file(sqlite3* database, const char* filepath) {
  * Initialize database connection and create tables
  */
 int init_database(const char* db_path) {
-    int rc = sqlite3_open(db_path, &db);
-
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+    if (open_database(db_path) != 0) {
         return -1;
     }
 
@@ -84,10 +379,45 @@ int init_database(const char* db_path) {
     return 0;
 }
 
+/**
+ * Open database connection without running schema/seed scripts
+ * Used by prefork workers: a SQLite handle must not cross fork().
+ */
+int open_database(const char* db_path) {
+    snprintf(db_file, sizeof(db_file), "%s", db_path);
+
+    int rc = sqlite3_open(db_path, &db);
+
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        db = NULL;
+        return -1;
+    }
+
+    // journal_mode is stored in the database file; the rest is per connection
+    char* err_msg = NULL;
+    if (sqlite3_exec(db, "PRAGMA journal_mode=" DB_JOURNAL_MODE ";", NULL, NULL, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "Failed to set journal mode: %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+    apply_storage_profile(db);
+
+    start_checkpoint_thread();
+    return 0;
+}
+
 /**
  * Close database connection
  */
 void close_database(void) {
+    // The calling thread's connection (other threads close theirs on exit)
+    pthread_once(&conn_key_once, create_conn_key);
+    close_thread_connection(pthread_getspecific(conn_key));
+    pthread_setspecific(conn_key, NULL);
+
+    stop_checkpoint_thread();
+
     if (db) {
         sqlite3_close(db);
         db = NULL;
@@ -104,9 +434,9 @@ int authenticate_user(const char* username, const char* password, int* user_id)
     sqlite3_stmt* stmt;
     const char* sql = "SELECT user_id, password_hash FROM users WHERE username = ?";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to prepare statement: %s\n", db_errmsg());
         return 0;
     }
 
@@ -121,7 +451,7 @@ int authenticate_user(const char* username, const char* password, int* user_id)
         // Verify password
         if (verify_password(password, stored_hash)) {
             *user_id = uid;
-            sqlite3_finalize(stmt);
+            db_release(stmt);
             printf("  [Auth] User '%s' authenticated successfully (ID: %d)\n", username, uid);
             return 1;
         } else {
@@ -131,7 +461,7 @@ int authenticate_user(const char* username, const char* password, int* user_id)
         printf("  [Auth] User '%s' not found\n", username);
     }
 
-    sqlite3_finalize(stmt);
+    db_release(stmt);
     return 0;
 }
 
@@ -148,9 +478,9 @@ int create_user(const char* username, const char* password) {
     sqlite3_stmt* stmt;
     const char* sql = "INSERT INTO users (username, password_hash) VALUES (?, ?)";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to prepare statement: %s\n", db_errmsg());
         return -1;
     }
 
@@ -158,10 +488,10 @@ int create_user(const char* username, const char* password) {
     sqlite3_bind_text(stmt, 2, password_hash, -1, SQLITE_TRANSIENT);
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     if (rc != SQLITE_DONE) {
-        fprintf(stderr, "Failed to create user: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to create user: %s\n", db_errmsg());
         return -1;
     }
 
@@ -178,14 +508,14 @@ int update_last_login(int user_id) {
     sqlite3_stmt* stmt;
     const char* sql = "UPDATE users SET last_login = CURRENT_TIMESTAMP WHERE user_id = ?";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
         return -1;
     }
 
     sqlite3_bind_int(stmt, 1, user_id);
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
@@ -194,40 +524,29 @@ int update_last_login(int user_id) {
  * Get all videos as JSON array
  */
 int get_videos_json(char* json_output, size_t max_len) {
-    if (!db) return -1;
-
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT video_id, title, filename, thumbnail_path, duration, file_size FROM videos ORDER BY created_at DESC";
-
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        return -1;
-    }
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) return -1;
 
     // Start JSON array
     strcpy(json_output, "{\"videos\":[");
     size_t offset = strlen(json_output);
 
+    // Newest first: video_id follows registration order
     int first = 1;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    for (int i = catalog->video_count - 1; i >= 0; i--) {
+        const Video* video = &catalog->videos[i];
+
         if (!first) {
             strcat(json_output + offset, ",");
             offset++;
         }
         first = 0;
 
-        int video_id = sqlite3_column_int(stmt, 0);
-        const char* title = (const char*)sqlite3_column_text(stmt, 1);
-        const char* filename = (const char*)sqlite3_column_text(stmt, 2);
-        const char* thumbnail = sqlite3_column_text(stmt, 3) ?
-            (const char*)sqlite3_column_text(stmt, 3) : "";
-        int duration = sqlite3_column_int(stmt, 4);
-        long file_size = sqlite3_column_int64(stmt, 5);
-
-        char video_json[512];
+        char video_json[1024];
         snprintf(video_json, sizeof(video_json),
             "{\"video_id\":%d,\"title\":\"%s\",\"filename\":\"%s\",\"thumbnail\":\"%s\",\"duration\":%d,\"file_size\":%ld}",
-            video_id, title, filename, thumbnail, duration, file_size);
+            video->video_id, video->title, video->filename, video->thumbnail_path,
+            video->duration, video->file_size);
 
         if (offset + strlen(video_json) >= max_len - 10) {
             break;  // Prevent buffer overflow
@@ -238,7 +557,7 @@ int get_videos_json(char* json_output, size_t max_len) {
     }
 
     strcat(json_output + offset, "]}");
-    sqlite3_finalize(stmt);
+    catalog_release(catalog);
 
     return 0;
 }
@@ -247,35 +566,18 @@ int get_videos_json(char* json_output, size_t max_len) {
  * Get video by ID
  */
 int get_video_by_id(int video_id, Video* video) {
-    if (!db || !video) return -1;
-
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT title, filename, thumbnail_path, duration, file_size FROM videos WHERE video_id = ?";
-
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        return -1;
-    }
-
-    sqlite3_bind_int(stmt, 1, video_id);
+    if (!video) return -1;
 
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW) {
-        video->video_id = video_id;
-        strncpy(video->title, (const char*)sqlite3_column_text(stmt, 0), sizeof(video->title) - 1);
-        strncpy(video->filename, (const char*)sqlite3_column_text(stmt, 1), sizeof(video->filename) - 1);
-        if (sqlite3_column_text(stmt, 2)) {
-            strncpy(video->thumbnail_path, (const char*)sqlite3_column_text(stmt, 2), sizeof(video->thumbnail_path) - 1);
-        }
-        video->duration = sqlite3_column_int(stmt, 3);
-        video->file_size = sqlite3_column_int64(stmt, 4);
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) return -1;
 
-        sqlite3_finalize(stmt);
-        return 0;
+    int index = catalog_video_index(catalog, video_id);
+    if (index >= 0) {
+        *video = catalog->videos[index];
     }
 
-    sqlite3_finalize(stmt);
-    return -1;
+    catalog_release(catalog);
+    return (index >= 0) ? 0 : -1;
 }
 
 /**
@@ -287,7 +589,7 @@ int get_video_by_filename(const char* filename, Video* video) {
     sqlite3_stmt* stmt;
     const char* sql = "SELECT video_id, title, thumbnail_path, duration, file_size FROM videos WHERE filename = ?";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
         return -1;
     }
@@ -305,11 +607,11 @@ int get_video_by_filename(const char* filename, Video* video) {
         video->duration = sqlite3_column_int(stmt, 3);
         video->file_size = sqlite3_column_int64(stmt, 4);
 
-        sqlite3_finalize(stmt);
+        db_release(stmt);
         return 0;
     }
 
-    sqlite3_finalize(stmt);
+    db_release(stmt);
     return -1;
 }
 
@@ -322,7 +624,7 @@ int register_video(const char* filename, const char* title, long file_size) {
     sqlite3_stmt* stmt;
     const char* sql = "INSERT OR IGNORE INTO videos (filename, title, file_size) VALUES (?, ?, ?)";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
         return -1;
     }
@@ -332,9 +634,13 @@ int register_video(const char* filename, const char* title, long file_size) {
     sqlite3_bind_int64(stmt, 3, file_size);
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    int inserted = sqlite3_changes(sqlite3_db_handle(stmt)) > 0;
+    db_release(stmt);
 
     if (rc == SQLITE_DONE) {
+        if (inserted) {
+            catalog_invalidate();
+        }
         printf("  [DB] Registered video: %s\n", filename);
         return 0;
     }
@@ -351,7 +657,7 @@ int update_video_metadata(const char* filename, int duration, const char* thumbn
     sqlite3_stmt* stmt;
     const char* sql = "UPDATE videos SET duration = ?, thumbnail_path = ? WHERE filename = ?";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "  [DB] Failed to prepare UPDATE statement\n");
         return -1;
@@ -362,9 +668,10 @@ int update_video_metadata(const char* filename, int duration, const char* thumbn
     sqlite3_bind_text(stmt, 3, filename, -1, SQLITE_TRANSIENT);
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     if (rc == SQLITE_DONE) {
+        catalog_invalidate();
         printf("  [DB] Updated metadata for %s: duration=%ds, thumbnail=%s\n",
                filename, duration, thumbnail_path);
         return 0;
@@ -379,10 +686,15 @@ int update_video_metadata(const char* filename, int duration, const char* thumbn
 int get_watch_position(int user_id, int video_id) {
     if (!db) return 0;
 
+    int position = 0;
+    if (progress_buffer_lookup(user_id, video_id, &position)) {
+        return position;
+    }
+
     sqlite3_stmt* stmt;
     const char* sql = "SELECT last_position FROM watch_history WHERE user_id = ? AND video_id = ?";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
         return 0;
     }
@@ -390,12 +702,11 @@ int get_watch_position(int user_id, int video_id) {
     sqlite3_bind_int(stmt, 1, user_id);
     sqlite3_bind_int(stmt, 2, video_id);
 
-    int position = 0;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         position = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    db_release(stmt);
     return position;
 }
 
@@ -409,7 +720,7 @@ int update_watch_position(int user_id, int video_id, int position) {
     const char* sql = "INSERT OR REPLACE INTO watch_history (user_id, video_id, last_position, last_watched) "
                       "VALUES (?, ?, ?, CURRENT_TIMESTAMP)";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = db_prepare(sql, &stmt);
     if (rc != SQLITE_OK) {
         return -1;
     }
@@ -419,116 +730,140 @@ int update_watch_position(int user_id, int video_id, int position) {
     sqlite3_bind_int(stmt, 3, position);
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
 /**
- * Get video filename by video_id
+ * Write a batch of watch positions in a single transaction
+ * last_watched keeps the time of each update, not the time of the flush.
  */
-int get_video_filename(int video_id, char* filename, size_t max_len) {
-    if (!db || !filename || max_len == 0) {
+int update_watch_positions(const WatchProgress* updates, int count) {
+    if (!db) return -1;
+    if (count <= 0) return 0;
+
+    sqlite3_stmt* stmt;
+    const char* sql = "INSERT OR REPLACE INTO watch_history (user_id, video_id, last_position, last_watched) "
+                      "VALUES (?, ?, ?, datetime(?, 'unixepoch'))";
+
+    if (db_exec_cached("BEGIN IMMEDIATE") != 0) {
+        fprintf(stderr, "Failed to begin progress batch: %s\n", db_errmsg());
         return -1;
     }
 
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT filename FROM videos WHERE video_id = ?";
+    int rc = db_prepare(sql, &stmt);
+    for (int i = 0; rc == SQLITE_OK && i < count; i++) {
+        sqlite3_bind_int(stmt, 1, updates[i].user_id);
+        sqlite3_bind_int(stmt, 2, updates[i].video_id);
+        sqlite3_bind_int(stmt, 3, updates[i].position);
+        sqlite3_bind_int64(stmt, 4, (sqlite3_int64)updates[i].updated_at);
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+        rc = (sqlite3_step(stmt) == SQLITE_DONE) ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(stmt);
+    }
     if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to write progress batch: %s\n", db_errmsg());
+    }
+    db_release(stmt);
+
+    int end_rc = db_exec_cached(rc == SQLITE_OK ? "COMMIT" : "ROLLBACK");
+    return (rc == SQLITE_OK && end_rc == 0) ? 0 : -1;
+}
+
+/**
+ * Get video filename by video_id
+ */
+int get_video_filename(int video_id, char* filename, size_t max_len) {
+    if (!filename || max_len == 0) {
         return -1;
     }
 
-    sqlite3_bind_int(stmt, 1, video_id);
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
+        return -1;
+    }
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* fname = (const char*)sqlite3_column_text(stmt, 0);
-        snprintf(filename, max_len, "%s", fname ? fname : "");
-        sqlite3_finalize(stmt);
-        return 0;
+    int index = catalog_video_index(catalog, video_id);
+    if (index >= 0) {
+        snprintf(filename, max_len, "%s", catalog->videos[index].filename);
     }
 
-    sqlite3_finalize(stmt);
-    return -1;
+    catalog_release(catalog);
+    return (index >= 0) ? 0 : -1;
 }
 
 /**
  * Get all videos with watch history for specific user (Phase 3)
  * Returns JSON array of videos with watch progress
  */
-int get_videos_with_history(int user_id, char* json_output, size_t max_len) {
-    if (!db || !json_output || max_len == 0) {
+int get_videos_with_history(int user_id, JSONBuilder* builder) {
+    if (!db || !builder) {
         return -1;
     }
 
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
+        return -1;
+    }
+
+    // Buffered positions first: they override the rows read below
+    WatchProgress* buffered;
+    int buffered_count = progress_buffer_user_entries(user_id, &buffered);
+
+    // Per-user overlay: last position per catalog entry
+    int* positions = calloc(catalog->video_count + 1, sizeof(int));
     sqlite3_stmt* stmt;
-    const char* sql =
-        "SELECT v.video_id, v.title, v.filename, v.thumbnail_path, v.duration, v.file_size, "
-        "       COALESCE(wh.last_position, 0) as last_position "
-        "FROM videos v "
-        "LEFT JOIN watch_history wh ON v.video_id = wh.video_id AND wh.user_id = ? "
-        "ORDER BY v.video_id";
+    const char* sql = "SELECT video_id, last_position FROM watch_history WHERE user_id = ?";
 
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        snprintf(json_output, max_len, "{\"status\":\"error\",\"message\":\"Database error\"}");
+    if (buffered_count < 0 || !positions || db_prepare(sql, &stmt) != SQLITE_OK) {
+        free(buffered);
+        free(positions);
+        catalog_release(catalog);
         return -1;
     }
 
     sqlite3_bind_int(stmt, 1, user_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int index = catalog_video_index(catalog, sqlite3_column_int(stmt, 0));
+        if (index >= 0) {
+            positions[index] = sqlite3_column_int(stmt, 1);
+        }
+    }
+    db_release(stmt);
 
-    // Initialize JSON builder
-    JSONBuilder builder;
-    json_builder_init(&builder, json_output, max_len);
+    for (int i = 0; i < buffered_count; i++) {
+        int index = catalog_video_index(catalog, buffered[i].video_id);
+        if (index >= 0) {
+            positions[index] = buffered[i].position;
+        }
+    }
+    free(buffered);
 
     // Build JSON response: {"videos":[...]}
-    json_builder_start_object(&builder);
-    json_builder_start_array_field(&builder, "videos");
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "videos");
 
     int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Check if we're running out of buffer space
-        if (json_builder_remaining(&builder) < MAX_JSON_SMALL_BUFFER) {
-            fprintf(stderr, "[WARNING] Buffer nearly full, stopping at %d videos\n", count);
-            break;
-        }
-
-        int video_id = sqlite3_column_int(stmt, 0);
-        const char* title = (const char*)sqlite3_column_text(stmt, 1);
-        const char* filename = (const char*)sqlite3_column_text(stmt, 2);
-        const char* thumbnail = sqlite3_column_text(stmt, 3) ?
-                                (const char*)sqlite3_column_text(stmt, 3) : "";
-        int duration = sqlite3_column_int(stmt, 4);
-        long file_size = sqlite3_column_int64(stmt, 5);
-        int last_position = sqlite3_column_int(stmt, 6);
-
-        // Add video object using builder (handles escaping automatically)
-        json_builder_add_video_object(
-            &builder,
-            video_id,
-            title,
-            filename,
-            thumbnail,
-            duration,
-            file_size,
-            last_position > 0,
-            last_position
-        );
+    for (int i = 0; i < catalog->video_count; i++) {
+        // Cached static JSON + this user's watched/last_position
+        size_t length;
+        const char* fragment = catalog_video_fragment(catalog, i, &length);
+        json_builder_add_video_fragment(builder, fragment, length, positions[i] > 0, positions[i]);
 
         count++;
     }
 
     // Close JSON array and object
-    json_builder_end_array(&builder);
-    json_builder_end_object(&builder);
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
 
-    sqlite3_finalize(stmt);
+    free(positions);
+    catalog_release(catalog);
 
     // Check for builder errors
-    if (json_builder_has_error(&builder)) {
+    if (json_builder_has_error(builder)) {
         fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
-        snprintf(json_output, max_len, "{\"status\":\"error\",\"message\":\"JSON generation failed\"}");
         return -1;
     }
 
@@ -556,91 +891,138 @@ int get_watch_history_json(int user_id, int video_id, char* json_output, size_t
     return 0;
 }
 
+/**
+ * Add one "continue watching" entry unless the video is unknown, not
+ * started, or almost finished (position >= 90% of duration)
+ * Returns: 1 if added, 0 if skipped
+ */
+static int add_recommendation(JSONBuilder* builder, const Catalog* catalog, int video_id,
+                              int last_position, const char* last_watched) {
+    int index = catalog_video_index(catalog, video_id);
+    if (index < 0 || last_position <= 0 || last_position >= catalog->videos[index].duration * 0.9) {
+        return 0;
+    }
+
+    const Video* video = &catalog->videos[index];
+
+    // Calculate progress percentage
+    int duration = video->duration;
+    int progress_percent = (duration > 0) ? (last_position * 100 / duration) : 0;
+
+    // Build recommendation object with extra fields
+    json_builder_start_object(builder);
+    json_builder_add_int(builder, "video_id", video->video_id);
+    json_builder_add_string(builder, "title", video->title[0] ? video->title : "Unknown");
+    json_builder_add_string(builder, "filename", video->filename);
+    json_builder_add_string(builder, "thumbnail", video->thumbnail_path);
+    json_builder_add_int(builder, "duration", duration);
+    json_builder_add_long(builder, "file_size", video->file_size);
+    json_builder_add_int(builder, "last_position", last_position);
+    json_builder_add_int(builder, "progress_percent", progress_percent);
+    json_builder_add_string(builder, "last_watched", last_watched ? last_watched : "");
+    json_builder_end_object(builder);
+    return 1;
+}
+
+static int compare_newest_first(const void* a, const void* b) {
+    time_t x = ((const WatchProgress*)a)->updated_at;
+    time_t y = ((const WatchProgress*)b)->updated_at;
+    return (x < y) - (x > y);
+}
+
+static int progress_has_video(const WatchProgress* entries, int count, int video_id) {
+    for (int i = 0; i < count; i++) {
+        if (entries[i].video_id == video_id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /**
  * Get recommended videos for user based on watch history (Continue Watching)
  * Returns JSON array of videos that user has partially watched
  */
-int get_recommended_videos(int user_id, char* json_output, size_t max_len) {
-    if (!db || !json_output || max_len == 0) {
+int get_recommended_videos(int user_id, JSONBuilder* builder) {
+    if (!db || !builder) {
+        return -1;
+    }
+
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
         return -1;
     }
 
+    // Buffered positions first: they replace their rows and are merged in
+    // by time with the rows below
+    WatchProgress* buffered;
+    int buffered_count = progress_buffer_user_entries(user_id, &buffered);
+    if (buffered_count < 0) {
+        catalog_release(catalog);
+        return -1;
+    }
+    if (buffered_count > 1) {
+        qsort(buffered, buffered_count, sizeof(WatchProgress), compare_newest_first);
+    }
+
     sqlite3_stmt* stmt;
     // Get videos user has started watching but not completed (position < 90% of duration)
     // Show most recently watched first
     // Using percentage-based threshold (90%) instead of fixed 30 seconds to support short videos
+    // Durations come from the catalog; only the user's history is queried
     const char* sql =
-        "SELECT v.video_id, v.title, v.filename, v.thumbnail_path, v.duration, v.file_size, "
-        "       wh.last_position, wh.last_watched "
-        "FROM videos v "
-        "INNER JOIN watch_history wh ON v.video_id = wh.video_id "
-        "WHERE wh.user_id = ? AND wh.last_position > 0 AND wh.last_position < (v.duration * 0.9) "
-        "ORDER BY wh.last_watched DESC "
-        "LIMIT 5";
-
-    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        snprintf(json_output, max_len, "{\"status\":\"error\",\"message\":\"Database error\"}");
+        "SELECT video_id, last_position, last_watched, CAST(strftime('%s', last_watched) AS INTEGER) "
+        "FROM watch_history "
+        "WHERE user_id = ? AND last_position > 0 "
+        "ORDER BY last_watched DESC";
+
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        free(buffered);
+        catalog_release(catalog);
         return -1;
     }
 
     sqlite3_bind_int(stmt, 1, user_id);
 
-    // Initialize JSON builder
-    JSONBuilder builder;
-    json_builder_init(&builder, json_output, max_len);
-
     // Build JSON response: {"recommendations":[...]}
-    json_builder_start_object(&builder);
-    json_builder_start_array_field(&builder, "recommendations");
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "recommendations");
 
     int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Check buffer space
-        if (json_builder_remaining(&builder) < MAX_JSON_SMALL_BUFFER) {
-            fprintf(stderr, "[WARNING] Buffer nearly full, stopping at %d recommendations\n", count);
-            break;
+    int next = 0;
+    int has_row = sqlite3_step(stmt) == SQLITE_ROW;
+    while (count < 5 && (has_row || next < buffered_count)) {
+        if (next < buffered_count &&
+            (!has_row || buffered[next].updated_at >= sqlite3_column_int64(stmt, 3))) {
+            // Same format as datetime(): what the row will hold once flushed
+            const WatchProgress* entry = &buffered[next++];
+            char last_watched[32];
+            struct tm tm;
+            gmtime_r(&entry->updated_at, &tm);
+            strftime(last_watched, sizeof(last_watched), "%Y-%m-%d %H:%M:%S", &tm);
+            count += add_recommendation(builder, catalog, entry->video_id, entry->position, last_watched);
+            continue;
         }
 
         int video_id = sqlite3_column_int(stmt, 0);
-        const char* title = (const char*)sqlite3_column_text(stmt, 1);
-        const char* filename = (const char*)sqlite3_column_text(stmt, 2);
-        const char* thumbnail = sqlite3_column_text(stmt, 3) ?
-                                (const char*)sqlite3_column_text(stmt, 3) : "";
-        int duration = sqlite3_column_int(stmt, 4);
-        long file_size = sqlite3_column_int64(stmt, 5);
-        int last_position = sqlite3_column_int(stmt, 6);
-        const char* last_watched = (const char*)sqlite3_column_text(stmt, 7);
-
-        // Calculate progress percentage
-        int progress_percent = (duration > 0) ? (last_position * 100 / duration) : 0;
-
-        // Build recommendation object with extra fields
-        json_builder_start_object(&builder);
-        json_builder_add_int(&builder, "video_id", video_id);
-        json_builder_add_string(&builder, "title", title ? title : "Unknown");
-        json_builder_add_string(&builder, "filename", filename ? filename : "");
-        json_builder_add_string(&builder, "thumbnail", (thumbnail && strlen(thumbnail) > 0) ? thumbnail : "");
-        json_builder_add_int(&builder, "duration", duration);
-        json_builder_add_long(&builder, "file_size", file_size);
-        json_builder_add_int(&builder, "last_position", last_position);
-        json_builder_add_int(&builder, "progress_percent", progress_percent);
-        json_builder_add_string(&builder, "last_watched", last_watched ? last_watched : "");
-        json_builder_end_object(&builder);
-
-        count++;
+        if (!progress_has_video(buffered, buffered_count, video_id)) {
+            count += add_recommendation(builder, catalog, video_id, sqlite3_column_int(stmt, 1),
+                                        (const char*)sqlite3_column_text(stmt, 2));
+        }
+        has_row = sqlite3_step(stmt) == SQLITE_ROW;
     }
 
     // Close JSON array and object
-    json_builder_end_array(&builder);
-    json_builder_end_object(&builder);
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
 
-    sqlite3_finalize(stmt);
+    db_release(stmt);
+    free(buffered);
+    catalog_release(catalog);
 
     // Check for errors
-    if (json_builder_has_error(&builder)) {
+    if (json_builder_has_error(builder)) {
         fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
-        snprintf(json_output, max_len, "{\"status\":\"error\",\"message\":\"JSON generation failed\"}");
         return -1;
     }
 
@@ -648,187 +1030,178 @@ int get_recommended_videos(int user_id, char* json_output, size_t max_len) {
     return 0;
 }
 
-// Search videos by title
-int search_videos(const char* query, char* json_output, size_t max_len) {
-    if (!db || !query || !json_output || max_len == 0) {
+// Search videos by title (ranked; see search_index.h)
+int search_videos(const char* query, JSONBuilder* builder) {
+    if (!query || !builder) {
         return -1;
     }
 
-    sqlite3_stmt* stmt;
-    const char* sql =
-        "SELECT video_id, title, filename, thumbnail_path, duration, file_size "
-        "FROM videos "
-        "WHERE title LIKE ? "
-        "ORDER BY title ASC";
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
+        return -1;
+    }
+
+    SearchHit hits[SEARCH_MAX_RESULTS];
+    int total;
+    int count = search_index_query(catalog->search, catalog, query, hits, SEARCH_MAX_RESULTS, &total);
+
+    // Build JSON response: {"results":[...], "count": N, "total": M}
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "results");
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare search statement: %s\n", sqlite3_errmsg(db));
+    for (int i = 0; i < count; i++) {
+        // Cached video object; watched/last_position not applicable for search
+        size_t length;
+        const char* fragment = catalog_video_fragment(catalog, hits[i].index, &length);
+        json_builder_add_video_fragment(builder, fragment, length, 0, 0);
+    }
+
+    // Close array and add counts (total: all matches, results hold the best ones)
+    json_builder_end_array(builder);
+    json_builder_add_int(builder, "count", count);
+    json_builder_add_int(builder, "total", total);
+    json_builder_end_object(builder);
+
+    catalog_release(catalog);
+
+    // Check for errors
+    if (json_builder_has_error(builder)) {
+        fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
         return -1;
     }
 
-    // Create search pattern: %query%
-    char search_pattern[256];
-    snprintf(search_pattern, sizeof(search_pattern), "%%%s%%", query);
-    sqlite3_bind_text(stmt, 1, search_pattern, -1, SQLITE_TRANSIENT);
+    printf("  [API] Search for '%s' returned %d of %d results\n", query, count, total);
+    return 0;
+}
+
+// Autocomplete: most watched titles starting with prefix (see suggest_trie.h)
+int get_search_suggestions(const char* prefix, JSONBuilder* builder) {
+    if (!prefix || !builder) {
+        return -1;
+    }
 
-    // Initialize JSON builder
-    JSONBuilder builder;
-    json_builder_init(&builder, json_output, max_len);
+    const CatalogRanking* ranking = catalog_ranking_acquire();
+    if (!ranking) {
+        return -1;
+    }
 
-    // Build JSON response: {"results":[...], "count": N}
-    json_builder_start_object(&builder);
-    json_builder_start_array_field(&builder, "results");
+    const Catalog* catalog = ranking->catalog;
+    int indexes[SUGGEST_MAX_RESULTS];
+    int count = suggest_trie_lookup(ranking->suggest, prefix, indexes, SUGGEST_MAX_RESULTS);
 
-    int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Check buffer space
-        if (json_builder_remaining(&builder) < MAX_JSON_SMALL_BUFFER) {
-            fprintf(stderr, "[WARNING] Buffer nearly full, stopping search at %d results\n", count);
-            break;
-        }
+    // Build JSON response: {"suggestions":[{"video_id","title","views"}...], "count": N}
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "suggestions");
 
-        int video_id = sqlite3_column_int(stmt, 0);
-        const char* title = (const char*)sqlite3_column_text(stmt, 1);
-        const char* filename = (const char*)sqlite3_column_text(stmt, 2);
-        const char* thumbnail = (const char*)sqlite3_column_text(stmt, 3);
-        int duration = sqlite3_column_int(stmt, 4);
-        long file_size = sqlite3_column_int64(stmt, 5);
-
-        // Add video object (with proper escaping)
-        json_builder_add_video_object(
-            &builder,
-            video_id,
-            title,
-            filename,
-            thumbnail,
-            duration,
-            file_size,
-            0,  // watched flag not applicable for search
-            0   // last_position not applicable for search
-        );
+    for (int i = 0; i < count; i++) {
+        const Video* video = &catalog->videos[indexes[i]];
 
-        count++;
+        json_builder_start_object(builder);
+        json_builder_add_int(builder, "video_id", video->video_id);
+        json_builder_add_string(builder, "title", video->title);
+        json_builder_add_int(builder, "views", ranking->views[indexes[i]]);
+        json_builder_end_object(builder);
     }
 
-    // Close array and add count
-    json_builder_end_array(&builder);
-    json_builder_add_int(&builder, "count", count);
-    json_builder_end_object(&builder);
+    json_builder_end_array(builder);
+    json_builder_add_int(builder, "count", count);
+    json_builder_end_object(builder);
 
-    sqlite3_finalize(stmt);
+    catalog_ranking_release(ranking);
 
-    // Check for errors
-    if (json_builder_has_error(&builder)) {
+    if (json_builder_has_error(builder)) {
         fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
-        snprintf(json_output, max_len, "{\"status\":\"error\",\"message\":\"JSON generation failed\"}");
         return -1;
     }
 
-    printf("  [API] Search for '%s' returned %d results\n", query, count);
     return 0;
 }
 
 // Get all genres as JSON
-int get_genres_json(char* json_output, size_t max_len) {
-    if (!db || !json_output || max_len == 0) {
+int get_genres_json(JSONBuilder* builder) {
+    if (!builder) {
         return -1;
     }
 
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT genre_id, name, description FROM genres ORDER BY name ASC";
-
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare genres query: %s\n", sqlite3_errmsg(db));
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
         return -1;
     }
 
-    int offset = 0;
-    offset += snprintf(json_output, max_len, "{\"genres\":[");
+    // Build JSON response: {"genres":[...]}
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "genres");
 
     int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (count > 0) {
-            offset += snprintf(json_output + offset, max_len - offset, ",");
-        }
-
-        int genre_id = sqlite3_column_int(stmt, 0);
-        const char* name = (const char*)sqlite3_column_text(stmt, 1);
-        const char* description = (const char*)sqlite3_column_text(stmt, 2);
+    for (int i = 0; i < catalog->genre_count; i++) {
+        const CatalogGenre* genre = &catalog->genres[i];
 
-        offset += snprintf(json_output + offset, max_len - offset,
-            "{\"genre_id\":%d,\"name\":\"%s\",\"description\":\"%s\"}",
-            genre_id,
-            name ? name : "",
-            description ? description : ""
-        );
+        json_builder_start_object(builder);
+        json_builder_add_int(builder, "genre_id", genre->genre_id);
+        json_builder_add_string(builder, "name", genre->name);
+        json_builder_add_string(builder, "description", genre->description);
+        json_builder_end_object(builder);
 
         count++;
     }
 
-    offset += snprintf(json_output + offset, max_len - offset, "]}");
-    sqlite3_finalize(stmt);
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+    catalog_release(catalog);
+
+    if (json_builder_has_error(builder)) {
+        fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
+        return -1;
+    }
 
     printf("  [API] Returned %d genres\n", count);
     return 0;
 }
 
 // Get videos by genre ID
-int get_videos_by_genre(int genre_id, char* json_output, size_t max_len) {
-    if (!db || !json_output || max_len == 0) {
+int get_videos_by_genre(int genre_id, JSONBuilder* builder) {
+    if (!builder) {
         return -1;
     }
 
-    sqlite3_stmt* stmt;
-    const char* sql =
-        "SELECT v.video_id, v.title, v.filename, v.thumbnail_path, v.duration, v.file_size "
-        "FROM videos v "
-        "INNER JOIN video_genres vg ON v.video_id = vg.video_id "
-        "WHERE vg.genre_id = ? "
-        "ORDER BY v.title ASC";
-
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare videos by genre query: %s\n", sqlite3_errmsg(db));
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
         return -1;
     }
 
-    sqlite3_bind_int(stmt, 1, genre_id);
+    // Unknown genre: empty list, as before
+    const CatalogGenre* genre = catalog_find_genre(catalog, genre_id);
+    int member_count = genre ? genre->member_count : 0;
 
-    int offset = 0;
-    offset += snprintf(json_output, max_len, "{\"videos\":[");
+    // Build JSON response: {"videos":[...], "count": N}
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "videos");
 
     int count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (count > 0) {
-            offset += snprintf(json_output + offset, max_len - offset, ",");
-        }
-
-        int video_id = sqlite3_column_int(stmt, 0);
-        const char* title = (const char*)sqlite3_column_text(stmt, 1);
-        const char* filename = (const char*)sqlite3_column_text(stmt, 2);
-        const char* thumbnail = (const char*)sqlite3_column_text(stmt, 3);
-        int duration = sqlite3_column_int(stmt, 4);
-        long long file_size = sqlite3_column_int64(stmt, 5);
-
-        offset += snprintf(json_output + offset, max_len - offset,
-            "{\"video_id\":%d,"
-            "\"title\":\"%s\","
-            "\"filename\":\"%s\","
-            "\"thumbnail\":\"%s\","
-            "\"duration\":%d,"
-            "\"file_size\":%lld}",
-            video_id,
-            title ? title : "",
-            filename ? filename : "",
-            thumbnail ? thumbnail : "",
-            duration,
-            file_size
-        );
+    for (int i = 0; i < member_count; i++) {
+        const Video* video = &catalog->videos[genre->members[i]];
+
+        json_builder_start_object(builder);
+        json_builder_add_int(builder, "video_id", video->video_id);
+        json_builder_add_string(builder, "title", video->title);
+        json_builder_add_string(builder, "filename", video->filename);
+        json_builder_add_string(builder, "thumbnail", video->thumbnail_path);
+        json_builder_add_int(builder, "duration", video->duration);
+        json_builder_add_long(builder, "file_size", video->file_size);
+        json_builder_end_object(builder);
 
         count++;
     }
 
-    offset += snprintf(json_output + offset, max_len - offset, "],\"count\":%d}", count);
-    sqlite3_finalize(stmt);
+    json_builder_end_array(builder);
+    json_builder_add_int(builder, "count", count);
+    json_builder_end_object(builder);
+    catalog_release(catalog);
+
+    if (json_builder_has_error(builder)) {
+        fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
+        return -1;
+    }
 
     printf("  [API] Genre %d returned %d videos\n", genre_id, count);
     return 0;
@@ -843,8 +1216,8 @@ int assign_genre_to_video(int video_id, int genre_id) {
     sqlite3_stmt* stmt;
     const char* sql = "INSERT OR IGNORE INTO video_genres (video_id, genre_id) VALUES (?, ?)";
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare assign genre statement: %s\n", sqlite3_errmsg(db));
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare assign genre statement: %s\n", db_errmsg());
         return -1;
     }
 
@@ -852,77 +1225,82 @@ int assign_genre_to_video(int video_id, int genre_id) {
     sqlite3_bind_int(stmt, 2, genre_id);
 
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to assign genre: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to assign genre: %s\n", db_errmsg());
         return -1;
     }
 
+    catalog_invalidate();
     printf("  [DB] Assigned genre %d to video %d\n", genre_id, video_id);
     return 0;
 }
 
 // Get user's watchlist
-int get_watchlist(int user_id, char* json_output, size_t max_len) {
-    if (!db || !json_output || max_len == 0) {
+int get_watchlist(int user_id, JSONBuilder* builder) {
+    if (!db || !builder) {
+        return -1;
+    }
+
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
         return -1;
     }
 
     sqlite3_stmt* stmt;
     const char* sql =
-        "SELECT v.video_id, v.title, v.filename, v.thumbnail_path, v.duration, v.file_size, w.added_at "
-        "FROM videos v "
-        "INNER JOIN watchlist w ON v.video_id = w.video_id "
-        "WHERE w.user_id = ? "
-        "ORDER BY w.added_at DESC";
-
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare watchlist query: %s\n", sqlite3_errmsg(db));
+        "SELECT video_id, added_at "
+        "FROM watchlist "
+        "WHERE user_id = ? "
+        "ORDER BY added_at DESC";
+
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare watchlist query: %s\n", db_errmsg());
+        catalog_release(catalog);
         return -1;
     }
 
     sqlite3_bind_int(stmt, 1, user_id);
 
-    int offset = 0;
-    offset += snprintf(json_output, max_len, "{\"watchlist\":[");
+    // Build JSON response: {"watchlist":[...], "count": N}
+    json_builder_start_object(builder);
+    json_builder_start_array_field(builder, "watchlist");
 
     int count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (count > 0) {
-            offset += snprintf(json_output + offset, max_len - offset, ",");
+        int index = catalog_video_index(catalog, sqlite3_column_int(stmt, 0));
+        if (index < 0) {
+            continue;  // Video no longer in the catalog
         }
 
-        int video_id = sqlite3_column_int(stmt, 0);
-        const char* title = (const char*)sqlite3_column_text(stmt, 1);
-        const char* filename = (const char*)sqlite3_column_text(stmt, 2);
-        const char* thumbnail = (const char*)sqlite3_column_text(stmt, 3);
-        int duration = sqlite3_column_int(stmt, 4);
-        long long file_size = sqlite3_column_int64(stmt, 5);
-        const char* added_at = (const char*)sqlite3_column_text(stmt, 6);
-
-        offset += snprintf(json_output + offset, max_len - offset,
-            "{\"video_id\":%d,"
-            "\"title\":\"%s\","
-            "\"filename\":\"%s\","
-            "\"thumbnail\":\"%s\","
-            "\"duration\":%d,"
-            "\"file_size\":%lld,"
-            "\"added_at\":\"%s\"}",
-            video_id,
-            title ? title : "",
-            filename ? filename : "",
-            thumbnail ? thumbnail : "",
-            duration,
-            file_size,
-            added_at ? added_at : ""
-        );
+        const Video* video = &catalog->videos[index];
+        const char* added_at = (const char*)sqlite3_column_text(stmt, 1);
+
+        json_builder_start_object(builder);
+        json_builder_add_int(builder, "video_id", video->video_id);
+        json_builder_add_string(builder, "title", video->title);
+        json_builder_add_string(builder, "filename", video->filename);
+        json_builder_add_string(builder, "thumbnail", video->thumbnail_path);
+        json_builder_add_int(builder, "duration", video->duration);
+        json_builder_add_long(builder, "file_size", video->file_size);
+        json_builder_add_string(builder, "added_at", added_at ? added_at : "");
+        json_builder_end_object(builder);
 
         count++;
     }
 
-    offset += snprintf(json_output + offset, max_len - offset, "],\"count\":%d}", count);
-    sqlite3_finalize(stmt);
+    json_builder_end_array(builder);
+    json_builder_add_int(builder, "count", count);
+    json_builder_end_object(builder);
+
+    db_release(stmt);
+    catalog_release(catalog);
+
+    if (json_builder_has_error(builder)) {
+        fprintf(stderr, "[ERROR] JSON builder encountered an error\n");
+        return -1;
+    }
 
     printf("  [API] User %d has %d videos in watchlist\n", user_id, count);
     return 0;
@@ -937,8 +1315,8 @@ int add_to_watchlist(int user_id, int video_id) {
     sqlite3_stmt* stmt;
     const char* sql = "INSERT OR IGNORE INTO watchlist (user_id, video_id) VALUES (?, ?)";
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare add to watchlist statement: %s\n", sqlite3_errmsg(db));
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare add to watchlist statement: %s\n", db_errmsg());
         return -1;
     }
 
@@ -946,10 +1324,10 @@ int add_to_watchlist(int user_id, int video_id) {
     sqlite3_bind_int(stmt, 2, video_id);
 
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to add to watchlist: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to add to watchlist: %s\n", db_errmsg());
         return -1;
     }
 
@@ -966,8 +1344,8 @@ int remove_from_watchlist(int user_id, int video_id) {
     sqlite3_stmt* stmt;
     const char* sql = "DELETE FROM watchlist WHERE user_id = ? AND video_id = ?";
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare remove from watchlist statement: %s\n", sqlite3_errmsg(db));
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare remove from watchlist statement: %s\n", db_errmsg());
         return -1;
     }
 
@@ -975,10 +1353,10 @@ int remove_from_watchlist(int user_id, int video_id) {
     sqlite3_bind_int(stmt, 2, video_id);
 
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to remove from watchlist: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to remove from watchlist: %s\n", db_errmsg());
         return -1;
     }
 
@@ -995,8 +1373,8 @@ int is_in_watchlist(int user_id, int video_id) {
     sqlite3_stmt* stmt;
     const char* sql = "SELECT COUNT(*) FROM watchlist WHERE user_id = ? AND video_id = ?";
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare watchlist check statement: %s\n", sqlite3_errmsg(db));
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare watchlist check statement: %s\n", db_errmsg());
         return 0;
     }
 
@@ -1008,7 +1386,7 @@ int is_in_watchlist(int user_id, int video_id) {
         count = sqlite3_column_int(stmt, 0);
     }
 
-    sqlite3_finalize(stmt);
+    db_release(stmt);
     return count > 0 ? 1 : 0;
 }
 
@@ -1038,8 +1416,8 @@ int update_hls_path(int video_id, const char* hls_path, const char* status) {
     sqlite3_stmt* stmt;
     const char* sql = "UPDATE videos SET hls_path = ?, hls_status = ? WHERE video_id = ?";
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare HLS update statement: %s\n", sqlite3_errmsg(db));
+    if (db_prepare(sql, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare HLS update statement: %s\n", db_errmsg());
         return -1;
     }
 
@@ -1048,13 +1426,14 @@ int update_hls_path(int video_id, const char* hls_path, const char* status) {
     sqlite3_bind_int(stmt, 3, video_id);
 
     int result = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_release(stmt);
 
     if (result != SQLITE_DONE) {
-        fprintf(stderr, "Failed to update HLS path: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to update HLS path: %s\n", db_errmsg());
         return -1;
     }
 
+    catalog_invalidate();
     printf("  [DB] Updated HLS path for video %d: %s (status: %s)\n", video_id, hls_path, status);
     return 0;
 }
@@ -1068,41 +1447,206 @@ int update_hls_path(int video_id, const char* hls_path, const char* status) {
  * @return 0 on success, -1 on error or not found
  */
 int get_hls_path(int video_id, char* hls_path, size_t max_len) {
-    if (!db) {
-        fprintf(stderr, "Database not initialized\n");
-        return -1;
-    }
-
     if (!hls_path || max_len == 0) {
         fprintf(stderr, "Invalid parameters for get_hls_path\n");
         return -1;
     }
 
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT hls_path, hls_status FROM videos WHERE video_id = ?";
-
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare HLS path query: %s\n", sqlite3_errmsg(db));
+    const Catalog* catalog = catalog_acquire();
+    if (!catalog) {
+        fprintf(stderr, "Database not initialized\n");
         return -1;
     }
 
-    sqlite3_bind_int(stmt, 1, video_id);
-
     int result = -1;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* path = (const char*)sqlite3_column_text(stmt, 0);
-        const char* status = (const char*)sqlite3_column_text(stmt, 1);
+    int index = catalog_video_index(catalog, video_id);
+    if (index >= 0) {
+        const Video* video = &catalog->videos[index];
 
-        if (path && status && strcmp(status, "ready") == 0) {
-            strncpy(hls_path, path, max_len - 1);
+        if (video->hls_path[0] && strcmp(video->hls_status, "ready") == 0) {
+            strncpy(hls_path, video->hls_path, max_len - 1);
             hls_path[max_len - 1] = '\0';
             result = 0;
         } else {
             fprintf(stderr, "  [DB] HLS not ready for video %d (status: %s)\n",
-                    video_id, status ? status : "unknown");
+                    video_id, video->hls_status[0] ? video->hls_status : "unknown");
         }
     }
 
-    sqlite3_finalize(stmt);
+    catalog_release(catalog);
     return result;
 }
+
+// ============================================================================
+// Catalog Snapshot Loader
+// ============================================================================
+
+static void copy_text_column(char* dest, size_t size, sqlite3_stmt* stmt, int column) {
+    const char* text = (const char*)sqlite3_column_text(stmt, column);
+    snprintf(dest, size, "%s", text ? text : "");
+}
+
+/**
+ * Append video indexes for rows (video_id in column 0) until the statement
+ * is done; rows that are not in the snapshot are skipped
+ * Returns: number of indexes written (at most catalog->video_count)
+ */
+static int collect_video_indexes(Catalog* catalog, sqlite3_stmt* stmt, int* indexes) {
+    int count = 0;
+    while (count < catalog->video_count && sqlite3_step(stmt) == SQLITE_ROW) {
+        int index = catalog_video_index(catalog, sqlite3_column_int(stmt, 0));
+        if (index >= 0) {
+            indexes[count++] = index;
+        }
+    }
+    return count;
+}
+
+/**
+ * Read the catalog tables into a new snapshot
+ * All queries run in one read transaction, so the snapshot is consistent.
+ * Returns: snapshot (refcount 0, not yet published), or NULL on error
+ */
+struct Catalog* load_catalog(void) {
+    if (!db) return NULL;
+
+    Catalog* catalog = calloc(1, sizeof(Catalog));
+    if (!catalog || db_exec_cached("BEGIN") != 0) {
+        free(catalog);
+        return NULL;
+    }
+
+    int ok = 1;
+    int capacity = 0;
+    sqlite3_stmt* stmt;
+
+    // Videos, ordered by id for binary search
+    const char* videos_sql =
+        "SELECT video_id, title, filename, thumbnail_path, duration, file_size, hls_path, hls_status "
+        "FROM videos ORDER BY video_id";
+
+    ok = db_prepare(videos_sql, &stmt) == SQLITE_OK;
+    while (ok && sqlite3_step(stmt) == SQLITE_ROW) {
+        if (catalog->video_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            Video* grown = realloc(catalog->videos, capacity * sizeof(Video));
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            catalog->videos = grown;
+        }
+
+        Video* video = &catalog->videos[catalog->video_count++];
+        video->video_id = sqlite3_column_int(stmt, 0);
+        copy_text_column(video->title, sizeof(video->title), stmt, 1);
+        copy_text_column(video->filename, sizeof(video->filename), stmt, 2);
+        copy_text_column(video->thumbnail_path, sizeof(video->thumbnail_path), stmt, 3);
+        video->duration = sqlite3_column_int(stmt, 4);
+        video->file_size = sqlite3_column_int64(stmt, 5);
+        copy_text_column(video->hls_path, sizeof(video->hls_path), stmt, 6);
+        copy_text_column(video->hls_status, sizeof(video->hls_status), stmt, 7);
+    }
+    db_release(stmt);
+
+    // Title order (search results, genre listings)
+    catalog->by_title = malloc((catalog->video_count + 1) * sizeof(int));
+    stmt = NULL;
+    ok = ok && catalog->by_title && db_prepare("SELECT video_id FROM videos ORDER BY title ASC", &stmt) == SQLITE_OK;
+    if (ok) {
+        collect_video_indexes(catalog, stmt, catalog->by_title);
+        db_release(stmt);
+    }
+
+    // Genres, ordered by name
+    capacity = 0;
+    stmt = NULL;
+    ok = ok && db_prepare("SELECT genre_id, name, description FROM genres ORDER BY name ASC", &stmt) == SQLITE_OK;
+    while (ok && sqlite3_step(stmt) == SQLITE_ROW) {
+        if (catalog->genre_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            CatalogGenre* grown = realloc(catalog->genres, capacity * sizeof(CatalogGenre));
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            catalog->genres = grown;
+        }
+
+        CatalogGenre* genre = &catalog->genres[catalog->genre_count++];
+        memset(genre, 0, sizeof(*genre));
+        genre->genre_id = sqlite3_column_int(stmt, 0);
+        copy_text_column(genre->name, sizeof(genre->name), stmt, 1);
+        copy_text_column(genre->description, sizeof(genre->description), stmt, 2);
+    }
+    db_release(stmt);
+
+    // Genre membership, each list ordered by title
+    const char* members_sql =
+        "SELECT v.video_id FROM videos v "
+        "INNER JOIN video_genres vg ON v.video_id = vg.video_id "
+        "WHERE vg.genre_id = ? "
+        "ORDER BY v.title ASC";
+
+    int* scratch = malloc((catalog->video_count + 1) * sizeof(int));
+    stmt = NULL;
+    ok = ok && scratch && db_prepare(members_sql, &stmt) == SQLITE_OK;
+    for (int i = 0; ok && i < catalog->genre_count; i++) {
+        CatalogGenre* genre = &catalog->genres[i];
+
+        sqlite3_bind_int(stmt, 1, genre->genre_id);
+        int count = collect_video_indexes(catalog, stmt, scratch);
+        sqlite3_reset(stmt);
+
+        genre->members = malloc((count + 1) * sizeof(int));
+        if (!genre->members) {
+            ok = 0;
+            break;
+        }
+        memcpy(genre->members, scratch, count * sizeof(int));
+        genre->member_count = count;
+    }
+    db_release(stmt);
+    free(scratch);
+
+    db_exec_cached(ok ? "COMMIT" : "ROLLBACK");
+
+    if (!ok) {
+        fprintf(stderr, "Failed to load catalog: %s\n", db_errmsg());
+        catalog_destroy(catalog);
+        return NULL;
+    }
+
+    return catalog;
+}
+
+/**
+ * Viewers per video of a snapshot (one watch_history row per user and video)
+ * Returns: array indexed like catalog->videos (free() it), or NULL on error
+ */
+int* load_view_counts(const struct Catalog* catalog) {
+    if (!db) return NULL;
+
+    int* views = calloc(catalog->video_count + 1, sizeof(int));
+    sqlite3_stmt* stmt;
+    if (!views || db_prepare("SELECT video_id, COUNT(*) FROM watch_history GROUP BY video_id", &stmt) != SQLITE_OK) {
+        free(views);
+        return NULL;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int index = catalog_video_index(catalog, sqlite3_column_int(stmt, 0));
+        if (index >= 0) {
+            views[index] = sqlite3_column_int(stmt, 1);
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to load view counts: %s\n", db_errmsg());
+        free(views);
+        views = NULL;
+    }
+
+    db_release(stmt);
+    return views;
+}
@@ -0,0 +1,654 @@
+/*
+ * OTT Streaming Server - Event Loop
+ *
+ * Replaces fork-per-connection with epoll loops and a worker pool:
+ *   - Loop threads share the listening socket (EPOLLEXCLUSIVE) and read
+ *     requests into per-connection buffers without blocking
+ *   - Each client fd is armed with EPOLLONESHOT, so a connection is owned
+ *     either by its loop (reading / idle) or by one worker (handling)
+ *   - Workers switch the socket back to blocking mode and run the route
+ *     handlers unchanged (they write straight to client_fd); SO_SNDTIMEO
+ *     bounds how long a client that stopped reading can hold a worker
+ *   - File bodies (stream_file()) are not sent by the worker: the
+ *     connection goes back to its loop with a FileTransfer, which the loop
+ *     sends with sendfile() on each EPOLLOUT. A transfer that makes no
+ *     progress for SEND_TIMEOUT seconds is closed.
+ *
+ * Keep-alive: a worker serves every complete (pipelined) request in the
+ * buffer, then hands the connection back to its loop through a completion
+ * list + eventfd. Idle connections wait in a per-loop list ordered by
+ * deadline and are closed after KEEPALIVE_TIMEOUT seconds. Pipelined
+ * requests behind a file body wait until the body is sent.
+ */
+
+#define _GNU_SOURCE  // accept4()
+
+#include "../include/event_loop.h"
+#include "../include/server.h"
+#include "../include/routes.h"
+#include "../include/validation.h"
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/tcp.h>
+
+typedef struct EventLoop EventLoop;
+struct Connection;
+
+typedef struct {
+    struct Connection* head;
+    struct Connection* tail;
+} ConnectionList;
+
+// Per-connection state
+typedef struct Connection {
+    int fd;
+    EventLoop* loop;            // Loop that owns this connection
+    size_t length;              // Bytes buffered so far
+    int requests_served;
+    long long deadline_ms;      // Idle or send deadline while parked on the loop
+    struct Connection* prev;    // Deadline list links (next also links the done list)
+    struct Connection* next;
+    FileTransfer* transfer;     // File body being sent by the loop (or NULL)
+    int close_after_transfer;   // Last response on this connection
+    char client_ip[INET_ADDRSTRLEN];
+    char buffer[BUFFER_SIZE];   // Raw request(s) (always NUL terminated)
+} Connection;
+
+// Per-thread loop state
+struct EventLoop {
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;                // eventfd signalled when workers return connections
+    WorkerPool* pool;
+    pthread_t thread;
+
+    // Oldest deadline first (loop thread only). Each list has one fixed
+    // timeout, so appending keeps it sorted.
+    ConnectionList idle;        // Keep-alive connections waiting for a request
+    ConnectionList sending;     // File transfers waiting for EPOLLOUT
+
+    // Connections handed back by workers
+    pthread_mutex_t done_lock;
+    Connection* done_head;
+};
+
+// ============================================================================
+// Socket Helpers
+// ============================================================================
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int set_nonblocking(int fd, int enabled) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+
+    flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags);
+}
+
+static void close_connection(Connection* conn) {
+    file_transfer_free(conn->transfer);
+    close(conn->fd);
+    free(conn);
+}
+
+/**
+ * Re-arm a one-shot connection for the next readable event
+ */
+static int rearm_connection(Connection* conn) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    return epoll_ctl(conn->loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/**
+ * Length of the first complete request in the buffer (headers + body)
+ * Returns: request length, or 0 if more data is needed
+ */
+static size_t complete_request_length(char* buffer, size_t length) {
+    char* header_end = strstr(buffer, "\r\n\r\n");
+    if (!header_end) {
+        return 0;
+    }
+
+    size_t header_len = (size_t)(header_end - buffer) + 4;
+
+    // Only look for Content-Length inside this request's header block
+    char saved = buffer[header_len - 2];
+    buffer[header_len - 2] = '\0';
+
+    char value[32];
+    long body_len = 0;
+    if (find_header(buffer, "Content-Length", value, sizeof(value))) {
+        body_len = atol(value);
+    }
+
+    buffer[header_len - 2] = saved;
+
+    if (body_len < 0) {
+        body_len = 0;
+    }
+
+    if (header_len + (size_t)body_len > length) {
+        return 0;
+    }
+
+    return header_len + (size_t)body_len;
+}
+
+// ============================================================================
+// Deadline Lists (loop thread only)
+// ============================================================================
+
+static ConnectionList* deadline_list(EventLoop* loop, Connection* conn) {
+    return conn->transfer ? &loop->sending : &loop->idle;
+}
+
+/**
+ * Park a connection on its list: idle (KEEPALIVE_TIMEOUT) or sending (SEND_TIMEOUT)
+ */
+static void deadline_push(EventLoop* loop, Connection* conn) {
+    ConnectionList* list = deadline_list(loop, conn);
+    long long timeout = conn->transfer ? SEND_TIMEOUT : KEEPALIVE_TIMEOUT;
+
+    conn->deadline_ms = now_ms() + timeout * 1000LL;
+    conn->next = NULL;
+    conn->prev = list->tail;
+
+    if (list->tail) {
+        list->tail->next = conn;
+    } else {
+        list->head = conn;
+    }
+    list->tail = conn;
+}
+
+static void deadline_remove(EventLoop* loop, Connection* conn) {
+    ConnectionList* list = deadline_list(loop, conn);
+
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        list->head = conn->next;
+    }
+
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    } else {
+        list->tail = conn->prev;
+    }
+
+    conn->prev = conn->next = NULL;
+}
+
+/**
+ * Close the connections of a list whose deadline has passed
+ * Returns: milliseconds until the list's next deadline (-1 = none)
+ */
+static long long expire_list(EventLoop* loop, ConnectionList* list, long long now, const char* reason) {
+    while (list->head && list->head->deadline_ms <= now) {
+        Connection* conn = list->head;
+        deadline_remove(loop, conn);
+        printf("  [Conn %d] %s, connection closed\n\n", conn->fd, reason);
+        close_connection(conn);
+    }
+
+    return list->head ? list->head->deadline_ms - now : -1;
+}
+
+/**
+ * Close idle connections and stalled transfers whose deadline has passed
+ * Returns: epoll_wait() timeout until the next deadline (-1 = none)
+ */
+static int expire_connections(EventLoop* loop) {
+    long long now = now_ms();
+    long long idle = expire_list(loop, &loop->idle, now, "Keep-alive timeout");
+    long long sending = expire_list(loop, &loop->sending, now, "Send timeout");
+
+    if (idle < 0 || (sending >= 0 && sending < idle)) {
+        return (int)sending;
+    }
+    return (int)idle;
+}
+
+// ============================================================================
+// Request Handling (worker threads)
+// ============================================================================
+
+/**
+ * Handle one HTTP request: security checks, session lookup and route
+ * dispatch. Runs on a worker thread with client_fd in blocking mode.
+ * Returns: 1 if the connection may stay open, 0 if it must be closed
+ */
+static int serve_request(int client_fd, const char* buffer, int allow_keep_alive) {
+    // Parse HTTP request
+    HTTPRequest req = parse_http_request(buffer);
+    printf("  [Conn %d] %s %s\n", client_fd, req.method, req.path);
+
+    http_set_keep_alive(allow_keep_alive && request_wants_keep_alive(&req, buffer));
+    http_set_chunked(strcmp(req.version, "HTTP/1.1") == 0);
+    http_set_accept_encoding(req.accept_encoding);
+
+    // Security: Validate path to prevent directory traversal attacks
+    if (!is_path_safe(req.path)) {
+        send_403(client_fd, "Directory traversal attempt detected");
+        printf("  [Conn %d] Security violation\n", client_fd);
+        return http_keep_alive();
+    }
+
+    // Parse session from Cookie header
+    char cookie_header[MAX_COOKIE_LEN];
+    char session_id[SESSION_COOKIE_LENGTH];
+
+    if (!find_header(buffer, "Cookie", cookie_header, sizeof(cookie_header))) {
+        cookie_header[0] = '\0';
+    }
+
+    if (!parse_cookie(cookie_header, session_id, sizeof(session_id))) {
+        session_id[0] = '\0';
+    }
+
+    // Validate and refresh session (if present); handlers read req.user_id
+    req.user_id = -1;
+    req.username[0] = '\0';
+    if (session_id[0] != '\0' &&
+        session_lookup(session_id, &req.user_id, req.username, sizeof(req.username))) {
+        printf("  [Conn %d] Valid session: %s\n", client_fd, session_id);
+    } else {
+        session_id[0] = '\0';  // Clear invalid session
+    }
+
+    // Dispatch request to appropriate route handler
+    if (dispatch_route(client_fd, &req, session_id, buffer)) {
+        printf("  [Conn %d] Route handled successfully\n", client_fd);
+    } else {
+        printf("  [Conn %d] No matching route for %s %s\n", client_fd, req.method, req.path);
+        send_404(client_fd);
+    }
+
+    // Handlers clear the flag when a response could not be completed
+    return http_keep_alive();
+}
+
+/**
+ * Hand a kept-alive connection back to its loop thread
+ */
+static void return_to_loop(Connection* conn) {
+    EventLoop* loop = conn->loop;
+
+    pthread_mutex_lock(&loop->done_lock);
+    conn->next = loop->done_head;
+    loop->done_head = conn;
+    pthread_mutex_unlock(&loop->done_lock);
+
+    uint64_t one = 1;
+    if (write(loop->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("eventfd write");
+    }
+}
+
+/**
+ * Worker job: serve every complete request in the buffer (pipelining),
+ * then return the connection to its loop or close it
+ */
+static void connection_job(void* arg) {
+    Connection* conn = (Connection*)arg;
+    int keep_alive = 1;
+
+    // Route handlers use plain blocking send()/write()
+    set_nonblocking(conn->fd, 0);
+
+    while (keep_alive) {
+        size_t request_len = complete_request_length(conn->buffer, conn->length);
+        int allow_keep_alive = conn->requests_served + 1 < KEEPALIVE_MAX_REQUESTS;
+
+        if (request_len == 0) {
+            if (conn->length < BUFFER_SIZE - 1) {
+                break;  // Partial request: wait for the rest on the loop
+            }
+            // Oversized request: handle as-is (old single read() behaviour), then close
+            request_len = conn->length;
+            allow_keep_alive = 0;
+        }
+
+        // Cut at the request boundary so handlers never see the next pipelined request
+        char saved = conn->buffer[request_len];
+        conn->buffer[request_len] = '\0';
+
+        conn->requests_served++;
+        keep_alive = serve_request(conn->fd, conn->buffer, allow_keep_alive);
+
+        conn->buffer[request_len] = saved;
+        memmove(conn->buffer, conn->buffer + request_len, conn->length - request_len);
+        conn->length -= request_len;
+        conn->buffer[conn->length] = '\0';
+
+        // The loop sends the file body; later requests wait for it
+        conn->transfer = stream_take_transfer();
+        if (conn->transfer) {
+            conn->close_after_transfer = !keep_alive;
+            break;
+        }
+    }
+
+    if ((!keep_alive && !conn->transfer) || set_nonblocking(conn->fd, 1) < 0) {
+        printf("  [Conn %d] Connection closed\n\n", conn->fd);
+        close_connection(conn);
+        return;
+    }
+
+    return_to_loop(conn);
+}
+
+// ============================================================================
+// Loop Thread
+// ============================================================================
+
+static void accept_connections(EventLoop* loop) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        int client_fd = accept4(loop->listen_fd, (struct sockaddr*)&client_addr, &client_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("Accept failed");
+            }
+            return;
+        }
+
+        Connection* conn = malloc(sizeof(Connection));
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+
+        // Handlers write headers and body separately; with keep-alive, Nagle
+        // would hold the body back until the client's delayed ACK (~40ms)
+        int nodelay = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        // Workers write in blocking mode: give up on a client that stops reading
+        struct timeval send_timeout = { .tv_sec = SEND_TIMEOUT, .tv_usec = 0 };
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+        conn->fd = client_fd;
+        conn->loop = loop;
+        conn->length = 0;
+        conn->requests_served = 0;
+        conn->prev = conn->next = NULL;
+        conn->transfer = NULL;
+        conn->close_after_transfer = 0;
+        conn->buffer[0] = '\0';
+        inet_ntop(AF_INET, &client_addr.sin_addr, conn->client_ip, sizeof(conn->client_ip));
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            perror("epoll_ctl (client)");
+            close_connection(conn);
+            continue;
+        }
+
+        // Clients that connect but never send are reaped like idle keep-alives
+        deadline_push(loop, conn);
+        printf("✓ Client connected: %s (fd: %d)\n", conn->client_ip, client_fd);
+    }
+}
+
+/**
+ * Hand the connection to a worker if a full request is buffered,
+ * otherwise wait for more data
+ */
+static void dispatch_connection(EventLoop* loop, Connection* conn, int peer_closed) {
+    // A full buffer is handled as-is (same behaviour as the old single read())
+    int complete = complete_request_length(conn->buffer, conn->length) > 0 ||
+                   conn->length == BUFFER_SIZE - 1;
+
+    if (!complete) {
+        if (peer_closed || rearm_connection(conn) < 0) {
+            close_connection(conn);
+        } else {
+            deadline_push(loop, conn);
+        }
+        return;
+    }
+
+    if (worker_pool_submit(loop->pool, connection_job, conn) != 0) {
+        // Queue full: shed load instead of blocking the loop (the short
+        // response fits the empty socket buffer)
+        send_503(conn->fd);
+        close_connection(conn);
+    }
+}
+
+/**
+ * Drain readable data, then dispatch
+ */
+static void read_connection(EventLoop* loop, Connection* conn) {
+    int peer_closed = 0;
+
+    while (conn->length < BUFFER_SIZE - 1) {
+        ssize_t n = read(conn->fd, conn->buffer + conn->length, BUFFER_SIZE - 1 - conn->length);
+        if (n > 0) {
+            conn->length += (size_t)n;
+            continue;
+        }
+        if (n == 0) {
+            peer_closed = 1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            peer_closed = 1;
+        }
+        break;
+    }
+
+    conn->buffer[conn->length] = '\0';
+    dispatch_connection(loop, conn, peer_closed);
+}
+
+/**
+ * Send the pending file body as far as the socket allows; once done,
+ * serve the next pipelined request or wait for one
+ */
+static void send_transfer(EventLoop* loop, Connection* conn) {
+    int status = file_transfer_send(conn->transfer, conn->fd);
+
+    if (status == 0) {
+        struct epoll_event ev;
+        ev.events = EPOLLOUT | EPOLLONESHOT;
+        ev.data.ptr = conn;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+            close_connection(conn);
+            return;
+        }
+        deadline_push(loop, conn);
+        return;
+    }
+
+    if (status < 0 || conn->close_after_transfer) {
+        printf("  [Conn %d] Connection closed\n\n", conn->fd);
+        close_connection(conn);
+        return;
+    }
+
+    file_transfer_free(conn->transfer);
+    conn->transfer = NULL;
+    dispatch_connection(loop, conn, 0);
+}
+
+/**
+ * Take back connections finished by workers: send their file body, or
+ * wait for their next request
+ */
+static void collect_returned_connections(EventLoop* loop) {
+    uint64_t count;
+    if (read(loop->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        perror("eventfd read");
+    }
+
+    pthread_mutex_lock(&loop->done_lock);
+    Connection* conn = loop->done_head;
+    loop->done_head = NULL;
+    pthread_mutex_unlock(&loop->done_lock);
+
+    while (conn) {
+        Connection* next = conn->next;
+        conn->next = NULL;
+
+        if (conn->transfer) {
+            send_transfer(loop, conn);
+        } else if (rearm_connection(conn) < 0) {
+            close_connection(conn);
+        } else {
+            deadline_push(loop, conn);
+        }
+
+        conn = next;
+    }
+}
+
+static void* event_loop_main(void* arg) {
+    EventLoop* loop = (EventLoop*)arg;
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+
+    while (1) {
+        int timeout = expire_connections(loop);
+
+        int n = epoll_wait(loop->epoll_fd, events, EPOLL_MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+
+            if (ptr == NULL) {
+                accept_connections(loop);
+            } else if (ptr == loop) {
+                collect_returned_connections(loop);
+            } else {
+                Connection* conn = (Connection*)ptr;
+                deadline_remove(loop, conn);
+                if (conn->transfer) {
+                    send_transfer(loop, conn);
+                } else {
+                    read_connection(loop, conn);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+static int event_loop_init(EventLoop* loop, int server_fd, WorkerPool* pool) {
+    loop->listen_fd = server_fd;
+    loop->pool = pool;
+    pthread_mutex_init(&loop->done_lock, NULL);
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake_fd < 0) {
+        perror("eventfd");
+        close(loop->epoll_fd);
+        return -1;
+    }
+
+    // EPOLLEXCLUSIVE: wake one loop per incoming connection
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
+        perror("epoll_ctl (listen socket)");
+        goto fail;
+    }
+
+    // The loop itself is the eventfd's sentinel pointer
+    ev.events = EPOLLIN;
+    ev.data.ptr = loop;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) < 0) {
+        perror("epoll_ctl (eventfd)");
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    close(loop->wake_fd);
+    close(loop->epoll_fd);
+    return -1;
+}
+
+int event_loop_run(int server_fd, int num_loops, WorkerPool* pool) {
+    if (num_loops <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_loops = (cpus > 0) ? (int)cpus : 1;
+    }
+
+    if (set_nonblocking(server_fd, 1) < 0) {
+        perror("fcntl (listen socket)");
+        return -1;
+    }
+
+    EventLoop* loops = calloc(num_loops, sizeof(EventLoop));
+    if (!loops) {
+        return -1;
+    }
+
+    int started = 0;
+    for (int i = 0; i < num_loops; i++) {
+        if (event_loop_init(&loops[i], server_fd, pool) != 0) {
+            break;
+        }
+
+        if (pthread_create(&loops[i].thread, NULL, event_loop_main, &loops[i]) != 0) {
+            perror("pthread_create (event loop)");
+            close(loops[i].wake_fd);
+            close(loops[i].epoll_fd);
+            break;
+        }
+        started++;
+    }
+
+    if (started == 0) {
+        free(loops);
+        return -1;
+    }
+
+    printf("✓ Event loop running (%d epoll thread%s, keep-alive %ds)\n",
+           started, started == 1 ? "" : "s", KEEPALIVE_TIMEOUT);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(loops[i].thread, NULL);
+    }
+
+    free(loops);
+    return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * OTT Streaming Server - Open File Cache
+ *
+ * Chained hash table (path -> entry) plus an LRU list, guarded by one
+ * mutex. Lookups are short (hash + fstat), file I/O happens outside
+ * the lock.
+ */
+
+#include "../include/file_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+static FileCacheEntry* buckets[FILE_CACHE_BUCKETS];
+static FileCacheEntry* lru_head = NULL;     // Most recently used
+static FileCacheEntry* lru_tail = NULL;     // Eviction candidate
+static int cached_count = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Helpers (cache_lock held)
+// ============================================================================
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * FNV-1a hash of the path
+ */
+static unsigned int hash_path(const char* path) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash & (FILE_CACHE_BUCKETS - 1);
+}
+
+static int same_file(const FileCacheEntry* entry, const struct stat* st) {
+    return entry->dev == st->st_dev && entry->ino == st->st_ino &&
+           entry->size == (long)st->st_size && entry->mtime == st->st_mtime;
+}
+
+static void free_entry(FileCacheEntry* entry) {
+    close(entry->fd);
+    free(entry);
+}
+
+static void lru_unlink(FileCacheEntry* entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(FileCacheEntry* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = lru_head;
+
+    if (lru_head) {
+        lru_head->lru_prev = entry;
+    } else {
+        lru_tail = entry;
+    }
+    lru_head = entry;
+}
+
+/**
+ * Remove entry from the table; it is freed now if unused, otherwise by
+ * the last file_cache_release()
+ */
+static void detach_entry(FileCacheEntry* entry) {
+    FileCacheEntry** link = &buckets[hash_path(entry->path)];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+
+    lru_unlink(entry);
+    entry->cached = 0;
+    cached_count--;
+
+    if (entry->refcount == 0) {
+        free_entry(entry);
+    }
+}
+
+/**
+ * Evict least recently used entries until there is room for one more
+ */
+static void evict_for_insert(void) {
+    FileCacheEntry* entry = lru_tail;
+
+    while (cached_count >= FILE_CACHE_CAPACITY && entry) {
+        FileCacheEntry* prev = entry->lru_prev;
+        detach_entry(entry);
+        entry = prev;
+    }
+}
+
+/**
+ * Look up a cached entry and check that it still matches the file
+ * Returns: entry with a new reference, or NULL (miss or stale)
+ */
+static FileCacheEntry* lookup_entry(const char* path) {
+    FileCacheEntry* entry = buckets[hash_path(path)];
+    while (entry && strcmp(entry->path, path) != 0) {
+        entry = entry->hash_next;
+    }
+    if (!entry) {
+        return NULL;
+    }
+
+    // In-place modification: visible through the fd itself (no path walk)
+    struct stat st;
+    if (fstat(entry->fd, &st) != 0 || !same_file(entry, &st)) {
+        detach_entry(entry);
+        return NULL;
+    }
+
+    // Replaced or deleted path: periodic stat() of the path
+    long long now = now_ms();
+    if (now - entry->checked_ms >= FILE_CACHE_REVALIDATE_SEC * 1000LL) {
+        if (stat(path, &st) != 0 || !same_file(entry, &st)) {
+            detach_entry(entry);
+            return NULL;
+        }
+        entry->checked_ms = now;
+    }
+
+    entry->refcount++;
+    lru_unlink(entry);
+    lru_push_front(entry);
+    return entry;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+FileCacheEntry* file_cache_acquire(const char* path) {
+    if (strlen(path) >= MAX_PATH) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    FileCacheEntry* entry = lookup_entry(path);
+    pthread_mutex_unlock(&cache_lock);
+
+    if (entry) {
+        return entry;
+    }
+
+    // Miss: open outside the lock
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    entry = calloc(1, sizeof(FileCacheEntry));
+    if (!entry) {
+        close(fd);
+        return NULL;
+    }
+
+    entry->fd = fd;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->mode = st.st_mode;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->refcount = 1;
+    entry->checked_ms = now_ms();
+    strcpy(entry->path, path);
+
+    // Only regular files are shared (pipes/devices have no stable content)
+    if (!S_ISREG(st.st_mode)) {
+        return entry;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+
+    // Another thread may have opened the same path meanwhile
+    FileCacheEntry* existing = lookup_entry(path);
+    if (existing) {
+        pthread_mutex_unlock(&cache_lock);
+        free_entry(entry);
+        return existing;
+    }
+
+    evict_for_insert();
+
+    unsigned int bucket = hash_path(path);
+    entry->hash_next = buckets[bucket];
+    buckets[bucket] = entry;
+    lru_push_front(entry);
+    entry->cached = 1;
+    cached_count++;
+
+    pthread_mutex_unlock(&cache_lock);
+    return entry;
+}
+
+void file_cache_release(FileCacheEntry* entry) {
+    if (!entry) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    int unused = --entry->refcount == 0 && !entry->cached;
+    pthread_mutex_unlock(&cache_lock);
+
+    if (unused) {
+        free_entry(entry);
+    }
+}
+
+void file_cache_cleanup(void) {
+    pthread_mutex_lock(&cache_lock);
+    while (lru_head) {
+        detach_entry(lru_head);
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -4,9 +4,22 @@
  * Handles HTTP request parsing and response generation
  */
 
+#define _GNU_SOURCE  // strcasestr(), strptime(), timegm()
+
 #include "../include/server.h"
+#include "../include/compression.h"
 #include <ctype.h>
 
+// Whether the response currently being written by this thread keeps the
+// connection open (set per request by the event loop, see event_loop.c)
+static __thread int keep_alive_enabled = 0;
+
+// Whether the client accepts Transfer-Encoding: chunked (HTTP/1.1)
+static __thread int chunked_enabled = 0;
+
+// Content codings the client accepts (ACCEPT_* bitmask)
+static __thread int accepted_encodings = 0;
+
 /**
  * Convert hex char to int (0-15)
  */
@@ -40,6 +53,23 @@ static void url_decode(char* dst, const char* src) {
     *dst = '\0';
 }
 
+/**
+ * Parse If-None-Match / If-Modified-Since into cond
+ * An If-Modified-Since value that is not an IMF-fixdate is ignored.
+ */
+static void parse_conditional(const char* request, Conditional* cond) {
+    find_header(request, "If-None-Match", cond->if_none_match, sizeof(cond->if_none_match));
+
+    char date[64];
+    if (find_header(request, "If-Modified-Since", date, sizeof(date))) {
+        struct tm tm = {0};
+        const char* end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        if (end && *end == '\0') {
+            cond->if_modified_since = timegm(&tm);
+        }
+    }
+}
+
 /**
  * Parse HTTP request line
  * Example: "GET /video.mp4 HTTP/1.1"
@@ -53,15 +83,28 @@ HTTPRequest parse_http_request(const char* request) {
     // Parse request line
     sscanf(request, "%15s %511s %15s", req.method, raw_path, req.version);
 
-    // Remove query string from path (e.g., /page.html?param=value → /page.html)
+    // Split off the query string (e.g., /page.html?param=value → /page.html)
     char* query_start = strchr(raw_path, '?');
     if (query_start) {
         *query_start = '\0';  // Terminate path at '?'
+        snprintf(req.query, sizeof(req.query), "%s", query_start + 1);
     }
 
     // URL decode the path (e.g., %20 -> space, %EB%A8%B8 -> 머)
     url_decode(req.path, raw_path);
 
+    if (strcmp(req.method, "GET") == 0) {
+        // Validators: both header names start with "If-"
+        if (strcasestr(request, "\nIf-")) {
+            parse_conditional(request, &req.conditional);
+        }
+
+        char encodings[MAX_HEADER_LEN];
+        if (find_header(request, "Accept-Encoding", encodings, sizeof(encodings))) {
+            req.accept_encoding = parse_accept_encoding(encodings);
+        }
+    }
+
     return req;
 }
 
@@ -109,6 +152,45 @@ int find_header(const char* request, const char* header_name, char* value, size_
     return 1;
 }
 
+/**
+ * Get a URL-decoded query string parameter
+ * Example: "q=%EB%A8%B8%EB%8B%88&page=2" → get_query_param(req, "q") = "머니"
+ * Returns: 1 if found (value may be empty), 0 if not found
+ */
+int get_query_param(const HTTPRequest* req, const char* name, char* value, size_t value_size) {
+    size_t name_len = strlen(name);
+    const char* param = req->query;
+
+    while (*param) {
+        const char* end = strchr(param, '&');
+        size_t length = end ? (size_t)(end - param) : strlen(param);
+
+        if (length > name_len && strncmp(param, name, name_len) == 0 && param[name_len] == '=') {
+            // Decode into a bounded copy (decoding never makes text longer)
+            char encoded[MAX_PATH];
+            size_t value_len = length - name_len - 1;
+            if (value_len >= sizeof(encoded)) {
+                value_len = sizeof(encoded) - 1;
+            }
+            memcpy(encoded, param + name_len + 1, value_len);
+            encoded[value_len] = '\0';
+
+            char decoded[MAX_PATH];
+            url_decode(decoded, encoded);
+            snprintf(value, value_size, "%s", decoded);
+            return 1;
+        }
+
+        if (!end) {
+            break;
+        }
+        param = end + 1;
+    }
+
+    value[0] = '\0';
+    return 0;
+}
+
 /**
  * Get MIME type from filename extension
  */
@@ -129,6 +211,173 @@ const char* get_mime_type(const char* filename) {
 
 // is_path_safe() moved to validation.c for centralized security checks
 
+/**
+ * Decide whether the connection stays open after this request
+ * HTTP/1.1 is persistent unless "Connection: close"; HTTP/1.0 only with
+ * an explicit "Connection: keep-alive".
+ * Returns: 1 if the client allows keep-alive, 0 otherwise
+ */
+int request_wants_keep_alive(const HTTPRequest* req, const char* request) {
+    char connection[64];
+    int has_header = find_header(request, "Connection", connection, sizeof(connection));
+
+    if (strcmp(req->version, "HTTP/1.1") == 0) {
+        return !(has_header && strcasestr(connection, "close"));
+    }
+
+    return has_header && strcasestr(connection, "keep-alive");
+}
+
+/**
+ * Set/get keep-alive for the response being written by this thread
+ * Response writers must clear it if they cannot finish a framed response.
+ */
+void http_set_keep_alive(int enabled) {
+    keep_alive_enabled = enabled;
+}
+
+int http_keep_alive(void) {
+    return keep_alive_enabled;
+}
+
+/**
+ * Set/get whether the response being written may use chunked encoding
+ */
+void http_set_chunked(int enabled) {
+    chunked_enabled = enabled;
+}
+
+int http_chunked(void) {
+    return chunked_enabled;
+}
+
+/**
+ * Set/get the content codings accepted for the response being written
+ */
+void http_set_accept_encoding(int accepted) {
+    accepted_encodings = accepted;
+}
+
+int http_accept_encoding(void) {
+    return accepted_encodings;
+}
+
+/**
+ * Connection header line matching the current keep-alive state
+ */
+const char* http_connection_header(void) {
+    return keep_alive_enabled ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+}
+
+/**
+ * Check an If-None-Match list ("*" or quoted tags) against etag
+ * Weak comparison, as If-None-Match requires: W/ prefixes are ignored.
+ */
+static int etag_list_matches(const char* list, const char* etag) {
+    if (etag[0] == 'W' && etag[1] == '/') {
+        etag += 2;
+    }
+    size_t etag_len = strlen(etag);
+
+    const char* p = list;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (*p == '*') {
+            return 1;
+        }
+        if (p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        if (*p != '"') {
+            // Not a quoted tag: skip to the next list element
+            p = strchr(p, ',');
+            if (!p) {
+                break;
+            }
+            continue;
+        }
+
+        const char* close = strchr(p + 1, '"');
+        if (!close) {
+            break;
+        }
+        if ((size_t)(close + 1 - p) == etag_len && memcmp(p, etag, etag_len) == 0) {
+            return 1;
+        }
+        p = close + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Decide whether a GET can be answered with 304 Not Modified
+ * If-None-Match takes precedence; If-Modified-Since is only evaluated
+ * when it is absent (RFC 7232 section 6).
+ *
+ * @param etag Current entity tag (NULL = none)
+ * @param last_modified Current modification time (0 = unknown)
+ * Returns: 1 if the client's copy is current, 0 otherwise
+ */
+int http_not_modified(const Conditional* cond, const char* etag, time_t last_modified) {
+    if (cond->if_none_match[0]) {
+        return etag && etag_list_matches(cond->if_none_match, etag);
+    }
+
+    return cond->if_modified_since > 0 && last_modified > 0 &&
+           last_modified <= cond->if_modified_since;
+}
+
+/**
+ * Format "ETag:" and "Last-Modified:" header lines (either may be absent)
+ * Returns: length written
+ */
+int http_format_validators(char* out, size_t size, const char* etag, time_t last_modified) {
+    int len = 0;
+    out[0] = '\0';
+
+    if (etag) {
+        len += snprintf(out + len, size - len, "ETag: %s\r\n", etag);
+    }
+
+    if (last_modified > 0 && (size_t)len < size) {
+        struct tm tm;
+        char date[HTTP_DATE_LEN];
+        gmtime_r(&last_modified, &tm);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        len += snprintf(out + len, size - len, "Last-Modified: %s\r\n", date);
+    }
+
+    return (size_t)len < size ? len : (int)size - 1;
+}
+
+/**
+ * Send 304 Not Modified response (no body)
+ * Carries the validators and Vary the 200 response would have carried.
+ *
+ * @param vary The representation depends on Accept-Encoding
+ */
+void send_304(int client_fd, const char* etag, time_t last_modified, int vary) {
+    char validators[MAX_ETAG_LEN + HTTP_DATE_LEN + 32];
+    char response[256 + sizeof(validators)];
+
+    http_format_validators(validators, sizeof(validators), etag, last_modified);
+    int len = snprintf(response, sizeof(response),
+        "HTTP/1.1 304 Not Modified\r\n"
+        "%s"
+        "%s"
+        "%s"
+        "\r\n",
+        validators,
+        vary ? "Vary: Accept-Encoding\r\n" : "",
+        http_connection_header());
+
+    send(client_fd, response, len, 0);
+    printf("  → 304 Not Modified\n");
+}
+
 /**
  * Send 403 Forbidden response
  */
@@ -140,10 +389,11 @@ void send_403(int client_fd, const char* reason) {
         "HTTP/1.1 403 Forbidden\r\n"
         "Content-Type: text/html; charset=utf-8\r\n"
         "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
+        "%s"
         "\r\n"
         "<html><body><h1>403 Forbidden</h1><p>%s</p></body></html>",
         strlen("<html><body><h1>403 Forbidden</h1><p></p></body></html>") + strlen(message),
+        http_connection_header(),
         message);
 
     send(client_fd, response, strlen(response), 0);
@@ -154,14 +404,37 @@ void send_403(int client_fd, const char* reason) {
  * Send 404 Not Found response
  */
 void send_404(int client_fd) {
-    const char* response =
+    char response[256];
+
+    snprintf(response, sizeof(response),
         "HTTP/1.1 404 Not Found\r\n"
         "Content-Type: text/html; charset=utf-8\r\n"
-        "Content-Length: 47\r\n"
-        "Connection: close\r\n"
+        "Content-Length: 48\r\n"
+        "%s"
         "\r\n"
-        "<html><body><h1>404 Not Found</h1></body></html>";
+        "<html><body><h1>404 Not Found</h1></body></html>",
+        http_connection_header());
 
     send(client_fd, response, strlen(response), 0);
     printf("  → 404 Not Found\n");
 }
+
+/**
+ * Send 503 Service Unavailable response (server overloaded)
+ * Always closes the connection.
+ */
+void send_503(int client_fd) {
+    const char* response =
+        "HTTP/1.1 503 Service Unavailable\r\n"
+        "Content-Type: text/html; charset=utf-8\r\n"
+        "Content-Length: 58\r\n"
+        "Retry-After: 1\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "<html><body><h1>503 Service Unavailable</h1></body></html>";
+
+    // Matches the header: the connection is not reused after this
+    http_set_keep_alive(0);
+    send(client_fd, response, strlen(response), 0);
+    printf("  → 503 Service Unavailable\n");
+}
@@ -9,166 +9,1063 @@
 
 #include "../include/json.h"
 #include "../include/server.h"
+#include "../include/compression.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <limits.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// Request Body Parsing
+// ============================================================================
+
+typedef struct {
+    const char* pos;
+    const char* end;
+} JSONCursor;
+
+static void skip_whitespace(JSONCursor* cur) {
+    while (cur->pos < cur->end &&
+           (*cur->pos == ' ' || *cur->pos == '\t' || *cur->pos == '\n' || *cur->pos == '\r')) {
+        cur->pos++;
+    }
+}
+
+static int is_hex_digit(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
 
 /**
- * Parse integer value from JSON string
- * Simple parser for key-value pairs like "key":123
- * Returns: integer value or -1 on error
+ * Scan a string token starting at its opening quote
+ * Escapes are checked for form (\uXXXX needs four hex digits); surrogate
+ * pairing is checked when unescaping.
+ * On success view holds the contents (escapes not processed)
  */
-int parse_json_int(const char* json, const char* key) {
-    if (!json || !key) {
+static int scan_string(JSONCursor* cur, JSONView* view) {
+    const char* p = cur->pos + 1;
+
+    while (p < cur->end && *p != '"') {
+        if ((unsigned char)*p < 0x20) {
+            return -1;  // Raw control character
+        }
+        if (*p == '\\') {
+            p++;
+            if (p >= cur->end || !*p || !strchr("\"\\/bfnrtu", *p)) {
+                return -1;
+            }
+            if (*p == 'u') {
+                if (cur->end - p < 5 || !is_hex_digit(p[1]) || !is_hex_digit(p[2]) ||
+                    !is_hex_digit(p[3]) || !is_hex_digit(p[4])) {
+                    return -1;
+                }
+                p += 4;
+            }
+        }
+        p++;
+    }
+    if (p >= cur->end) {
         return -1;
     }
 
-    // Create search pattern: "key":
-    char search_pattern[256];
-    snprintf(search_pattern, sizeof(search_pattern), "\"%s\":", key);
+    view->data = cur->pos + 1;
+    view->length = p - view->data;
+    cur->pos = p + 1;
+    return 0;
+}
+
+static int scan_digits(JSONCursor* cur) {
+    const char* start = cur->pos;
+    while (cur->pos < cur->end && *cur->pos >= '0' && *cur->pos <= '9') {
+        cur->pos++;
+    }
+    return cur->pos > start ? 0 : -1;
+}
 
-    const char* pos = strstr(json, search_pattern);
-    if (!pos) {
+/**
+ * Scan a number: -?digits(.digits)?([eE][+-]?digits)?
+ */
+static int scan_number(JSONCursor* cur) {
+    if (*cur->pos == '-') {
+        cur->pos++;
+    }
+    if (scan_digits(cur) != 0) {
         return -1;
     }
+    if (cur->pos < cur->end && *cur->pos == '.') {
+        cur->pos++;
+        if (scan_digits(cur) != 0) {
+            return -1;
+        }
+    }
+    if (cur->pos < cur->end && (*cur->pos == 'e' || *cur->pos == 'E')) {
+        cur->pos++;
+        if (cur->pos < cur->end && (*cur->pos == '+' || *cur->pos == '-')) {
+            cur->pos++;
+        }
+        if (scan_digits(cur) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int scan_literal(JSONCursor* cur, const char* literal) {
+    size_t length = strlen(literal);
+    if ((size_t)(cur->end - cur->pos) < length || memcmp(cur->pos, literal, length) != 0) {
+        return -1;
+    }
+    cur->pos += length;
+    return 0;
+}
 
-    // Move past the key to the value
-    pos += strlen(search_pattern);
+/**
+ * Scan a string, number or literal
+ */
+static int scan_scalar(JSONCursor* cur) {
+    JSONView string;
 
-    // Skip whitespace
-    while (*pos && isspace(*pos)) {
-        pos++;
+    switch (*cur->pos) {
+        case '"': return scan_string(cur, &string);
+        case 't': return scan_literal(cur, "true");
+        case 'f': return scan_literal(cur, "false");
+        case 'n': return scan_literal(cur, "null");
+        default:  return scan_number(cur);
     }
+}
+
+/**
+ * Scan "key" and the colon of an object member, up to its value
+ */
+static int scan_member_key(JSONCursor* cur) {
+    JSONView key;
 
-    // Parse integer
-    return atoi(pos);
+    if (cur->pos >= cur->end || *cur->pos != '"' || scan_string(cur, &key) != 0) {
+        return -1;
+    }
+    skip_whitespace(cur);
+    if (cur->pos >= cur->end || *cur->pos != ':') {
+        return -1;
+    }
+    cur->pos++;
+    skip_whitespace(cur);
+    return 0;
 }
 
 /**
- * Parse string value from JSON string
- * Simple parser for key-value pairs like "key":"value"
- * Returns: 0 on success, -1 on error
+ * Scan a nested object or array, validating every member and element
+ * Iterative, with a stack of open containers up to JSON_MAX_DEPTH.
+ */
+static int scan_container(JSONCursor* cur) {
+    char closers[JSON_MAX_DEPTH];
+    int depth = 0;
+
+    for (;;) {
+        // A value: open a container or scan a scalar
+        if (cur->pos >= cur->end) {
+            return -1;
+        }
+        char c = *cur->pos;
+        if (c == '{' || c == '[') {
+            if (depth == JSON_MAX_DEPTH) {
+                return -1;
+            }
+            closers[depth++] = (c == '{') ? '}' : ']';
+            cur->pos++;
+            skip_whitespace(cur);
+
+            if (cur->pos < cur->end && *cur->pos != closers[depth - 1]) {
+                // First member or element
+                if (c == '{' && scan_member_key(cur) != 0) {
+                    return -1;
+                }
+                continue;
+            }
+            // Empty: closed below
+        } else if (scan_scalar(cur) != 0) {
+            return -1;
+        }
+
+        // After a value: close containers until the next member or element
+        for (;;) {
+            skip_whitespace(cur);
+            if (cur->pos >= cur->end) {
+                return -1;
+            }
+            if (*cur->pos == closers[depth - 1]) {
+                cur->pos++;
+                if (--depth == 0) {
+                    return 0;
+                }
+                continue;
+            }
+            if (*cur->pos != ',') {
+                return -1;
+            }
+            cur->pos++;
+            skip_whitespace(cur);
+            if (closers[depth - 1] == '}' && scan_member_key(cur) != 0) {
+                return -1;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Scan any value; nested objects and arrays are validated and skipped
+ * as a whole (see scan_container)
  */
-int parse_json_string(const char* json, const char* key, char* output, size_t max_len) {
-    if (!json || !key || !output || max_len == 0) {
+static int scan_value(JSONCursor* cur, JSONField* field) {
+    const char* start = cur->pos;
+
+    switch (*cur->pos) {
+        case '"':
+            field->type = JSON_VALUE_STRING;
+            if (scan_string(cur, &field->value) != 0) {
+                return -1;
+            }
+            return 0;
+        case 't':
+        case 'f':
+            field->type = JSON_VALUE_BOOL;
+            break;
+        case 'n':
+            field->type = JSON_VALUE_NULL;
+            break;
+        case '{':
+        case '[':
+            field->type = (*cur->pos == '{') ? JSON_VALUE_OBJECT : JSON_VALUE_ARRAY;
+            if (scan_container(cur) != 0) {
+                return -1;
+            }
+            field->value.data = start;
+            field->value.length = cur->pos - start;
+            return 0;
+        default:
+            field->type = JSON_VALUE_NUMBER;
+            break;
+    }
+
+    if (scan_scalar(cur) != 0) {
+        return -1;
+    }
+    field->value.data = start;
+    field->value.length = cur->pos - start;
+    return 0;
+}
+
+int json_index_parse(JSONIndex* index, const char* json, size_t length) {
+    if (!index || !json) {
         return -1;
     }
 
-    // Create search pattern: "key":"
-    char search_pattern[256];
-    snprintf(search_pattern, sizeof(search_pattern), "\"%s\":\"", key);
+    JSONCursor cur = {json, json + length};
+    index->count = 0;
 
-    const char* start = strstr(json, search_pattern);
-    if (!start) {
+    skip_whitespace(&cur);
+    if (cur.pos >= cur.end || *cur.pos != '{') {
         return -1;
     }
+    cur.pos++;
+
+    skip_whitespace(&cur);
+    if (cur.pos < cur.end && *cur.pos == '}') {
+        cur.pos++;
+    } else {
+        for (;;) {
+            if (index->count == JSON_INDEX_MAX_FIELDS) {
+                return -1;
+            }
+            JSONField* field = &index->fields[index->count];
+
+            // "key"
+            if (cur.pos >= cur.end || *cur.pos != '"' || scan_string(&cur, &field->key) != 0) {
+                return -1;
+            }
+
+            // :
+            skip_whitespace(&cur);
+            if (cur.pos >= cur.end || *cur.pos != ':') {
+                return -1;
+            }
+            cur.pos++;
+
+            // value
+            skip_whitespace(&cur);
+            if (cur.pos >= cur.end || scan_value(&cur, field) != 0) {
+                return -1;
+            }
+            index->count++;
+
+            // , or }
+            skip_whitespace(&cur);
+            if (cur.pos >= cur.end) {
+                return -1;
+            }
+            if (*cur.pos == '}') {
+                cur.pos++;
+                break;
+            }
+            if (*cur.pos != ',') {
+                return -1;
+            }
+            cur.pos++;
+            skip_whitespace(&cur);
+        }
+    }
 
-    // Move past the key to the value start
-    start += strlen(search_pattern);
+    // Only whitespace may follow the object
+    skip_whitespace(&cur);
+    return cur.pos == cur.end ? 0 : -1;
+}
+
+const JSONField* json_index_find(const JSONIndex* index, const char* key) {
+    size_t key_len = strlen(key);
 
-    // Find closing quote
-    const char* end = strchr(start, '"');
-    if (!end) {
+    for (int i = 0; i < index->count; i++) {
+        const JSONField* field = &index->fields[i];
+        if (field->key.length == key_len && memcmp(field->key.data, key, key_len) == 0) {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+int json_index_int(const JSONIndex* index, const char* key, int fallback) {
+    const JSONField* field = json_index_find(index, key);
+    if (!field || field->type != JSON_VALUE_NUMBER) {
+        return fallback;
+    }
+
+    // Integer part only; the scanner already checked the syntax
+    const char* p = field->value.data;
+    const char* end = p + field->value.length;
+    int negative = (*p == '-');
+    if (negative) {
+        p++;
+    }
+
+    long long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        if (value > (long long)INT_MAX + 1) {
+            return fallback;
+        }
+        p++;
+    }
+
+    // Exponents are not worth supporting for ids and positions
+    if (p < end && *p != '.') {
+        return fallback;
+    }
+
+    value = negative ? -value : value;
+    if (value > INT_MAX || value < INT_MIN) {
+        return fallback;
+    }
+    return (int)value;
+}
+
+static int hex4(const char* p, unsigned int* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        *value <<= 4;
+        if (c >= '0' && c <= '9') *value |= c - '0';
+        else if (c >= 'a' && c <= 'f') *value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') *value |= c - 'A' + 10;
+        else return -1;
+    }
+    return 0;
+}
+
+/**
+ * Encode a code point as UTF-8
+ * Returns: bytes written (1-4)
+ */
+static size_t utf8_encode(unsigned int cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+int json_index_string(const JSONIndex* index, const char* key, char* output, size_t max_len) {
+    if (!output || max_len == 0) {
         return -1;
     }
 
-    // Calculate length and copy
-    size_t len = end - start;
-    if (len >= max_len) {
-        len = max_len - 1;
+    const JSONField* field = json_index_find(index, key);
+    if (!field || field->type != JSON_VALUE_STRING) {
+        return -1;
     }
 
-    strncpy(output, start, len);
-    output[len] = '\0';
+    const char* p = field->value.data;
+    const char* end = p + field->value.length;
+    size_t out_pos = 0;
+
+    while (p < end) {
+        char decoded[4];
+        size_t decoded_len = 1;
+
+        if (*p != '\\') {
+            decoded[0] = *p++;
+        } else {
+            p++;  // The scanner guarantees a character after the backslash
+            switch (*p++) {
+                case '"':  decoded[0] = '"';  break;
+                case '\\': decoded[0] = '\\'; break;
+                case '/':  decoded[0] = '/';  break;
+                case 'b':  decoded[0] = '\b'; break;
+                case 'f':  decoded[0] = '\f'; break;
+                case 'n':  decoded[0] = '\n'; break;
+                case 'r':  decoded[0] = '\r'; break;
+                case 't':  decoded[0] = '\t'; break;
+                case 'u': {
+                    unsigned int cp;
+                    if (end - p < 4 || hex4(p, &cp) != 0) {
+                        return -1;
+                    }
+                    p += 4;
+
+                    // Surrogate pair (outside the Basic Multilingual Plane)
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        unsigned int low;
+                        if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || hex4(p + 2, &low) != 0 ||
+                            low < 0xDC00 || low > 0xDFFF) {
+                            return -1;
+                        }
+                        p += 6;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                        return -1;
+                    } else if (cp == 0) {
+                        return -1;  // Would end the C string early
+                    }
+
+                    decoded_len = utf8_encode(cp, decoded);
+                    break;
+                }
+                default:
+                    return -1;
+            }
+        }
 
+        if (out_pos + decoded_len >= max_len) {
+            break;  // Truncate
+        }
+        memcpy(output + out_pos, decoded, decoded_len);
+        out_pos += decoded_len;
+    }
+
+    output[out_pos] = '\0';
     return 0;
 }
 
+// ============================================================================
+// String Escaping
+// ============================================================================
+
+/**
+ * Whether a byte is written escaped: " \ / and control characters
+ */
+static inline int is_special(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\' || c == '/';
+}
+
+#if defined(__AVX2__)
+/**
+ * Bit i set if byte i of the block is special (UTF-8 bytes are >= 0x80
+ * and never match)
+ */
+static inline unsigned int special_mask32(__m256i v) {
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')),
+                        // v <= 0x1F (unsigned)
+                        _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v)));
+    return (unsigned int)_mm256_movemask_epi8(special);
+}
+#endif
+
+#if defined(__SSE2__)
+static inline unsigned int special_mask16(__m128i v) {
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')),
+                     _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v)));
+    return (unsigned int)_mm_movemask_epi8(special);
+}
+#endif
+
+/**
+ * Write one special byte escaped
+ * Returns: bytes written (1 or 2)
+ */
+static size_t escape_byte(char c, char* out) {
+    char escaped;
+    switch (c) {
+        case '"':  escaped = '"';  break;
+        case '\\': escaped = '\\'; break;
+        case '/':  escaped = '/';  break;
+        case '\b': escaped = 'b';  break;
+        case '\f': escaped = 'f';  break;
+        case '\n': escaped = 'n';  break;
+        case '\r': escaped = 'r';  break;
+        case '\t': escaped = 't';  break;
+        default:
+            // Other control characters are passed through unchanged
+            out[0] = c;
+            return 1;
+    }
+
+    out[0] = '\\';
+    out[1] = escaped;
+    return 2;
+}
+
+size_t json_escape_bytes(const char* input, size_t length, char* output) {
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+
+    // Each block is stored as is, then the output position only advances
+    // up to the first special byte. Blocks are only read with a full block
+    // of input left and out_pos <= 2 * in_pos, so the store stays within
+    // the 2 * length + 1 byte output.
+#if defined(__AVX2__)
+    while (in_pos + 32 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(input + in_pos));
+        _mm256_storeu_si256((__m256i*)(output + out_pos), v);
+
+        unsigned int mask = special_mask32(v);
+        if (mask == 0) {
+            in_pos += 32;
+            out_pos += 32;
+            continue;
+        }
+
+        unsigned int run = __builtin_ctz(mask);
+        in_pos += run;
+        out_pos += run;
+        out_pos += escape_byte(input[in_pos++], output + out_pos);
+    }
+#endif
+
+#if defined(__SSE2__)
+    while (in_pos + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(input + in_pos));
+        _mm_storeu_si128((__m128i*)(output + out_pos), v);
+
+        unsigned int mask = special_mask16(v);
+        if (mask == 0) {
+            in_pos += 16;
+            out_pos += 16;
+            continue;
+        }
+
+        unsigned int run = __builtin_ctz(mask);
+        in_pos += run;
+        out_pos += run;
+        out_pos += escape_byte(input[in_pos++], output + out_pos);
+    }
+#endif
+
+    // Scalar fallback and the last < 16 bytes
+    while (in_pos < length) {
+        char c = input[in_pos++];
+        if (is_special((unsigned char)c)) {
+            out_pos += escape_byte(c, output + out_pos);
+        } else {
+            output[out_pos++] = c;
+        }
+    }
+
+    output[out_pos] = '\0';
+    return out_pos;
+}
+
 /**
  * Escape special characters for JSON string
  * Handles: " \ / \b \f \n \r \t
+ * Output that does not fit in max_len is truncated.
  */
 int json_escape_string(const char* input, char* output, size_t max_len) {
     if (!input || !output || max_len < 2) {
         return -1;
     }
 
+    size_t length = strlen(input);
+
+    // Escaping at most doubles the input: fits without bounds checks
+    if (length < max_len / 2) {
+        json_escape_bytes(input, length, output);
+        return 0;
+    }
+
+    size_t in_pos = 0;
     size_t out_pos = 0;
-    const char* in_pos = input;
-
-    while (*in_pos && out_pos < max_len - 2) {
-        switch (*in_pos) {
-            case '"':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = '"';
-                break;
-            case '\\':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = '\\';
-                break;
-            case '/':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = '/';
-                break;
-            case '\b':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = 'b';
-                break;
-            case '\f':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = 'f';
-                break;
-            case '\n':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = 'n';
-                break;
-            case '\r':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = 'r';
-                break;
-            case '\t':
-                if (out_pos + 2 >= max_len) return -1;
-                output[out_pos++] = '\\';
-                output[out_pos++] = 't';
-                break;
-            default:
-                output[out_pos++] = *in_pos;
-                break;
-        }
-        in_pos++;
+    while (in_pos < length && out_pos < max_len - 2) {
+        out_pos += escape_byte(input[in_pos++], output + out_pos);
     }
 
     output[out_pos] = '\0';
     return 0;
 }
 
+/**
+ * writev() until every iovec is sent (advances iov on partial writes)
+ * Returns: 0 on success, -1 on error
+ */
+static int writev_all(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
 /**
  * Send JSON response with HTTP 200 OK
  */
 void send_json_response(int client_fd, const char* json_body) {
-    char response[BUFFER_SIZE * 2];
+    char header[HTTP_RESPONSE_HEADER_SIZE];
+    size_t body_len = strlen(json_body);
 
-    snprintf(response, sizeof(response),
+    int header_len = snprintf(header, sizeof(header),
              "%s"
              "Content-Type: application/json; charset=UTF-8\r\n"
              "Content-Length: %zu\r\n"
              "Cache-Control: no-cache\r\n"
-             "\r\n"
-             "%s",
+             "%s"
+             "\r\n",
              HTTP_200_OK,
-             strlen(json_body),
-             json_body);
+             body_len,
+             http_connection_header());
 
-    write(client_fd, response, strlen(response));
+    // Body is sent from the caller's buffer, not copied next to the header
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = (void*)json_body;
+    iov[1].iov_len = body_len;
+
+    if (writev_all(client_fd, iov, 2) != 0) {
+        http_set_keep_alive(0);
+    }
+}
+
+/**
+ * Write iov[0..count), then the builder's unsent chunks, then trailer
+ * Returns: 0 on success, -1 on error
+ */
+static int write_builder_chunks(int fd, struct iovec* iov, int count,
+                                const JSONBuilder* builder, const char* trailer) {
+    // The tail's length is only synced when the builder grows
+    for (const JSONChunk* chunk = &builder->first; chunk; chunk = chunk->next) {
+        size_t length = (chunk == builder->tail) ? builder->offset : chunk->length;
+        if (length == 0) {
+            continue;
+        }
+
+        // Keep one slot for the trailer
+        if (count == JSON_WRITEV_MAX - 1) {
+            if (writev_all(fd, iov, count) != 0) {
+                return -1;
+            }
+            count = 0;
+        }
+
+        iov[count].iov_base = chunk->data;
+        iov[count].iov_len = length;
+        count++;
+    }
+
+    if (trailer) {
+        iov[count].iov_base = (void*)trailer;
+        iov[count].iov_len = strlen(trailer);
+        count++;
+    }
+
+    return writev_all(fd, iov, count);
+}
+
+/**
+ * Send a compressed JSON body with HTTP 200 OK
+ * The tag is sent weak: the bytes differ from the identity response.
+ * Returns: 0 on success, -1 on write error
+ */
+static int send_compressed_json(int client_fd, const char* data, size_t length,
+                                ContentEncoding encoding, const char* etag) {
+    char header[HTTP_RESPONSE_HEADER_SIZE];
+    char weak_etag[MAX_ETAG_LEN + 2];
+    char validators[MAX_ETAG_LEN + 16];
+
+    validators[0] = '\0';
+    if (etag) {
+        snprintf(weak_etag, sizeof(weak_etag), "W/%s", etag);
+        http_format_validators(validators, sizeof(validators), weak_etag, 0);
+    }
+
+    int header_len = snprintf(header, sizeof(header),
+             "%s"
+             "Content-Type: application/json; charset=UTF-8\r\n"
+             "Content-Encoding: %s\r\n"
+             "Content-Length: %zu\r\n"
+             "Cache-Control: no-cache\r\n"
+             "Vary: Accept-Encoding\r\n"
+             "%s"
+             "%s"
+             "\r\n",
+             HTTP_200_OK,
+             encoding_name(encoding),
+             length,
+             validators,
+             http_connection_header());
+
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = length;
+
+    return writev_all(client_fd, iov, 2);
+}
+
+/**
+ * Compress a builder's whole output and send it (cached if it has a key)
+ * Returns: 0 if sent (or the write failed), -1 if compression failed and
+ *          nothing was sent
+ */
+static int send_compressed_builder(int client_fd, const JSONBuilder* builder, ContentEncoding encoding) {
+    int chunks = 0;
+    for (const JSONChunk* chunk = &builder->first; chunk; chunk = chunk->next) {
+        chunks++;
+    }
+
+    struct iovec* iov = malloc(chunks * sizeof(struct iovec));
+    if (!iov) {
+        return -1;
+    }
+
+    int count = 0;
+    for (const JSONChunk* chunk = &builder->first; chunk; chunk = chunk->next) {
+        size_t length = (chunk == builder->tail) ? builder->offset : chunk->length;
+        if (length > 0) {
+            iov[count].iov_base = chunk->data;
+            iov[count].iov_len = length;
+            count++;
+        }
+    }
+
+    // A cached body is compressed once per catalog version: spend more CPU on it
+    int cached = builder->etag && builder->resource;
+    int level;
+    if (encoding == ENCODING_BROTLI) {
+        level = cached ? COMPRESS_CACHED_BROTLI_QUALITY : COMPRESS_BROTLI_QUALITY;
+    } else {
+        level = cached ? COMPRESS_CACHED_GZIP_LEVEL : COMPRESS_GZIP_LEVEL;
+    }
+
+    char* compressed = NULL;
+    size_t length = compress_iov(encoding, level, iov, count, &compressed);
+    free(iov);
+    if (length == 0) {
+        return -1;
+    }
+
+    if (cached) {
+        compressed_cache_store(builder->etag, builder->resource, encoding, compressed, length);
+    }
+
+    if (send_compressed_json(client_fd, compressed, length, encoding, builder->etag) != 0) {
+        http_set_keep_alive(0);
+    }
+
+    free(compressed);
+    return 0;
+}
+
+/**
+ * Header of a streamed response (Transfer-Encoding: chunked)
+ * A compressed stream sends its tag weak, like send_compressed_json().
+ * Returns: header length
+ */
+static int format_stream_header(char* header, size_t size, const JSONBuilder* builder) {
+    char validators[MAX_ETAG_LEN + 16];
+    char encoding[48] = "";
+
+    if (builder->compressor) {
+        char weak_etag[MAX_ETAG_LEN + 2];
+        snprintf(weak_etag, sizeof(weak_etag), "W/%s", builder->etag);
+        http_format_validators(validators, sizeof(validators), weak_etag, 0);
+        snprintf(encoding, sizeof(encoding), "Content-Encoding: %s\r\n",
+                 encoding_name(stream_compressor_encoding(builder->compressor)));
+    } else {
+        http_format_validators(validators, sizeof(validators), builder->etag, 0);
+    }
+
+    return snprintf(header, size,
+             "%s"
+             "Content-Type: application/json; charset=UTF-8\r\n"
+             "%s"
+             "Transfer-Encoding: chunked\r\n"
+             "Cache-Control: no-cache\r\n"
+             "Vary: Accept-Encoding\r\n"
+             "%s"
+             "%s"
+             "\r\n",
+             HTTP_200_OK,
+             encoding,
+             validators,
+             http_connection_header());
+}
+
+/**
+ * Compress the buffered output and send what the compressor produced as
+ * one chunk; finish ends the response and caches the whole compressed body
+ * Returns: 0 on success, -1 on error
+ */
+static int send_compressed_chunk(const JSONBuilder* builder, int finish) {
+    StreamCompressor* compressor = builder->compressor;
+    size_t before;
+    stream_compressor_output(compressor, &before);
+
+    for (const JSONChunk* chunk = &builder->first; chunk; chunk = chunk->next) {
+        size_t length = (chunk == builder->tail) ? builder->offset : chunk->length;
+        if (length > 0 && stream_compressor_write(compressor, chunk->data, length) != 0) {
+            return -1;
+        }
+    }
+    if (finish && stream_compressor_finish(compressor) != 0) {
+        return -1;
+    }
+
+    size_t after;
+    const char* output = stream_compressor_output(compressor, &after);
+
+    char header[HTTP_RESPONSE_HEADER_SIZE];
+    int header_len = 0;
+    if (builder->streamed == 0) {
+        header_len = format_stream_header(header, sizeof(header), builder);
+    }
+
+    struct iovec iov[3];
+    int count = 1;
+    const char* trailer = finish ? "0\r\n\r\n" : "";
+    if (after > before) {
+        header_len += snprintf(header + header_len, sizeof(header) - header_len, "%zx\r\n", after - before);
+        iov[1].iov_base = (void*)(output + before);
+        iov[1].iov_len = after - before;
+        count = 2;
+        trailer = finish ? "\r\n0\r\n\r\n" : "\r\n";
+    }
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+    iov[count].iov_base = (void*)trailer;
+    iov[count].iov_len = strlen(trailer);
+    count++;
+
+    if (writev_all(builder->stream_fd, iov, count) != 0) {
+        return -1;
+    }
+
+    if (finish) {
+        compressed_cache_store(builder->etag, builder->resource,
+                               stream_compressor_encoding(compressor), output, after);
+        printf("  → 200 OK: %zu bytes (%s, streamed)\n", after,
+               encoding_name(stream_compressor_encoding(compressor)));
+    }
+    return 0;
+}
+
+int send_cached_json(int client_fd, const char* etag, const char* resource) {
+    ContentEncoding encoding = choose_encoding(http_accept_encoding());
+    if (encoding == ENCODING_IDENTITY || !etag[0]) {
+        return 0;
+    }
+
+    CompressedBody* body = compressed_cache_acquire(etag, resource, encoding);
+    if (!body) {
+        return 0;
+    }
+
+    if (send_compressed_json(client_fd, body->data, body->length, encoding, etag) != 0) {
+        http_set_keep_alive(0);
+    }
+    printf("  → 200 OK: %zu bytes (%s, cached)\n", body->length, encoding_name(encoding));
+
+    compressed_cache_release(body);
+    return 1;
+}
+
+/**
+ * Send builder output with HTTP 200 OK
+ */
+void send_json_builder_response(int client_fd, const JSONBuilder* builder) {
+    char header[HTTP_RESPONSE_HEADER_SIZE];
+    size_t length = json_builder_length(builder);
+    const char* trailer = NULL;
+    int header_len;
+
+    // Streamed per-user lists are never compressed (see json_stream_flush)
+    int per_user = builder->stream_fd >= 0 && !(builder->etag && builder->resource);
+    if (builder->streamed == 0 && length >= COMPRESS_MIN_SIZE && !per_user) {
+        ContentEncoding encoding = choose_encoding(http_accept_encoding());
+        if (encoding != ENCODING_IDENTITY && send_compressed_builder(client_fd, builder, encoding) == 0) {
+            return;
+        }
+    }
+
+    if (builder->streamed > 0 && builder->compressor) {
+        if (send_compressed_chunk(builder, 1) != 0) {
+            http_set_keep_alive(0);
+        }
+        return;
+    }
+
+    if (builder->streamed > 0) {
+        // Header already sent: last data chunk and the terminating chunk
+        header_len = 0;
+        trailer = "0\r\n\r\n";
+        if (length > 0) {
+            header_len = snprintf(header, sizeof(header), "%zx\r\n", length);
+            trailer = "\r\n0\r\n\r\n";
+        }
+    } else {
+        char validators[MAX_ETAG_LEN + 16];
+        http_format_validators(validators, sizeof(validators), builder->etag, 0);
+        header_len = snprintf(header, sizeof(header),
+                 "%s"
+                 "Content-Type: application/json; charset=UTF-8\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Cache-Control: no-cache\r\n"
+                 "Vary: Accept-Encoding\r\n"
+                 "%s"
+                 "%s"
+                 "\r\n",
+                 HTTP_200_OK,
+                 length,
+                 validators,
+                 http_connection_header());
+    }
+
+    struct iovec iov[JSON_WRITEV_MAX];
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+
+    if (write_builder_chunks(client_fd, iov, 1, builder, trailer) != 0) {
+        http_set_keep_alive(0);
+    }
+}
+
+/**
+ * Send a stream builder's buffered output as one chunk
+ */
+int json_stream_flush(JSONBuilder* builder) {
+    size_t length = json_builder_length(builder);
+    if (length == 0 || !http_chunked()) {
+        return 1;
+    }
+
+    // Compress cached lists as they stream (compressed once per catalog
+    // version); per-user lists go out uncompressed, which keeps their
+    // memory constant and costs no CPU per request
+    if (builder->streamed == 0 && builder->etag && builder->resource) {
+        ContentEncoding encoding = choose_encoding(http_accept_encoding());
+        if (encoding != ENCODING_IDENTITY) {
+            int level = encoding == ENCODING_BROTLI ? COMPRESS_CACHED_BROTLI_QUALITY
+                                                    : COMPRESS_CACHED_GZIP_LEVEL;
+            builder->compressor = stream_compressor_create(encoding, level);
+        }
+    }
+
+    if (builder->compressor) {
+        if (send_compressed_chunk(builder, 0) != 0) {
+            http_set_keep_alive(0);
+            return -1;
+        }
+        builder->streamed += length;
+        json_builder_rewind(builder);
+        return 0;
+    }
+
+    char header[HTTP_RESPONSE_HEADER_SIZE];
+    int header_len = 0;
+
+    if (builder->streamed == 0) {
+        header_len = format_stream_header(header, sizeof(header), builder);
+    }
+    header_len += snprintf(header + header_len, sizeof(header) - header_len, "%zx\r\n", length);
+
+    struct iovec iov[JSON_WRITEV_MAX];
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+
+    if (write_builder_chunks(builder->stream_fd, iov, 1, builder, "\r\n") != 0) {
+        http_set_keep_alive(0);
+        return -1;
+    }
+
+    builder->streamed += length;
+    json_builder_rewind(builder);
+    return 0;
+}
+
+/**
+ * Report a failed builder response
+ */
+void send_json_builder_error(int client_fd, const JSONBuilder* builder,
+                             int status_code, const char* error_message) {
+    if (builder->streamed > 0) {
+        // Status already sent: end the response without its last chunk so
+        // the client sees it as incomplete
+        fprintf(stderr, "⚠️  JSON stream aborted after %zu bytes: %s\n",
+                builder->streamed, error_message);
+        http_set_keep_alive(0);
+        return;
+    }
+
+    send_json_error(client_fd, status_code, error_message);
 }
 
 /**
@@ -214,10 +1111,12 @@ void send_json_error(int client_fd, int status_code, const char* error_message)
              "%s"
              "Content-Type: application/json; charset=UTF-8\r\n"
              "Content-Length: %zu\r\n"
+             "%s"
              "\r\n"
              "%s",
              status_line,
              strlen(json_body),
+             http_connection_header(),
              json_body);
 
     write(client_fd, response, strlen(response));
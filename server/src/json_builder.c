@@ -4,14 +4,23 @@
  * Provides reusable JSON generation with automatic escaping and
  * buffer management.
  *
+ * Every write first reserves its full size with reserve(): fixed
+ * builders fail, arena builders move to a new chunk, stream builders
+ * flush to the socket first. A value is never
+ * split across chunks; strings are escaped directly into the reserved
+ * space (escaping at most doubles them).
+ *
  * Author: Network Programming Final Project
  * Date: 2025-11-13
  */
 
 #include "../include/json_builder.h"
-#include "../include/json.h"  // For json_escape_string
+#include "../include/json.h"  // For json_escape_bytes
+#include "../include/compression.h"
 #include "../include/config.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 // ============================================================================
@@ -25,22 +34,161 @@ void json_builder_init(JSONBuilder* builder, char* buffer, size_t capacity) {
     builder->element_count = 0;
     builder->error = 0;
 
+    builder->growable = 0;
+    builder->first.next = NULL;
+    builder->first.data = buffer;
+    builder->first.length = 0;
+    builder->first.capacity = capacity;
+    builder->tail = &builder->first;
+    builder->sealed = 0;
+
+    builder->stream_fd = -1;
+    builder->streamed = 0;
+    builder->compressor = NULL;
+
+    builder->etag = NULL;
+    builder->resource = NULL;
+
     if (buffer && capacity > 0) {
         buffer[0] = '\0';
     }
 }
 
+void json_builder_init_arena(JSONBuilder* builder, char* buffer, size_t capacity) {
+    json_builder_init(builder, buffer, capacity);
+    builder->growable = 1;
+}
+
+void json_builder_init_stream(JSONBuilder* builder, int client_fd, char* buffer, size_t capacity) {
+    json_builder_init_arena(builder, buffer, capacity);
+    builder->stream_fd = client_fd;
+}
+
+static void free_chunks(JSONBuilder* builder) {
+    JSONChunk* chunk = builder->first.next;
+    while (chunk) {
+        JSONChunk* next = chunk->next;
+        free(chunk);  // Header and data are one allocation
+        chunk = next;
+    }
+
+    builder->first.next = NULL;
+    builder->tail = &builder->first;
+}
+
+void json_builder_free(JSONBuilder* builder) {
+    free_chunks(builder);
+    stream_compressor_free(builder->compressor);
+    builder->compressor = NULL;
+}
+
+size_t json_builder_length(const JSONBuilder* builder) {
+    return builder->sealed + builder->offset;
+}
+
+void json_builder_rewind(JSONBuilder* builder) {
+    free_chunks(builder);
+
+    builder->buffer = builder->first.data;
+    builder->capacity = builder->first.capacity;
+    builder->offset = 0;
+    builder->sealed = 0;
+    builder->first.length = 0;
+
+    if (builder->buffer && builder->capacity > 0) {
+        builder->buffer[0] = '\0';
+    }
+}
+
 int json_builder_has_error(const JSONBuilder* builder) {
     return builder->error;
 }
 
 size_t json_builder_remaining(const JSONBuilder* builder) {
+    if (builder->growable) {
+        return SIZE_MAX;
+    }
     if (builder->offset >= builder->capacity) {
         return 0;
     }
     return builder->capacity - builder->offset;
 }
 
+/**
+ * Make room for `needed` bytes plus the terminating NUL in the current chunk
+ * Returns: 1 if the write can proceed, 0 on error (error flag set)
+ */
+static int reserve(JSONBuilder* builder, size_t needed) {
+    if (builder->error) {
+        return 0;
+    }
+
+    if (builder->offset < builder->capacity && builder->capacity - builder->offset > needed) {
+        return 1;
+    }
+
+    if (!builder->growable) {
+        builder->error = 1;
+        return 0;
+    }
+
+    // Stream mode: send what is buffered and start over in the first buffer
+    if (builder->stream_fd >= 0) {
+        int flushed = json_stream_flush(builder);
+        if (flushed < 0) {
+            builder->error = 1;
+            return 0;
+        }
+        if (flushed == 0 && builder->capacity > needed) {
+            return 1;
+        }
+        // Not flushed (HTTP/1.0) or one value larger than the buffer: grow
+    }
+
+    // Seal the tail and continue in a new chunk
+    size_t size = JSON_ARENA_CHUNK_SIZE;
+    if (needed + 1 > size) {
+        size = needed + 1;
+    }
+
+    JSONChunk* chunk = malloc(sizeof(JSONChunk) + size);
+    if (!chunk) {
+        builder->error = 1;
+        return 0;
+    }
+
+    chunk->next = NULL;
+    chunk->data = (char*)(chunk + 1);
+    chunk->length = 0;
+    chunk->capacity = size;
+
+    builder->tail->length = builder->offset;
+    builder->tail->next = chunk;
+    builder->tail = chunk;
+    builder->sealed += builder->offset;
+
+    builder->buffer = chunk->data;
+    builder->capacity = size;
+    builder->offset = 0;
+    return 1;
+}
+
+/**
+ * Copy bytes into space obtained from reserve() and keep the NUL terminator
+ */
+static void append(JSONBuilder* builder, const char* data, size_t length) {
+    memcpy(builder->buffer + builder->offset, data, length);
+    builder->offset += length;
+    builder->buffer[builder->offset] = '\0';
+}
+
+/**
+ * Escape value straight into reserved space (at most 2x its length)
+ */
+static void append_escaped(JSONBuilder* builder, const char* value, size_t length) {
+    builder->offset += json_escape_bytes(value, length, builder->buffer + builder->offset);
+}
+
 // ============================================================================
 // Low-Level Helpers
 // ============================================================================
@@ -50,16 +198,11 @@ void json_builder_add_separator(JSONBuilder* builder) {
         return;
     }
 
-    if (json_builder_remaining(builder) < 2) {
-        builder->error = 1;
+    if (!reserve(builder, 1)) {
         return;
     }
 
-    builder->offset += snprintf(
-        builder->buffer + builder->offset,
-        builder->capacity - builder->offset,
-        ","
-    );
+    append(builder, ",", 1);
 }
 
 void json_builder_add_raw(JSONBuilder* builder, const char* text) {
@@ -67,18 +210,12 @@ void json_builder_add_raw(JSONBuilder* builder, const char* text) {
         return;
     }
 
-    size_t remaining = json_builder_remaining(builder);
-    if (remaining < strlen(text) + 1) {
-        builder->error = 1;
+    size_t length = strlen(text);
+    if (!reserve(builder, length)) {
         return;
     }
 
-    builder->offset += snprintf(
-        builder->buffer + builder->offset,
-        builder->capacity - builder->offset,
-        "%s",
-        text
-    );
+    append(builder, text, length);
 }
 
 // ============================================================================
@@ -124,31 +261,22 @@ void json_builder_add_string(JSONBuilder* builder, const char* key, const char*
         return;
     }
 
-    // Escape the value
-    char escaped[MAX_ESCAPE_BUFFER];
-    if (json_escape_string(value, escaped, sizeof(escaped)) != 0) {
-        fprintf(stderr, "[JSON Builder] Failed to escape string: %s\n", value);
-        builder->error = 1;
-        return;
-    }
-
     json_builder_add_separator(builder);
 
-    size_t remaining = json_builder_remaining(builder);
-    size_t needed = strlen(key) + strlen(escaped) + 10;  // "key":"value", + safety
+    // "key":"value" with the value escaped in place (escaping at most doubles it)
+    size_t key_len = strlen(key);
+    size_t value_len = strlen(value);
+    size_t needed = key_len + 2 * value_len + 6;
 
-    if (remaining < needed) {
-        builder->error = 1;
+    if (!reserve(builder, needed)) {
         return;
     }
 
-    builder->offset += snprintf(
-        builder->buffer + builder->offset,
-        builder->capacity - builder->offset,
-        "\"%s\":\"%s\"",
-        key,
-        escaped
-    );
+    append(builder, "\"", 1);
+    append(builder, key, key_len);
+    append(builder, "\":\"", 3);
+    append_escaped(builder, value, value_len);
+    append(builder, "\"", 1);
 
     builder->element_count++;
 }
@@ -160,8 +288,7 @@ void json_builder_add_int(JSONBuilder* builder, const char* key, int value) {
 
     json_builder_add_separator(builder);
 
-    if (json_builder_remaining(builder) < 50) {
-        builder->error = 1;
+    if (!reserve(builder, 50)) {
         return;
     }
 
@@ -183,8 +310,7 @@ void json_builder_add_long(JSONBuilder* builder, const char* key, long value) {
 
     json_builder_add_separator(builder);
 
-    if (json_builder_remaining(builder) < 50) {
-        builder->error = 1;
+    if (!reserve(builder, 50)) {
         return;
     }
 
@@ -206,8 +332,7 @@ void json_builder_add_bool(JSONBuilder* builder, const char* key, int value) {
 
     json_builder_add_separator(builder);
 
-    if (json_builder_remaining(builder) < 50) {
-        builder->error = 1;
+    if (!reserve(builder, 50)) {
         return;
     }
 
@@ -229,8 +354,7 @@ void json_builder_add_null(JSONBuilder* builder, const char* key) {
 
     json_builder_add_separator(builder);
 
-    if (json_builder_remaining(builder) < 50) {
-        builder->error = 1;
+    if (!reserve(builder, 50)) {
         return;
     }
 
@@ -253,30 +377,18 @@ void json_builder_add_string_element(JSONBuilder* builder, const char* value) {
         return;
     }
 
-    // Escape the value
-    char escaped[MAX_ESCAPE_BUFFER];
-    if (json_escape_string(value, escaped, sizeof(escaped)) != 0) {
-        fprintf(stderr, "[JSON Builder] Failed to escape string element: %s\n", value);
-        builder->error = 1;
-        return;
-    }
-
     json_builder_add_separator(builder);
 
-    size_t remaining = json_builder_remaining(builder);
-    size_t needed = strlen(escaped) + 5;  // "value", + safety
+    size_t value_len = strlen(value);
+    size_t needed = 2 * value_len + 3;  // "value" (escaped in place)
 
-    if (remaining < needed) {
-        builder->error = 1;
+    if (!reserve(builder, needed)) {
         return;
     }
 
-    builder->offset += snprintf(
-        builder->buffer + builder->offset,
-        builder->capacity - builder->offset,
-        "\"%s\"",
-        escaped
-    );
+    append(builder, "\"", 1);
+    append_escaped(builder, value, value_len);
+    append(builder, "\"", 1);
 
     builder->element_count++;
 }
@@ -288,8 +400,7 @@ void json_builder_add_int_element(JSONBuilder* builder, int value) {
 
     json_builder_add_separator(builder);
 
-    if (json_builder_remaining(builder) < 20) {
-        builder->error = 1;
+    if (!reserve(builder, 20)) {
         return;
     }
 
@@ -314,8 +425,7 @@ void json_builder_start_array_field(JSONBuilder* builder, const char* key) {
 
     json_builder_add_separator(builder);
 
-    if (json_builder_remaining(builder) < strlen(key) + 10) {
-        builder->error = 1;
+    if (!reserve(builder, strlen(key) + 10)) {
         return;
     }
 
@@ -330,6 +440,26 @@ void json_builder_start_array_field(JSONBuilder* builder, const char* key) {
     builder->element_count = 0;  // Reset for array elements
 }
 
+/**
+ * Fields of a video object that do not depend on the user
+ */
+static void add_video_static_fields(
+    JSONBuilder* builder,
+    int video_id,
+    const char* title,
+    const char* filename,
+    const char* thumbnail,
+    int duration,
+    long file_size
+) {
+    json_builder_add_int(builder, "video_id", video_id);
+    json_builder_add_string(builder, "title", title ? title : "Unknown");
+    json_builder_add_string(builder, "filename", filename ? filename : "");
+    json_builder_add_string(builder, "thumbnail", (thumbnail && strlen(thumbnail) > 0) ? thumbnail : "");
+    json_builder_add_int(builder, "duration", duration);
+    json_builder_add_long(builder, "file_size", file_size);
+}
+
 void json_builder_add_video_object(
     JSONBuilder* builder,
     int video_id,
@@ -353,14 +483,66 @@ void json_builder_add_video_object(
 
     json_builder_start_object(builder);
 
-    json_builder_add_int(builder, "video_id", video_id);
-    json_builder_add_string(builder, "title", title ? title : "Unknown");
-    json_builder_add_string(builder, "filename", filename ? filename : "");
-    json_builder_add_string(builder, "thumbnail", (thumbnail && strlen(thumbnail) > 0) ? thumbnail : "");
-    json_builder_add_int(builder, "duration", duration);
-    json_builder_add_long(builder, "file_size", file_size);
+    add_video_static_fields(builder, video_id, title, filename, thumbnail, duration, file_size);
     json_builder_add_bool(builder, "watched", watched);
     json_builder_add_int(builder, "last_position", last_position);
 
     json_builder_end_object(builder);
 }
+
+int json_video_fragment(
+    char* output,
+    size_t max_len,
+    int video_id,
+    const char* title,
+    const char* filename,
+    const char* thumbnail,
+    int duration,
+    long file_size
+) {
+    JSONBuilder builder;
+    json_builder_init(&builder, output, max_len);
+
+    json_builder_start_object(&builder);
+    add_video_static_fields(&builder, video_id, title, filename, thumbnail, duration, file_size);
+
+    return json_builder_has_error(&builder) ? -1 : (int)builder.offset;
+}
+
+void json_builder_add_video_fragment(
+    JSONBuilder* builder,
+    const char* fragment,
+    size_t length,
+    int watched,
+    int last_position
+) {
+    static const char unwatched[] = ",\"watched\":false,\"last_position\":0}";
+
+    if (builder->error) {
+        return;
+    }
+
+    json_builder_add_separator(builder);
+
+    // Fragment + per-user fields (at most the "false" prefix and an int)
+    if (!reserve(builder, length + sizeof(unwatched) + 12)) {
+        return;
+    }
+
+    append(builder, fragment, length);
+
+    // Most catalog entries are unwatched: one constant copy
+    if (!watched && last_position == 0) {
+        append(builder, unwatched, sizeof(unwatched) - 1);
+    } else {
+        const char* prefix = watched ? ",\"watched\":true,\"last_position\":"
+                                     : ",\"watched\":false,\"last_position\":";
+        append(builder, prefix, strlen(prefix));
+
+        char digits[16];
+        int digits_len = snprintf(digits, sizeof(digits), "%d}", last_position);
+        append(builder, digits, digits_len);
+    }
+
+    builder->element_count++;
+}
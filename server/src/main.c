@@ -7,106 +7,177 @@
  * Author: Generated for Network Programming Final Project
  * Date: 2025-11-03
  * Refactored: 2025-11-13
+ *
+ * Usage: ./ott_server [--workers N] [--max-sessions N] [--session-tokens]
+ *   --workers 0   single process, one epoll loop per CPU (default)
+ *   --workers N   prefork: N worker processes, each with its own
+ *                 SO_REUSEPORT listener, SQLite handle and event loop;
+ *                 the master supervises and respawns them
+ *   --max-sessions N   session store capacity (default MAX_SESSIONS)
+ *   --session-tokens   stateless signed session cookies (key in SESSION_KEY_PATH)
  */
 
 #include "../include/server.h"
 #include "../include/database.h"
+#include "../include/catalog.h"
 #include "../include/json.h"
 #include "../include/routes.h"
 #include "../include/video_scanner.h"
 #include "../include/ffmpeg_utils.h"
 #include "../include/validation.h"
+#include "../include/event_loop.h"
+#include "../include/worker_pool.h"
+#include "../include/file_cache.h"
+#include "../include/compression.h"
+#include "../include/progress_buffer.h"
+#include "../include/session_token.h"
+#include <pthread.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/wait.h>
 
-// Signal handler for child process cleanup (zombie prevention)
-void sigchld_handler(int sig) {
-    (void)sig;  // Unused parameter
-    // Reap all dead child processes
-    while (waitpid(-1, NULL, WNOHANG) > 0);
+// Worker exit status meaning "respawning will not help" (e.g. bind failed)
+#define WORKER_EXIT_FATAL 2
+
+static pid_t master_pid;                // Only the master owns shm/semaphore cleanup
+static pid_t* worker_pids = NULL;       // Prefork mode only
+static int num_workers = 0;
+static volatile sig_atomic_t shutting_down = 0;
+
+/**
+ * Stop prefork workers (async-signal-safe: kill/waitpid only)
+ */
+static void stop_workers(void) {
+    for (int i = 0; i < num_workers; i++) {
+        if (worker_pids[i] > 0) {
+            kill(worker_pids[i], SIGTERM);
+        }
+    }
+    for (int i = 0; i < num_workers; i++) {
+        if (worker_pids[i] > 0) {
+            waitpid(worker_pids[i], NULL, 0);
+            worker_pids[i] = 0;
+        }
+    }
 }
 
 // Signal handler for graceful shutdown
 void sigint_handler(int sig) {
     (void)sig;
+    shutting_down = 1;
     printf("\n\n🛑 Shutting down server...\n");
+    if (worker_pids) {
+        stop_workers();
+    }
+    progress_buffer_shutdown();
     cleanup_session_store();
+    catalog_cleanup();
     close_database();
+    file_cache_cleanup();
+    compressed_cache_cleanup();
     printf("✓ Server stopped\n");
     exit(0);
 }
 
 // Signal handler for server cleanup on abnormal termination
 void cleanup_handler(void) {
+    // Workers share the master's session store: never tear it down from one
+    if (getpid() != master_pid) {
+        return;
+    }
     cleanup_session_store();
     close_database();
 }
 
-int main() {
-    int server_fd, client_fd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    char buffer[BUFFER_SIZE];
-
-    printf("=== OTT Streaming Server - Enhancement Phase 3 ===\n");
-    printf("    (Video Gallery & Watch History Tracking)\n\n");
+// Prefork worker: leave shared state alone, just exit
+static void worker_signal_handler(int sig) {
+    (void)sig;
+    _exit(0);
+}
 
-    // Initialize database
-    printf("Step 0: Initializing database...\n");
-    if (init_database(DB_PATH) != 0) {
-        fprintf(stderr, "Failed to initialize database\n");
-        exit(EXIT_FAILURE);
-    }
-    printf("\n");
+// Prefork worker (signal thread): write buffered progress, then exit
+static void worker_shutdown(int sig) {
+    (void)sig;
+    progress_buffer_shutdown();
+    _exit(0);
+}
 
-    // Scan and register videos automatically
-    printf("Step 1: Scanning video directory...\n");
-    scan_and_register_videos("../videos");
-    printf("\n");
+// ============================================================================
+// Signal Thread
+// ============================================================================
 
-    // Extract video metadata (duration, thumbnails) using FFmpeg
-    printf("Step 2: Extracting video metadata...\n");
-    update_all_video_metadata("../videos");
-    printf("\n");
+static void (*signal_shutdown)(int);
+static sigset_t shutdown_signals;
 
-    // Initialize session store
-    printf("Step 3: Initializing session store...\n");
-    init_session_store();
-    printf("\n");
+static void* signal_thread_main(void* arg) {
+    (void)arg;
+    int sig;
+    if (sigwait(&shutdown_signals, &sig) == 0) {
+        signal_shutdown(sig);
+    }
+    return NULL;
+}
 
-    // Set up signal handler for child process cleanup
-    struct sigaction sa;
-    sa.sa_handler = sigchld_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
-    if (sigaction(SIGCHLD, &sa, NULL) == -1) {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+/**
+ * Handle SIGINT/SIGTERM on a dedicated thread instead of a signal handler
+ *
+ * Shutdown flushes buffered progress through SQLite and takes locks, which
+ * is unsafe from a handler that may interrupt the lock holder. Must run
+ * before any other thread is created so they all inherit the blocked mask.
+ */
+static int start_signal_thread(void (*on_signal)(int)) {
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL);
+
+    signal_shutdown = on_signal;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, signal_thread_main, NULL) != 0) {
+        perror("pthread_create (signal thread)");
+        return -1;
     }
+    pthread_detach(thread);
+    return 0;
+}
 
-    // Set up signal handler for graceful shutdown (Ctrl+C)
-    signal(SIGINT, sigint_handler);
-    signal(SIGTERM, sigint_handler);
-    atexit(cleanup_handler);
+/**
+ * Create, bind and listen on SERVER_PORT
+ *
+ * @param reuse_port Set SO_REUSEPORT (one listener per prefork worker)
+ * @param verbose Print the startup steps
+ * @return Listening socket, or -1 on failure
+ */
+static int create_listen_socket(int reuse_port, int verbose) {
+    struct sockaddr_in server_addr;
 
     // Step 4: Create socket
-    printf("Step 4: Creating socket...\n");
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (verbose) printf("Step 4: Creating socket...\n");
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
         perror("Socket creation failed");
-        exit(EXIT_FAILURE);
+        return -1;
     }
-    printf("✓ Socket created successfully\n\n");
+    if (verbose) printf("✓ Socket created successfully\n\n");
 
     // Allow port reuse (important for development)
     int opt = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("setsockopt failed");
-        exit(EXIT_FAILURE);
+        close(server_fd);
+        return -1;
+    }
+
+    // Prefork: every worker binds the same port, the kernel spreads connections
+    if (reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt (SO_REUSEPORT) failed");
+        close(server_fd);
+        return -1;
     }
 
     // Step 5: Bind to port
-    printf("Step 5: Binding to port %d...\n", PORT);
+    if (verbose) printf("Step 5: Binding to port %d...\n", PORT);
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
@@ -115,112 +186,270 @@ int main() {
     if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         perror("Bind failed");
         close(server_fd);
-        exit(EXIT_FAILURE);
+        return -1;
     }
-    printf("✓ Successfully bound to port %d\n\n", PORT);
+    if (verbose) printf("✓ Successfully bound to port %d\n\n", PORT);
 
     // Step 6: Listen for connections
-    printf("Step 6: Listening for connections...\n");
-    if (listen(server_fd, 10) < 0) {
+    if (verbose) printf("Step 6: Listening for connections...\n");
+    if (listen(server_fd, SERVER_BACKLOG) < 0) {
         perror("Listen failed");
         close(server_fd);
+        return -1;
+    }
+    if (verbose) printf("✓ Server is listening\n\n");
+
+    return server_fd;
+}
+
+/**
+ * Run worker pool + event loops on a listening socket (blocks)
+ */
+static int serve_forever(int server_fd, int num_loops) {
+    // Worker pool runs the (blocking) route handlers
+    WorkerPool* pool = worker_pool_create(WORKER_POOL_THREADS, WORKER_QUEUE_CAPACITY);
+    if (!pool) {
+        fprintf(stderr, "Failed to create worker pool\n");
+        return -1;
+    }
+    printf("✓ Worker pool started (%d threads)\n", WORKER_POOL_THREADS);
+
+    // Main server loop: epoll threads accept and read, workers respond
+    int result = event_loop_run(server_fd, num_loops, pool);
+    if (result != 0) {
+        fprintf(stderr, "Failed to start event loop\n");
+    }
+
+    worker_pool_destroy(pool);
+    return result;
+}
+
+// ============================================================================
+// Prefork Mode
+// ============================================================================
+
+/**
+ * Worker process body: own SQLite handle and listener, one event loop
+ */
+static void worker_process_main(int index) {
+    signal(SIGINT, worker_signal_handler);
+    signal(SIGTERM, worker_signal_handler);
+
+    // Line buffering: keep log lines from several processes intact
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (open_database(DB_PATH) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    int server_fd = create_listen_socket(1, 0);
+    if (server_fd < 0) {
+        _exit(WORKER_EXIT_FATAL);
+    }
+
+    if (start_signal_thread(worker_shutdown) != 0 || progress_buffer_init() != 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    // The session store is shared: one worker sweeps it (a respawn restarts it).
+    // Not the master: it forks, and a child must not inherit a mid-sweep thread.
+    if (index == 0 && session_sweeper_start() != 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    printf("✓ Worker %d started (pid %d)\n", index, getpid());
+
+    // Processes provide the parallelism: one loop thread per worker
+    serve_forever(server_fd, 1);
+    _exit(EXIT_FAILURE);
+}
+
+static pid_t spawn_worker(int index) {
+    fflush(stdout);  // Don't duplicate buffered output in the child
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        worker_process_main(index);
+    } else if (pid < 0) {
+        perror("fork failed");
+    }
+    return pid;
+}
+
+/**
+ * Master process: start workers, respawn them when they die
+ */
+static void run_prefork_master(int count) {
+    worker_pids = calloc(count, sizeof(pid_t));
+    time_t* started_at = calloc(count, sizeof(time_t));
+    if (!worker_pids || !started_at) {
+        fprintf(stderr, "Failed to allocate worker table\n");
         exit(EXIT_FAILURE);
     }
-    printf("✓ Server is listening\n\n");
+    num_workers = count;
 
-    printf("🚀 OTT Streaming Server is running!\n");
-    printf("   Access the player at: http://localhost:%d/\n", PORT);
-    printf("   Press Ctrl+C to stop the server\n\n");
+    // The SQLite handle must not be shared across fork(): workers open their own
+    close_database();
 
-    // Main server loop
-    while (1) {
-        printf("Waiting for connection...\n");
+    for (int i = 0; i < count; i++) {
+        worker_pids[i] = spawn_worker(i);
+        started_at[i] = time(NULL);
+    }
+    printf("✓ Prefork master supervising %d workers (pid %d)\n", count, getpid());
 
-        // Accept client connection
-        client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
-        if (client_fd < 0) {
-            perror("Accept failed");
+    while (!shutting_down) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("waitpid");
+            break;
+        }
+
+        int index = -1;
+        for (int i = 0; i < count; i++) {
+            if (worker_pids[i] == pid) {
+                index = i;
+            }
+        }
+        if (index < 0 || shutting_down) {
             continue;
         }
 
-        char* client_ip = inet_ntoa(client_addr.sin_addr);
-        printf("✓ Client connected: %s (PID: %d)\n", client_ip, getpid());
+        if (WIFEXITED(status) && WEXITSTATUS(status) == WORKER_EXIT_FATAL) {
+            fprintf(stderr, "❌ Worker %d cannot start, shutting down\n", index);
+            worker_pids[index] = 0;
+            sigint_handler(SIGTERM);
+        }
 
-        // Fork a child process to handle this client
-        pid_t pid = fork();
+        printf("⚠️  Worker %d (pid %d) %s %d, respawning\n", index, pid,
+               WIFSIGNALED(status) ? "killed by signal" : "exited with status",
+               WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
 
-        if (pid < 0) {
-            // Fork failed
-            perror("Fork failed");
-            close(client_fd);
-            continue;
+        // Crash loop protection: don't respawn more than once per second
+        if (time(NULL) - started_at[index] < 1) {
+            sleep(1);
         }
 
-        if (pid == 0) {
-            // Child process: handle the client request
-            close(server_fd);  // Child doesn't need the listening socket
+        worker_pids[index] = spawn_worker(index);
+        started_at[index] = time(NULL);
+    }
 
-            // Read HTTP request
-            ssize_t bytes_read = read(client_fd, buffer, BUFFER_SIZE - 1);
-            if (bytes_read <= 0) {
-                close(client_fd);
-                exit(0);  // Exit child process
-            }
+    free(started_at);
+}
 
-            buffer[bytes_read] = '\0';
+int main(int argc, char* argv[]) {
+    int workers = PREFORK_WORKERS;
+    int max_sessions = MAX_SESSIONS;
+    int session_tokens = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+            max_sessions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--session-tokens") == 0) {
+            session_tokens = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--workers N] [--max-sessions N] [--session-tokens]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-            // Parse HTTP request
-            HTTPRequest req = parse_http_request(buffer);
-            printf("  [Child %d] %s %s\n", getpid(), req.method, req.path);
+    if (workers < 0 || workers > PREFORK_MAX_WORKERS) {
+        fprintf(stderr, "--workers must be between 0 and %d\n", PREFORK_MAX_WORKERS);
+        exit(EXIT_FAILURE);
+    }
 
-            // Security: Validate path to prevent directory traversal attacks
-            if (!is_path_safe(req.path)) {
-                send_403(client_fd, "Directory traversal attempt detected");
-                close(client_fd);
-                printf("  [Child %d] Connection closed (security violation)\n\n", getpid());
-                exit(0);
-            }
+    if (max_sessions < 1 || max_sessions > SESSION_CAPACITY_LIMIT) {
+        fprintf(stderr, "--max-sessions must be between 1 and %d\n", SESSION_CAPACITY_LIMIT);
+        exit(EXIT_FAILURE);
+    }
 
-            // Parse session from Cookie header
-            char cookie_header[MAX_COOKIE_LEN];
-            char session_id[SESSION_ID_LENGTH];
+    master_pid = getpid();
 
-            if (!find_header(buffer, "Cookie", cookie_header, sizeof(cookie_header))) {
-                cookie_header[0] = '\0';
-            }
+    printf("=== OTT Streaming Server - Enhancement Phase 3 ===\n");
+    printf("    (Video Gallery & Watch History Tracking)\n\n");
 
-            if (!parse_cookie(cookie_header, session_id, sizeof(session_id))) {
-                session_id[0] = '\0';
-            }
+    // Initialize database
+    printf("Step 0: Initializing database...\n");
+    if (init_database(DB_PATH) != 0) {
+        fprintf(stderr, "Failed to initialize database\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("\n");
 
-            // Validate and refresh session (if present)
-            if (session_id[0] != '\0' && validate_session(session_id)) {
-                refresh_session(session_id);
-                printf("  [Child %d] Valid session: %s\n", getpid(), session_id);
-            } else {
-                session_id[0] = '\0';  // Clear invalid session
-            }
+    // Scan and register videos automatically
+    printf("Step 1: Scanning video directory...\n");
+    scan_and_register_videos("../videos");
+    printf("\n");
 
-            // Dispatch request to appropriate route handler
-            if (dispatch_route(client_fd, &req, session_id, buffer)) {
-                // Route was handled successfully
-                printf("  [Child %d] Route handled successfully\n", getpid());
-            } else {
-                // No matching route found - send 404
-                printf("  [Child %d] No matching route for %s %s\n", getpid(), req.method, req.path);
-                send_404(client_fd);
-            }
+    // Extract video metadata (duration, thumbnails) using FFmpeg
+    printf("Step 2: Extracting video metadata...\n");
+    update_all_video_metadata("../videos");
 
-            // Close connection and exit child process
-            close(client_fd);
-            printf("  [Child %d] Connection closed\n\n", getpid());
-            exit(0);  // Child process exits here
-        }
+    // Catalog reads are served from memory (prefork workers inherit it)
+    if (catalog_refresh() != 0) {
+        fprintf(stderr, "Failed to load video catalog\n");
+        exit(EXIT_FAILURE);
+    }
 
-        // Parent process: close client socket and continue accepting
-        close(client_fd);  // Parent doesn't need the client socket
+    // .br/.gz siblings of HTML/CSS/JS (missing or outdated ones only)
+    compress_static_assets(CLIENT_DIR);
+    printf("\n");
+
+    // Initialize session store
+    printf("Step 3: Initializing session store...\n");
+    if (!session_tokens) {
+        init_session_store(max_sessions, SESSION_STORE_PATH);
+    } else if (session_token_init(SESSION_KEY_PATH, SESSION_REVOKE_PATH) != 0) {
+        fprintf(stderr, "Failed to enable session tokens\n");
+        exit(EXIT_FAILURE);
     }
 
+    // Watch progress write-behind buffer (shared with prefork workers)
+    if (progress_buffer_create() != 0) {
+        fprintf(stderr, "Failed to create progress buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("\n");
+
+    // A client disconnecting mid-response must not kill the whole server
+    signal(SIGPIPE, SIG_IGN);
+
+    // Set up signal handler for graceful shutdown (Ctrl+C)
+    signal(SIGINT, sigint_handler);
+    signal(SIGTERM, sigint_handler);
+    atexit(cleanup_handler);
+
+    if (workers > 0) {
+        printf("Step 4: Starting %d prefork workers (SO_REUSEPORT)...\n", workers);
+        printf("🚀 OTT Streaming Server is running!\n");
+        printf("   Access the player at: http://localhost:%d/\n", PORT);
+        printf("   Press Ctrl+C to stop the server\n\n");
+
+        run_prefork_master(workers);
+        return 0;
+    }
+
+    int server_fd = create_listen_socket(0, 1);
+    if (server_fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (start_signal_thread(sigint_handler) != 0 || progress_buffer_init() != 0 ||
+        session_sweeper_start() != 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    printf("🚀 OTT Streaming Server is running!\n");
+    printf("   Access the player at: http://localhost:%d/\n", PORT);
+    printf("   Press Ctrl+C to stop the server\n\n");
+
+    serve_forever(server_fd, EVENT_LOOP_THREADS);
+
     close(server_fd);
     return 0;
 }
@@ -0,0 +1,428 @@
+/*
+ * OTT Streaming Server - Watch Progress Write-Behind Buffer
+ *
+ * Two tables: new updates go to `active`; a flush swaps it out and writes
+ * it as `flushing`, which stays visible to readers until the transaction
+ * has committed. table_lock guards the tables and is held only for
+ * in-memory work, never during SQLite I/O. A flush claims the batch by
+ * recording its pid; other flushers find the batch taken and back off.
+ *
+ * Tables and lock live in one shared mapping made before the prefork
+ * workers are forked. Every worker runs a flusher; whichever wakes first
+ * writes the batch for all of them. A worker can die at any point:
+ *   - table_lock is a robust mutex: the next locker gets EOWNERDEAD and
+ *     rebuilds the tables' hash slots before marking it consistent
+ *   - a batch whose flusher is gone is put back into `active` (rewriting
+ *     rows that did commit is harmless: same values, same times)
+ */
+
+#include "../include/progress_buffer.h"
+#include "../include/database.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+typedef struct {
+    WatchProgress entries[PROGRESS_BUFFER_CAPACITY];
+    int slots[PROGRESS_BUFFER_SLOTS];       // Open addressing: entry index + 1, 0 = empty
+    int count;
+} ProgressTable;
+
+typedef struct {
+    pthread_mutex_t table_lock;             // Everything below (process-shared, robust)
+    int active;                             // Table taking new updates
+    int flushing;                           // Table being written (-1 = none)
+    pid_t flush_owner;                      // Process writing `flushing`
+    ProgressTable tables[2];
+} ProgressShared;
+
+#define FLUSH_BUSY 1                        // progress_buffer_flush(): another flush owns the batch
+#define FLUSH_WAIT_NS 2000000               // Poll interval while waiting for that flush (2 ms)
+
+static ProgressShared* shared = NULL;
+
+// Background flusher
+static pthread_t flusher_thread;
+static int flusher_running = 0;
+static int flusher_stop = 0;
+static pthread_mutex_t flusher_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flusher_cond = PTHREAD_COND_INITIALIZER;
+
+// ============================================================================
+// Table Helpers (table_lock held)
+// ============================================================================
+
+static unsigned int slot_for(int user_id, int video_id) {
+    unsigned int hash = (unsigned int)user_id * 2654435761u ^ (unsigned int)video_id * 40503u;
+    return hash & (PROGRESS_BUFFER_SLOTS - 1);
+}
+
+static WatchProgress* table_find(ProgressTable* table, int user_id, int video_id) {
+    unsigned int slot = slot_for(user_id, video_id);
+
+    while (table->slots[slot] != 0) {
+        WatchProgress* entry = &table->entries[table->slots[slot] - 1];
+        if (entry->user_id == user_id && entry->video_id == video_id) {
+            return entry;
+        }
+        slot = (slot + 1) & (PROGRESS_BUFFER_SLOTS - 1);
+    }
+    return NULL;
+}
+
+/**
+ * Insert or update an entry
+ * Returns: 0 on success, -1 if the table is full
+ */
+static int table_put(ProgressTable* table, const WatchProgress* update) {
+    WatchProgress* entry = table_find(table, update->user_id, update->video_id);
+    if (entry) {
+        *entry = *update;
+        return 0;
+    }
+
+    if (table->count == PROGRESS_BUFFER_CAPACITY) {
+        return -1;
+    }
+
+    unsigned int slot = slot_for(update->user_id, update->video_id);
+    while (table->slots[slot] != 0) {
+        slot = (slot + 1) & (PROGRESS_BUFFER_SLOTS - 1);
+    }
+
+    table->entries[table->count] = *update;
+    table->slots[slot] = ++table->count;
+    return 0;
+}
+
+static void table_clear(ProgressTable* table) {
+    memset(table->slots, 0, sizeof(table->slots));
+    table->count = 0;
+}
+
+static ProgressTable* active_table(void) {
+    return &shared->tables[shared->active];
+}
+
+static ProgressTable* flushing_table(void) {
+    return shared->flushing >= 0 ? &shared->tables[shared->flushing] : NULL;
+}
+
+/**
+ * Rebuild both tables' hash slots from their entries
+ * A holder that died inside table_put() may have left an entry without a
+ * slot (the update is lost) or a slot past count; a swap may be half done.
+ */
+static void repair_tables(void) {
+    if (shared->active == shared->flushing) {
+        shared->active = 1 - shared->flushing;
+        table_clear(active_table());
+    }
+
+    for (int t = 0; t < 2; t++) {
+        ProgressTable* table = &shared->tables[t];
+        int count = table->count;
+        if (count < 0 || count > PROGRESS_BUFFER_CAPACITY) {
+            count = 0;
+        }
+
+        table_clear(table);
+        for (int i = 0; i < count; i++) {
+            WatchProgress entry = table->entries[i];
+            table_put(table, &entry);
+        }
+    }
+}
+
+static void lock_tables(void) {
+    if (pthread_mutex_lock(&shared->table_lock) == EOWNERDEAD) {
+        fprintf(stderr, "⚠️  Progress buffer holder died, repairing tables\n");
+        repair_tables();
+        pthread_mutex_consistent(&shared->table_lock);
+    }
+}
+
+static void unlock_tables(void) {
+    pthread_mutex_unlock(&shared->table_lock);
+}
+
+/**
+ * Put back every batch entry not superseded by a newer update
+ * Returns: number of entries requeued
+ */
+static int requeue_batch(ProgressTable* batch) {
+    int requeued = 0;
+    for (int i = 0; i < batch->count; i++) {
+        WatchProgress* entry = &batch->entries[i];
+        if (!table_find(active_table(), entry->user_id, entry->video_id) &&
+            table_put(active_table(), entry) == 0) {
+            requeued++;
+        }
+    }
+    return requeued;
+}
+
+/**
+ * Whether the process writing the batch is gone
+ */
+static int flush_owner_dead(void) {
+    return kill(shared->flush_owner, 0) != 0 && errno == ESRCH;
+}
+
+// ============================================================================
+// Flushing
+// ============================================================================
+
+/**
+ * Write the active table as one batch
+ * Returns: 0 on success (or nothing pending), -1 if the batch could not be
+ *          written (it is requeued), FLUSH_BUSY if another flush is running
+ */
+static int flush_once(void) {
+    lock_tables();
+    if (shared->flushing >= 0) {
+        if (!flush_owner_dead()) {
+            unlock_tables();
+            return FLUSH_BUSY;
+        }
+
+        ProgressTable* lost = flushing_table();
+        int requeued = requeue_batch(lost);
+        fprintf(stderr, "⚠️  Progress flusher (pid %d) died, %d of %d updates requeued\n",
+                (int)shared->flush_owner, requeued, lost->count);
+        shared->flushing = -1;
+    }
+
+    if (active_table()->count == 0) {
+        unlock_tables();
+        return 0;
+    }
+
+    // Swap tables: new updates go to the other one while this batch is written
+    ProgressTable* batch = active_table();
+    shared->flush_owner = getpid();
+    shared->flushing = shared->active;
+    shared->active = 1 - shared->active;
+    table_clear(active_table());
+    unlock_tables();
+
+    int result = update_watch_positions(batch->entries, batch->count);
+
+    lock_tables();
+    if (result != 0) {
+        // Keep the updates: put back every entry not superseded meanwhile
+        int requeued = requeue_batch(batch);
+        fprintf(stderr, "⚠️  Progress flush failed, %d of %d updates requeued\n", requeued, batch->count);
+    }
+    shared->flushing = -1;
+    unlock_tables();
+
+    return result;
+}
+
+int progress_buffer_flush(void) {
+    int result;
+    while ((result = flush_once()) == FLUSH_BUSY) {
+        struct timespec pause = {0, FLUSH_WAIT_NS};
+        nanosleep(&pause, NULL);
+    }
+    return result;
+}
+
+static void* flusher_main(void* arg) {
+    (void)arg;
+
+    // Shutdown signals are handled elsewhere; this thread only flushes
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    pthread_mutex_lock(&flusher_lock);
+    while (!flusher_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += PROGRESS_FLUSH_INTERVAL;
+
+        pthread_cond_timedwait(&flusher_cond, &flusher_lock, &deadline);
+        if (flusher_stop) {
+            break;
+        }
+
+        // Another worker's flush already covers this period: don't wait for it
+        pthread_mutex_unlock(&flusher_lock);
+        flush_once();
+        pthread_mutex_lock(&flusher_lock);
+    }
+    pthread_mutex_unlock(&flusher_lock);
+
+    return NULL;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int progress_buffer_create(void) {
+    if (shared) {
+        return 0;
+    }
+
+    void* mapping = mmap(NULL, sizeof(ProgressShared), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap (progress buffer) failed");
+        return -1;
+    }
+
+    // Anonymous pages start zeroed: both tables are empty
+    shared = mapping;
+    shared->active = 0;
+    shared->flushing = -1;
+
+    // Robust: a worker killed while holding it must not wedge the others
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(&shared->table_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_mutex_init (progress buffer) failed: %s\n", strerror(rc));
+        munmap(shared, sizeof(ProgressShared));
+        shared = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int progress_buffer_init(void) {
+    if (flusher_running) {
+        return 0;
+    }
+    if (progress_buffer_create() != 0) {
+        return -1;
+    }
+
+    flusher_stop = 0;
+    if (pthread_create(&flusher_thread, NULL, flusher_main, NULL) != 0) {
+        perror("pthread_create (progress flusher)");
+        return -1;
+    }
+    flusher_running = 1;
+
+    printf("✓ Progress buffer started (flush every %ds or %d entries)\n",
+           PROGRESS_FLUSH_INTERVAL, PROGRESS_BUFFER_CAPACITY);
+    return 0;
+}
+
+int progress_buffer_update(int user_id, int video_id, int position) {
+    WatchProgress update = {user_id, video_id, position, time(NULL)};
+
+    lock_tables();
+    int result = table_put(active_table(), &update);
+    int full = active_table()->count == PROGRESS_BUFFER_CAPACITY;
+    unlock_tables();
+
+    if (result != 0 || full) {
+        // Size trigger: this request pays for the batch
+        if (progress_buffer_flush() != 0 && result != 0) {
+            return -1;
+        }
+        if (result != 0) {
+            lock_tables();
+            result = table_put(active_table(), &update);
+            unlock_tables();
+        }
+    }
+
+    return result;
+}
+
+int progress_buffer_lookup(int user_id, int video_id, int* position) {
+    if (!shared) {
+        return 0;
+    }
+
+    lock_tables();
+    WatchProgress* entry = table_find(active_table(), user_id, video_id);
+    if (!entry && flushing_table()) {
+        entry = table_find(flushing_table(), user_id, video_id);
+    }
+    if (entry) {
+        *position = entry->position;
+    }
+    unlock_tables();
+
+    return entry != NULL;
+}
+
+int progress_buffer_user_entries(int user_id, WatchProgress** entries) {
+    *entries = NULL;
+    if (!shared) {
+        return 0;
+    }
+
+    lock_tables();
+    ProgressTable* active = active_table();
+    ProgressTable* batch = flushing_table();
+
+    int total = 0;
+    for (int i = 0; i < active->count; i++) {
+        total += active->entries[i].user_id == user_id;
+    }
+    for (int i = 0; batch && i < batch->count; i++) {
+        total += batch->entries[i].user_id == user_id;
+    }
+
+    int count = 0;
+    if (total > 0 && !(*entries = malloc(total * sizeof(WatchProgress)))) {
+        count = -1;
+    } else if (total > 0) {
+        for (int i = 0; i < active->count; i++) {
+            if (active->entries[i].user_id == user_id) {
+                (*entries)[count++] = active->entries[i];
+            }
+        }
+        // The batch being written, unless superseded by a newer update
+        for (int i = 0; batch && i < batch->count; i++) {
+            const WatchProgress* entry = &batch->entries[i];
+            if (entry->user_id == user_id && !table_find(active, user_id, entry->video_id)) {
+                (*entries)[count++] = *entry;
+            }
+        }
+    }
+    unlock_tables();
+
+    return count;
+}
+
+void progress_buffer_shutdown(void) {
+    if (flusher_running) {
+        pthread_mutex_lock(&flusher_lock);
+        flusher_stop = 1;
+        pthread_cond_signal(&flusher_cond);
+        pthread_mutex_unlock(&flusher_lock);
+
+        pthread_join(flusher_thread, NULL);
+        flusher_running = 0;
+    }
+
+    if (!shared) {
+        return;
+    }
+
+    lock_tables();
+    int pending = active_table()->count;
+    unlock_tables();
+
+    if (pending > 0 && progress_buffer_flush() == 0) {
+        printf("✓ Flushed %d buffered progress update%s\n", pending, pending == 1 ? "" : "s");
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ * OTT Streaming Server - Buffered Secure Random Bytes
+ *
+ * One pool per thread, so drawing bytes takes no lock. Bytes are handed
+ * out from the front and wiped; the unread rest is all the pool holds.
+ *
+ * fork() copies the calling thread's pool into the child. A child
+ * handler registered with pthread_atfork() bumps a generation counter,
+ * and a pool from an older generation is wiped before use.
+ */
+
+#include "../include/random_pool.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+typedef struct {
+    unsigned char bytes[RANDOM_POOL_BYTES];
+    size_t used;                // Bytes handed out (and wiped) from the front
+    unsigned int generation;    // fork_generation the bytes belong to
+} RandomPool;
+
+static __thread RandomPool pool = { .used = RANDOM_POOL_BYTES };
+
+// Starts at 1: a thread's pool (generation 0) is refilled on first use
+static unsigned int fork_generation = 1;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void after_fork_child(void) {
+    fork_generation++;
+}
+
+static void register_atfork(void) {
+    pthread_atfork(NULL, NULL, after_fork_child);
+}
+
+/**
+ * Read from /dev/urandom (kernels without getrandom())
+ * Returns: 0 on success, -1 on failure
+ */
+static int read_urandom(unsigned char* out, size_t length) {
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = read(fd, out + done, length - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+    return done == length ? 0 : -1;
+}
+
+/**
+ * Fill out from the kernel
+ * Requests over 256 bytes may be cut short by a signal: keep reading.
+ * Returns: 0 on success, -1 on failure
+ */
+static int fill_from_kernel(unsigned char* out, size_t length) {
+    size_t done = 0;
+
+    while (done < length) {
+        ssize_t n = getrandom(out + done, length - done, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOSYS) {
+                return read_urandom(out + done, length - done);
+            }
+            perror("getrandom failed");
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+int random_bytes(void* out, size_t length) {
+    if (length > RANDOM_POOL_BYTES / 4) {
+        return fill_from_kernel(out, length);
+    }
+
+    pthread_once(&atfork_once, register_atfork);
+
+    // Inherited through fork(): the parent hands out the same bytes
+    if (pool.generation != fork_generation) {
+        explicit_bzero(pool.bytes, sizeof(pool.bytes));
+        pool.used = RANDOM_POOL_BYTES;
+        pool.generation = fork_generation;
+    }
+
+    if (RANDOM_POOL_BYTES - pool.used < length) {
+        if (fill_from_kernel(pool.bytes, RANDOM_POOL_BYTES) != 0) {
+            return -1;
+        }
+        pool.used = 0;
+    }
+
+    memcpy(out, pool.bytes + pool.used, length);
+    explicit_bzero(pool.bytes + pool.used, length);
+    pool.used += length;
+    return 0;
+}
@@ -10,6 +10,8 @@
 
 #include "../include/routes.h"
 #include "../include/database.h"
+#include "../include/catalog.h"
+#include "../include/progress_buffer.h"
 #include "../include/json.h"
 #include <string.h>
 #include <stdlib.h>
@@ -35,35 +37,40 @@ static const char* extract_body(const char* buffer) {
 }
 
 /**
- * Parse query parameter from URL
+ * 304 if the client's copy carries etag, or the cached compressed body
+ * stored under etag and resource
+ * Returns: 1 if a response was sent, 0 otherwise
  */
-static int parse_query_param(const char* path, const char* param_name, char* output, size_t max_len) {
-    const char* query_start = strchr(path, '?');
-    if (!query_start) {
-        return 0;
+static int send_tagged_cached(int client_fd, const HTTPRequest* req, const char* resource,
+                              const char* etag) {
+    if (http_not_modified(&req->conditional, etag, 0)) {
+        // Echo the tag as the 200 sent it: weak on a compressed body
+        char weak_etag[MAX_ETAG_LEN + 2];
+        snprintf(weak_etag, sizeof(weak_etag), "W/%s", etag);
+        const char* tag = strstr(req->conditional.if_none_match, weak_etag) ? weak_etag : etag;
+        send_304(client_fd, tag, 0, 1);
+        return 1;
     }
+    return send_cached_json(client_fd, etag, resource);
+}
 
-    query_start++; // Skip '?'
-
-    char search[64];
-    snprintf(search, sizeof(search), "%s=", param_name);
-
-    const char* param = strstr(query_start, search);
-    if (!param) {
+/**
+ * Answer a request for a response built only from the catalog without
+ * building it: 304 if the client's copy carries this snapshot's tag,
+ * or the cached compressed body of this snapshot. Neither runs any SQL
+ * (unless the catalog itself is stale).
+ *
+ * @param resource Cache key of the response (path and query)
+ * @param etag Set to the catalog entity tag ("" if none is available)
+ * Returns: 1 if a response was sent, 0 otherwise
+ */
+static int send_catalog_cached(int client_fd, const HTTPRequest* req, const char* resource,
+                               char* etag, size_t size) {
+    if (catalog_etag(etag, size) != 0) {
+        etag[0] = '\0';
         return 0;
     }
-
-    param += strlen(search);
-
-    // Extract value until '&' or end
-    size_t i = 0;
-    while (param[i] && param[i] != '&' && i < max_len - 1) {
-        output[i] = param[i];
-        i++;
-    }
-    output[i] = '\0';
-
-    return (i > 0) ? 1 : 0;
+    return send_tagged_cached(client_fd, req, resource, etag);
 }
 
 // ============================================================================
@@ -86,6 +93,7 @@ static Route routes[] = {
     {"POST", "/api/logout", handle_post_logout, 1, 0},
     {"GET", "/api/recommendations", handle_get_recommendations, 1, 0},
     {"GET", "/api/search", handle_get_search, 1, 0},
+    {"GET", "/api/search/suggest", handle_get_search_suggest, 1, 0},
     {"GET", "/api/genres", handle_get_genres, 1, 0},
     {"GET", "/api/genres/", handle_get_genre_videos, 1, 1},  // prefix match
     {"GET", "/api/watchlist", handle_get_watchlist, 1, 0},
@@ -150,8 +158,8 @@ void handle_get_login(int client_fd, HTTPRequest* req, const char* session_id, c
     (void)session_id;  // unused
     (void)buffer;  // unused
 
-    req->range = (Range){0, 0, 0};
-    stream_file(client_fd, "../client/login.html", req->range);
+    req->range = (Range){0};
+    stream_file(client_fd, "../client/login.html", req);
 }
 
 void handle_post_login(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
@@ -179,19 +187,19 @@ void handle_post_register(int client_fd, HTTPRequest* req, const char* session_i
 }
 
 void handle_get_root(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
+    (void)session_id;  // validated and refreshed by the event loop
     (void)buffer;  // unused
 
-    if (session_id && strlen(session_id) > 0 && validate_session(session_id)) {
+    if (req->user_id >= 0) {
         // Valid session - serve gallery
-        refresh_session(session_id);
         printf("  [Route] Valid session, serving gallery\n");
-        req->range = (Range){0, 0, 0};
-        stream_file(client_fd, "../client/gallery.html", req->range);
+        req->range = (Range){0};
+        stream_file(client_fd, "../client/gallery.html", req);
     } else {
         // No valid session - serve login page
         printf("  [Route] No valid session, serving login\n");
-        req->range = (Range){0, 0, 0};
-        stream_file(client_fd, "../client/login.html", req->range);
+        req->range = (Range){0};
+        stream_file(client_fd, "../client/login.html", req);
     }
 }
 
@@ -200,30 +208,37 @@ void handle_get_root(int client_fd, HTTPRequest* req, const char* session_id, co
 // ============================================================================
 
 void handle_get_api_videos(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
+    (void)session_id;  // resolved into req->user_id
     (void)buffer;  // unused
 
-    char json_output[8192];
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized: Invalid session");
-    } else if (get_videos_with_history(user_id, json_output, sizeof(json_output)) == 0) {
-        send_json_response(client_fd, json_output);
+        return;
+    }
+
+    // Sent in JSON_STREAM_BUFFER-sized chunks: constant memory for any catalog size
+    char json_output[JSON_STREAM_BUFFER];
+    JSONBuilder builder;
+    json_builder_init_stream(&builder, client_fd, json_output, sizeof(json_output));
+
+    if (get_videos_with_history(user_id, &builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
     } else {
-        send_json_error(client_fd, 500, "Internal server error");
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
     }
+
+    json_builder_free(&builder);
 }
 
 void handle_get_api_user(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
+    (void)session_id;  // resolved into req->username
     (void)buffer;  // unused
 
-    char username[USER_ID_LENGTH];
-
-    if (get_username_from_session(session_id, username, sizeof(username)) == 0) {
+    if (req->user_id >= 0) {
         char json_output[256];
-        snprintf(json_output, sizeof(json_output), "{\"username\":\"%s\"}", username);
+        snprintf(json_output, sizeof(json_output), "{\"username\":\"%s\"}", req->username);
         send_json_response(client_fd, json_output);
     } else {
         send_json_error(client_fd, 401, "Unauthorized: Invalid session");
@@ -231,9 +246,9 @@ void handle_get_api_user(int client_fd, HTTPRequest* req, const char* session_id
 }
 
 void handle_post_watch_progress(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
+    (void)session_id;  // resolved into req->user_id
 
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized: Invalid session");
@@ -246,12 +261,19 @@ void handle_post_watch_progress(int client_fd, HTTPRequest* req, const char* ses
         return;
     }
 
-    // Parse JSON body
-    int video_id = parse_json_int(body, "video_id");
-    int position = parse_json_int(body, "position");
+    // Parse JSON body once, then look fields up in the index
+    JSONIndex json;
+    if (json_index_parse(&json, body, strlen(body)) != 0) {
+        send_json_error(client_fd, 400, "Invalid JSON body");
+        return;
+    }
+
+    int video_id = json_index_int(&json, "video_id", -1);
+    int position = json_index_int(&json, "position", -1);
 
     if (video_id > 0 && position >= 0) {
-        if (update_watch_position(user_id, video_id, position) == 0) {
+        // Buffered: written to SQLite in batches by the progress flusher
+        if (progress_buffer_update(user_id, video_id, position) == 0) {
             send_json_response(client_fd, "{\"status\":\"success\"}");
             printf("  [API] Watch position updated: user=%d, video=%d, pos=%d\n",
                    user_id, video_id, position);
@@ -264,9 +286,10 @@ void handle_post_watch_progress(int client_fd, HTTPRequest* req, const char* ses
 }
 
 void handle_get_watch_history(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
+    (void)session_id;  // resolved into req->user_id
     (void)buffer;  // unused
 
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized: Invalid session");
@@ -296,100 +319,200 @@ void handle_post_logout(int client_fd, HTTPRequest* req, const char* session_id,
     printf("  [API] User logged out: session=%s\n", session_id);
 
     // Send response with Set-Cookie to clear the session cookie
-    const char* response = "HTTP/1.1 200 OK\r\n"
-                          "Content-Type: application/json\r\n"
-                          "Set-Cookie: session_id=; HttpOnly; Max-Age=0; Path=/\r\n"
-                          "Content-Length: 21\r\n"
-                          "\r\n"
-                          "{\"status\":\"success\"}";
+    char response[256];
+    snprintf(response, sizeof(response),
+             "HTTP/1.1 200 OK\r\n"
+             "Content-Type: application/json\r\n"
+             "Set-Cookie: session_id=; HttpOnly; Max-Age=0; Path=/\r\n"
+             "Content-Length: 20\r\n"
+             "%s"
+             "\r\n"
+             "{\"status\":\"success\"}",
+             http_connection_header());
     send(client_fd, response, strlen(response), 0);
 }
 
 void handle_get_recommendations(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
+    (void)session_id;  // resolved into req->user_id
     (void)buffer;  // unused
 
-    char json_output[8192];
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized: Invalid session");
-    } else if (get_recommended_videos(user_id, json_output, sizeof(json_output)) == 0) {
-        send_json_response(client_fd, json_output);
+        return;
+    }
+
+    char json_output[MAX_JSON_BUFFER];
+    JSONBuilder builder;
+    json_builder_init_arena(&builder, json_output, sizeof(json_output));
+
+    if (get_recommended_videos(user_id, &builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
     } else {
-        send_json_error(client_fd, 500, "Internal server error");
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
     }
+
+    json_builder_free(&builder);
 }
 
 void handle_get_search(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
     (void)session_id;  // unused for search
     (void)buffer;  // unused
 
-    char json_output[8192];
     char query[256] = "";
 
-    if (!parse_query_param(req->path, "q", query, sizeof(query)) || strlen(query) == 0) {
+    if (!get_query_param(req, "q", query, sizeof(query)) || strlen(query) == 0) {
         send_json_error(client_fd, 400, "Missing search query parameter");
-    } else if (search_videos(query, json_output, sizeof(json_output)) == 0) {
-        send_json_response(client_fd, json_output);
+        return;
+    }
+
+    char resource[MAX_PATH + sizeof(query) + 4];
+    snprintf(resource, sizeof(resource), "%s?q=%s", req->path, query);
+
+    char etag[MAX_ETAG_LEN];
+    if (send_catalog_cached(client_fd, req, resource, etag, sizeof(etag))) {
+        return;
+    }
+
+    char json_output[JSON_STREAM_BUFFER];
+    JSONBuilder builder;
+    json_builder_init_stream(&builder, client_fd, json_output, sizeof(json_output));
+    builder.etag = etag[0] ? etag : NULL;
+    builder.resource = resource;
+
+    if (search_videos(query, &builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
     } else {
-        send_json_error(client_fd, 500, "Internal server error");
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
     }
+
+    json_builder_free(&builder);
+}
+
+void handle_get_search_suggest(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
+    (void)session_id;  // unused: suggestions are the same for every user
+    (void)buffer;  // unused
+
+    char prefix[256] = "";
+
+    if (!get_query_param(req, "q", prefix, sizeof(prefix)) || strlen(prefix) == 0) {
+        send_json_error(client_fd, 400, "Missing search query parameter");
+        return;
+    }
+
+    char resource[MAX_PATH + sizeof(prefix) + 4];
+    snprintf(resource, sizeof(resource), "%s?q=%s", req->path, prefix);
+
+    // Tagged by the ranking: view counts change without a catalog change
+    char etag[MAX_ETAG_LEN];
+    if (catalog_ranking_etag(etag, sizeof(etag)) != 0) {
+        etag[0] = '\0';
+    } else if (send_tagged_cached(client_fd, req, resource, etag)) {
+        return;
+    }
+
+    // At most SUGGEST_MAX_RESULTS short objects: fits the first chunk
+    char json_output[4096];
+    JSONBuilder builder;
+    json_builder_init_arena(&builder, json_output, sizeof(json_output));
+    builder.etag = etag[0] ? etag : NULL;
+    builder.resource = resource;
+
+    if (get_search_suggestions(prefix, &builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
+    } else {
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
+    }
+
+    json_builder_free(&builder);
 }
 
 void handle_get_genres(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
     (void)session_id;  // unused
     (void)buffer;  // unused
 
+    char etag[MAX_ETAG_LEN];
+    if (send_catalog_cached(client_fd, req, req->path, etag, sizeof(etag))) {
+        return;
+    }
+
     char json_output[4096];
+    JSONBuilder builder;
+    json_builder_init_arena(&builder, json_output, sizeof(json_output));
+    builder.etag = etag[0] ? etag : NULL;
+    builder.resource = req->path;
 
-    if (get_genres_json(json_output, sizeof(json_output)) == 0) {
-        send_json_response(client_fd, json_output);
+    if (get_genres_json(&builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
     } else {
-        send_json_error(client_fd, 500, "Internal server error");
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
     }
+
+    json_builder_free(&builder);
 }
 
 void handle_get_genre_videos(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
     (void)session_id;  // unused
     (void)buffer;  // unused
 
-    char json_output[8192];
-
     // Parse genre_id from path: /api/genres/{id}/videos
     int genre_id = 0;
     sscanf(req->path + 12, "%d", &genre_id);
 
     if (genre_id <= 0) {
         send_json_error(client_fd, 400, "Invalid genre ID");
-    } else if (get_videos_by_genre(genre_id, json_output, sizeof(json_output)) == 0) {
-        send_json_response(client_fd, json_output);
+        return;
+    }
+
+    char etag[MAX_ETAG_LEN];
+    if (send_catalog_cached(client_fd, req, req->path, etag, sizeof(etag))) {
+        return;
+    }
+
+    char json_output[JSON_STREAM_BUFFER];
+    JSONBuilder builder;
+    json_builder_init_stream(&builder, client_fd, json_output, sizeof(json_output));
+    builder.etag = etag[0] ? etag : NULL;
+    builder.resource = req->path;
+
+    if (get_videos_by_genre(genre_id, &builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
     } else {
-        send_json_error(client_fd, 500, "Internal server error");
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
     }
+
+    json_builder_free(&builder);
 }
 
 void handle_get_watchlist(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
+    (void)session_id;  // resolved into req->user_id
     (void)buffer;  // unused
 
-    char json_output[8192];
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized");
-    } else if (get_watchlist(user_id, json_output, sizeof(json_output)) == 0) {
-        send_json_response(client_fd, json_output);
+        return;
+    }
+
+    char json_output[JSON_STREAM_BUFFER];
+    JSONBuilder builder;
+    json_builder_init_stream(&builder, client_fd, json_output, sizeof(json_output));
+
+    if (get_watchlist(user_id, &builder) == 0) {
+        send_json_builder_response(client_fd, &builder);
     } else {
-        send_json_error(client_fd, 500, "Internal server error");
+        send_json_builder_error(client_fd, &builder, 500, "Internal server error");
     }
+
+    json_builder_free(&builder);
 }
 
 void handle_post_watchlist_add(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
-    (void)req;  // unused
+    (void)session_id;  // resolved into req->user_id
 
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized");
@@ -402,7 +525,13 @@ void handle_post_watchlist_add(int client_fd, HTTPRequest* req, const char* sess
         return;
     }
 
-    int video_id = parse_json_int(body, "video_id");
+    JSONIndex json;
+    if (json_index_parse(&json, body, strlen(body)) != 0) {
+        send_json_error(client_fd, 400, "Invalid JSON body");
+        return;
+    }
+
+    int video_id = json_index_int(&json, "video_id", -1);
 
     if (video_id > 0) {
         if (add_to_watchlist(user_id, video_id) == 0) {
@@ -416,9 +545,10 @@ void handle_post_watchlist_add(int client_fd, HTTPRequest* req, const char* sess
 }
 
 void handle_delete_watchlist_remove(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
+    (void)session_id;  // resolved into req->user_id
     (void)buffer;  // unused
 
-    int user_id = get_user_id_from_session(session_id);
+    int user_id = req->user_id;  // From session_lookup() in the event loop
 
     if (user_id < 0) {
         send_json_error(client_fd, 401, "Unauthorized");
@@ -451,26 +581,26 @@ void handle_static_file(int client_fd, HTTPRequest* req, const char* session_id,
     char filepath[MAX_PATH];
     snprintf(filepath, sizeof(filepath), "../client%s", req->path);
 
-    req->range = (Range){0, 0, 0};
-    stream_file(client_fd, filepath, req->range);
+    req->range = (Range){0};
+    stream_file(client_fd, filepath, req);
 }
 
 void handle_video_stream(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
     (void)session_id;  // unused
 
     // Parse Range header for video streaming
-    char range_header[256];
+    char range_header[MAX_RANGE_HEADER_LEN];
     if (find_header(buffer, "Range", range_header, sizeof(range_header))) {
         req->range = parse_range(range_header);
     } else {
-        req->range = (Range){0, 0, 0};
+        req->range = (Range){0};
     }
 
     // Serve video files (stored in project_root/videos/)
     // /videos/test_video.mp4 → ../videos/test_video.mp4
     char filepath[MAX_PATH];
     snprintf(filepath, sizeof(filepath), "../%s", req->path + 1);  // ../ to go to project root
-    stream_file(client_fd, filepath, req->range);
+    stream_file(client_fd, filepath, req);
 }
 
 void handle_thumbnail(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
@@ -482,8 +612,8 @@ void handle_thumbnail(int client_fd, HTTPRequest* req, const char* session_id, c
     char filepath[MAX_PATH];
     snprintf(filepath, sizeof(filepath), "%s", req->path + 1);  // Skip leading '/'
 
-    req->range = (Range){0, 0, 0};
-    stream_file(client_fd, filepath, req->range);
+    req->range = (Range){0};
+    stream_file(client_fd, filepath, req);
 }
 
 void handle_hls_file(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
@@ -495,8 +625,8 @@ void handle_hls_file(int client_fd, HTTPRequest* req, const char* session_id, co
     char filepath[MAX_PATH];
     snprintf(filepath, sizeof(filepath), "%s", req->path + 1);  // Skip leading '/'
 
-    req->range = (Range){0, 0, 0};
-    stream_file(client_fd, filepath, req->range);
+    req->range = (Range){0};
+    stream_file(client_fd, filepath, req);
 }
 
 void handle_get_hls_status(int client_fd, HTTPRequest* req, const char* session_id, const char* buffer) {
@@ -547,6 +677,7 @@ void handle_favicon(int client_fd, HTTPRequest* req, const char* session_id, con
     (void)buffer;  // unused
 
     // Send empty 204 No Content response for favicon
-    const char* response = "HTTP/1.1 204 No Content\r\n\r\n";
+    char response[128];
+    snprintf(response, sizeof(response), "HTTP/1.1 204 No Content\r\n%s\r\n", http_connection_header());
     write(client_fd, response, strlen(response));
 }
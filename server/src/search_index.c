@@ -0,0 +1,680 @@
+/*
+ * OTT Streaming Server - Title Search Index
+ *
+ * Every title contributes its unigrams and bigrams of code points; grams
+ * that contain whitespace are skipped. A gram is one 64-bit key
+ * (first << 21 | second, second = 0 for a unigram). Each segment maps
+ * keys to posting lists of documents (ascending) with an open-addressing
+ * table. A document is a title's position in its segment; segments keep
+ * their titles ASCII-lowercased in one buffer, so checking a candidate
+ * reads a few contiguous bytes instead of a Video record.
+ *
+ * A query is looked up through its bigrams (its unigram if it is a
+ * single character). The shortest posting list is intersected with the
+ * others by binary search. Each candidate is then checked as a substring
+ * match, since the grams may appear in a different order. Scored hits go
+ * through a min-heap of max_hits entries (top-K selection); only the
+ * hits kept are mapped back to catalog indexes.
+ *
+ * Segments never change after they are built and are shared between
+ * snapshots through an atomic refcount.
+ */
+
+#include "../include/search_index.h"
+#include "../include/catalog.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t key;           // 0 = empty slot
+    uint32_t start;         // First posting
+    uint32_t count;
+    int last_doc;           // Build only: last document counted/added
+} GramSlot;
+
+typedef struct {
+    int refcount;           // Indexes sharing this segment
+    int doc_count;
+    int* doc_ids;           // Video id per document, ascending
+    uint64_t* title_hashes; // Detects changed titles on reuse
+    char* titles;           // Lowercased titles, NUL terminated, back to back
+    uint32_t* title_offsets;    // Document d: titles[offsets[d] .. offsets[d + 1] - 1)
+    GramSlot* slots;
+    uint32_t slot_mask;     // Capacity - 1 (power of 2)
+    uint32_t used;
+    int* postings;          // Documents, grouped by gram
+} Segment;
+
+struct SearchIndex {
+    Segment* segments[SEARCH_MAX_SEGMENTS];
+    int segment_count;
+};
+
+// ============================================================================
+// Text Helpers
+// ============================================================================
+
+/**
+ * Decode the next UTF-8 code point (ASCII lowercased)
+ * Invalid sequences decode to U+FFFD, one byte at a time.
+ * Returns: code point, or 0 at the end of the string
+ */
+static uint32_t next_code_point(const unsigned char** text) {
+    const unsigned char* s = *text;
+    uint32_t c = s[0];
+
+    if (c < 0x80) {
+        if (c != 0) {
+            (*text)++;
+        }
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    int length;
+    uint32_t cp;
+    if ((c & 0xE0) == 0xC0) {
+        length = 2;
+        cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        length = 3;
+        cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        length = 4;
+        cp = c & 0x07;
+    } else {
+        (*text)++;
+        return 0xFFFD;
+    }
+
+    for (int i = 1; i < length; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            (*text)++;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+
+    *text += length;
+    return cp;
+}
+
+static int is_space(uint32_t cp) {
+    return cp == ' ' || (cp >= '\t' && cp <= '\r') || cp == 0x3000;  // U+3000: ideographic space
+}
+
+static uint64_t gram_key(uint32_t first, uint32_t second) {
+    return ((uint64_t)first << 21) | second;
+}
+
+/**
+ * Gram keys of a title (unigrams and bigrams, whitespace skipped)
+ * Returns: number of keys written (duplicates included)
+ */
+static int title_grams(const char* title, uint64_t* keys, int max_keys) {
+    const unsigned char* p = (const unsigned char*)title;
+    uint32_t previous = 0;
+    int count = 0;
+    uint32_t cp;
+
+    while ((cp = next_code_point(&p)) != 0 && count + 2 <= max_keys) {
+        if (is_space(cp)) {
+            previous = 0;
+            continue;
+        }
+        keys[count++] = gram_key(cp, 0);
+        if (previous) {
+            keys[count++] = gram_key(previous, cp);
+        }
+        previous = cp;
+    }
+
+    return count;
+}
+
+static uint64_t title_hash(const char* title) {
+    uint64_t hash = 14695981039346656037ULL;  // FNV-1a
+    for (const unsigned char* p = (const unsigned char*)title; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Copy text with ASCII letters lowercased (same length)
+ */
+static void lowercase_copy(char* out, const char* text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    out[length] = '\0';
+}
+
+/**
+ * Rank a matching title: match kind, then shorter title, then earlier match
+ * title and query are both lowercased.
+ * Returns: score, or -1 if the title does not contain the query
+ */
+static int match_score(const char* title, size_t title_len, const char* query, size_t query_len) {
+    const char* match = strstr(title, query);
+    if (!match) {
+        return -1;
+    }
+
+    int position = (int)(match - title);
+    int kind;
+    if (position == 0 && title_len == query_len) {
+        kind = 4;   // Exact title
+    } else if (position == 0) {
+        kind = 3;   // Title prefix
+    } else if (title[position - 1] == ' ' || title[position - 1] == '-' ||
+               title[position - 1] == '(' || title[position - 1] == ':') {
+        kind = 2;   // Word prefix
+    } else {
+        kind = 1;
+    }
+
+    int length_rank = 255 - (title_len < 255 ? (int)title_len : 255);
+    int position_rank = 255 - (position < 255 ? position : 255);
+    return (kind << 16) | (length_rank << 8) | position_rank;
+}
+
+// ============================================================================
+// Segments
+// ============================================================================
+
+static GramSlot* find_slot(GramSlot* slots, uint32_t mask, uint64_t key) {
+    uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+    while (slots[slot].key != 0 && slots[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return &slots[slot];
+}
+
+/**
+ * Double the table (load factor kept under 1/2)
+ * Returns: 0 on success, -1 on allocation failure
+ */
+static int grow_slots(Segment* segment) {
+    uint32_t capacity = (segment->slot_mask + 1) * 2;
+    GramSlot* slots = calloc(capacity, sizeof(GramSlot));
+    if (!slots) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i <= segment->slot_mask; i++) {
+        if (segment->slots[i].key != 0) {
+            *find_slot(slots, capacity - 1, segment->slots[i].key) = segment->slots[i];
+        }
+    }
+
+    free(segment->slots);
+    segment->slots = slots;
+    segment->slot_mask = capacity - 1;
+    return 0;
+}
+
+static void segment_free(Segment* segment) {
+    if (!segment) {
+        return;
+    }
+    free(segment->doc_ids);
+    free(segment->title_hashes);
+    free(segment->titles);
+    free(segment->title_offsets);
+    free(segment->slots);
+    free(segment->postings);
+    free(segment);
+}
+
+static void segment_release(Segment* segment) {
+    if (segment && __sync_sub_and_fetch(&segment->refcount, 1) == 0) {
+        segment_free(segment);
+    }
+}
+
+/**
+ * Index the titles of catalog->videos[indexes[0 .. count)]
+ * indexes must be ascending, so every posting list is ordered by id.
+ */
+static Segment* segment_build(const Catalog* catalog, const int* indexes, int count) {
+    Segment* segment = calloc(1, sizeof(Segment));
+    if (!segment) {
+        return NULL;
+    }
+
+    segment->refcount = 1;
+    segment->doc_count = count;
+    segment->doc_ids = malloc((count + 1) * sizeof(int));
+    segment->title_hashes = malloc((count + 1) * sizeof(uint64_t));
+    segment->title_offsets = malloc((count + 1) * sizeof(uint32_t));
+    segment->slot_mask = 1023;
+    segment->slots = calloc(segment->slot_mask + 1, sizeof(GramSlot));
+    if (!segment->doc_ids || !segment->title_hashes || !segment->title_offsets || !segment->slots) {
+        segment_free(segment);
+        return NULL;
+    }
+
+    uint32_t text_size = 0;
+    for (int d = 0; d < count; d++) {
+        segment->title_offsets[d] = text_size;
+        text_size += strlen(catalog->videos[indexes[d]].title) + 1;
+    }
+    segment->title_offsets[count] = text_size;
+
+    segment->titles = malloc(text_size + 1);
+    if (!segment->titles) {
+        segment_free(segment);
+        return NULL;
+    }
+
+    uint64_t keys[512];  // Title (255 bytes): at most 2 grams per byte
+
+    // Pass 1: posting list length per gram (a gram counts once per title)
+    for (int d = 0; d < count; d++) {
+        const Video* video = &catalog->videos[indexes[d]];
+        uint32_t offset = segment->title_offsets[d];
+        segment->doc_ids[d] = video->video_id;
+        segment->title_hashes[d] = title_hash(video->title);
+        lowercase_copy(segment->titles + offset, video->title,
+                       segment->title_offsets[d + 1] - offset - 1);
+
+        int key_count = title_grams(segment->titles + offset, keys, 512);
+        for (int k = 0; k < key_count; k++) {
+            GramSlot* slot = find_slot(segment->slots, segment->slot_mask, keys[k]);
+            if (slot->key == 0) {
+                if ((segment->used + 1) * 2 > segment->slot_mask + 1) {
+                    if (grow_slots(segment) != 0) {
+                        segment_free(segment);
+                        return NULL;
+                    }
+                    slot = find_slot(segment->slots, segment->slot_mask, keys[k]);
+                }
+                slot->key = keys[k];
+                slot->last_doc = -1;
+                segment->used++;
+            }
+            if (slot->last_doc != d) {
+                slot->last_doc = d;
+                slot->count++;
+            }
+        }
+    }
+
+    // Lay out the posting lists back to back
+    uint32_t total = 0;
+    for (uint32_t i = 0; i <= segment->slot_mask; i++) {
+        GramSlot* slot = &segment->slots[i];
+        if (slot->key != 0) {
+            slot->start = total;
+            total += slot->count;
+            slot->count = 0;        // Refilled below
+            slot->last_doc = -1;
+        }
+    }
+
+    segment->postings = malloc((total + 1) * sizeof(int));
+    if (!segment->postings) {
+        segment_free(segment);
+        return NULL;
+    }
+
+    // Pass 2: fill in document order
+    for (int d = 0; d < count; d++) {
+        int key_count = title_grams(segment->titles + segment->title_offsets[d], keys, 512);
+        for (int k = 0; k < key_count; k++) {
+            GramSlot* slot = find_slot(segment->slots, segment->slot_mask, keys[k]);
+            if (slot->last_doc != d) {
+                slot->last_doc = d;
+                segment->postings[slot->start + slot->count++] = d;
+            }
+        }
+    }
+
+    return segment;
+}
+
+// ============================================================================
+// Index Lifetime
+// ============================================================================
+
+/**
+ * Share previous's segments if all their titles are unchanged in catalog,
+ * adding a segment for the new videos
+ * Returns: 0 on success, -1 if the index must be rebuilt from scratch
+ */
+static int reuse_segments(SearchIndex* index, const Catalog* catalog, const SearchIndex* previous) {
+    char* covered = calloc(catalog->video_count + 1, 1);
+    if (!covered) {
+        return -1;
+    }
+
+    int reused_docs = 0;
+    for (int s = 0; s < previous->segment_count; s++) {
+        const Segment* segment = previous->segments[s];
+        for (int d = 0; d < segment->doc_count; d++) {
+            int i = catalog_video_index(catalog, segment->doc_ids[d]);
+            if (i < 0 || title_hash(catalog->videos[i].title) != segment->title_hashes[d]) {
+                free(covered);
+                return -1;  // Removed or renamed
+            }
+            covered[i] = 1;
+        }
+        reused_docs += segment->doc_count;
+    }
+
+    int added = catalog->video_count - reused_docs;
+    int first_docs = previous->segment_count > 0 ? previous->segments[0]->doc_count : 0;
+
+    // Merge (full rebuild) once the small segments hold a quarter of the titles
+    if (added > 0 && (previous->segment_count == SEARCH_MAX_SEGMENTS ||
+                      (reused_docs - first_docs + added) * 4 > catalog->video_count)) {
+        free(covered);
+        return -1;
+    }
+
+    Segment* delta = NULL;
+    if (added > 0) {
+        int* indexes = malloc(added * sizeof(int));
+        int count = 0;
+        for (int i = 0; indexes && i < catalog->video_count; i++) {
+            if (!covered[i]) {
+                indexes[count++] = i;
+            }
+        }
+        delta = indexes ? segment_build(catalog, indexes, count) : NULL;
+        free(indexes);
+        if (!delta) {
+            free(covered);
+            return -1;
+        }
+    }
+    free(covered);
+
+    for (int s = 0; s < previous->segment_count; s++) {
+        __sync_add_and_fetch(&previous->segments[s]->refcount, 1);
+        index->segments[index->segment_count++] = previous->segments[s];
+    }
+    if (delta) {
+        index->segments[index->segment_count++] = delta;
+    }
+    return 0;
+}
+
+SearchIndex* search_index_build(const Catalog* catalog, const SearchIndex* previous) {
+    SearchIndex* index = calloc(1, sizeof(SearchIndex));
+    if (!index) {
+        return NULL;
+    }
+
+    if (previous && reuse_segments(index, catalog, previous) == 0) {
+        return index;
+    }
+
+    int* indexes = malloc((catalog->video_count + 1) * sizeof(int));
+    if (!indexes) {
+        free(index);
+        return NULL;
+    }
+    for (int i = 0; i < catalog->video_count; i++) {
+        indexes[i] = i;
+    }
+
+    index->segments[0] = segment_build(catalog, indexes, catalog->video_count);
+    free(indexes);
+    if (!index->segments[0]) {
+        free(index);
+        return NULL;
+    }
+    index->segment_count = 1;
+    return index;
+}
+
+void search_index_free(SearchIndex* index) {
+    if (!index) {
+        return;
+    }
+    for (int s = 0; s < index->segment_count; s++) {
+        segment_release(index->segments[s]);
+    }
+    free(index);
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+typedef struct {
+    const int* docs;
+    uint32_t count;
+} PostingList;
+
+typedef struct {
+    const Segment* segment;
+    int doc;
+    int score;
+} Candidate;
+
+static const char* candidate_title(const Candidate* candidate) {
+    return candidate->segment->titles + candidate->segment->title_offsets[candidate->doc];
+}
+
+/**
+ * Whether doc is in list[*from ..); advances *from (candidates are ascending)
+ * Gallops from the cursor first, since the next match is usually close.
+ */
+static int posting_contains(const PostingList* list, uint32_t* from, int doc) {
+    uint32_t low = *from;
+    uint32_t step = 1;
+    while (low + step < list->count && list->docs[low + step] < doc) {
+        low += step;
+        step *= 2;
+    }
+    uint32_t high = low + step < list->count ? low + step + 1 : list->count;
+
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (list->docs[mid] < doc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    *from = low;
+    return low < list->count && list->docs[low] == doc;
+}
+
+/**
+ * Whether a ranks below b (lower score; ties: later title)
+ */
+static int candidate_worse(const Candidate* a, const Candidate* b) {
+    if (a->score != b->score) {
+        return a->score < b->score;
+    }
+    return strcmp(candidate_title(a), candidate_title(b)) > 0;
+}
+
+/**
+ * Put candidate at the root of a min-heap of `size` entries and restore heap order
+ */
+static void heap_sift_down(Candidate* heap, int size, Candidate candidate) {
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && candidate_worse(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!candidate_worse(&heap[child], &candidate)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = candidate;
+}
+
+/**
+ * Offer a candidate to the min-heap of the best `max` (root = worst kept)
+ */
+static void heap_offer(Candidate* heap, int* size, int max, Candidate candidate) {
+    if (*size < max) {
+        // Sift up
+        int i = (*size)++;
+        while (i > 0 && candidate_worse(&candidate, &heap[(i - 1) / 2])) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = candidate;
+    } else if (max > 0 && candidate_worse(&heap[0], &candidate)) {
+        heap_sift_down(heap, *size, candidate);
+    }
+}
+
+/**
+ * Distinct gram keys to look up: bigrams, or unigrams for a query
+ * without two adjacent non-space characters
+ */
+static int query_grams(const char* query, uint64_t* keys, int max_keys) {
+    uint32_t cps[SEARCH_MAX_QUERY_CHARS];
+    int cp_count = 0;
+    const unsigned char* p = (const unsigned char*)query;
+    uint32_t cp;
+
+    while (cp_count < SEARCH_MAX_QUERY_CHARS && (cp = next_code_point(&p)) != 0) {
+        cps[cp_count++] = cp;
+    }
+
+    int count = 0;
+    for (int pass = 0; pass < 2 && count == 0; pass++) {
+        for (int i = 0; i < cp_count && count < max_keys; i++) {
+            uint64_t key;
+            if (pass == 0) {
+                if (i + 1 == cp_count || is_space(cps[i]) || is_space(cps[i + 1])) {
+                    continue;
+                }
+                key = gram_key(cps[i], cps[i + 1]);
+            } else {
+                if (is_space(cps[i])) {
+                    continue;
+                }
+                key = gram_key(cps[i], 0);
+            }
+
+            int seen = 0;
+            for (int k = 0; k < count && !seen; k++) {
+                seen = keys[k] == key;
+            }
+            if (!seen) {
+                keys[count++] = key;
+            }
+        }
+    }
+
+    return count;
+}
+
+int search_index_query(const SearchIndex* index, const Catalog* catalog, const char* query,
+                       SearchHit* hits, int max_hits, int* total) {
+    *total = 0;
+
+    // Longer than any title: nothing can match
+    char lowered[sizeof(((Video*)0)->title)];
+    size_t query_len = strlen(query);
+    if (query_len >= sizeof(lowered)) {
+        return 0;
+    }
+    lowercase_copy(lowered, query, query_len);
+
+    uint64_t keys[SEARCH_MAX_QUERY_CHARS];
+    int key_count = query_grams(lowered, keys, SEARCH_MAX_QUERY_CHARS);
+    if (key_count == 0 || max_hits < 0) {
+        return 0;
+    }
+
+    Candidate* heap = malloc((max_hits + 1) * sizeof(Candidate));
+    if (!heap) {
+        return 0;
+    }
+    int heap_size = 0;
+
+    for (int s = 0; s < index->segment_count; s++) {
+        const Segment* segment = index->segments[s];
+        PostingList lists[SEARCH_MAX_QUERY_CHARS];
+        int missing = 0;
+
+        for (int k = 0; k < key_count && !missing; k++) {
+            const GramSlot* slot = find_slot(segment->slots, segment->slot_mask, keys[k]);
+            missing = slot->key == 0;
+            lists[k].docs = segment->postings + slot->start;
+            lists[k].count = slot->count;
+        }
+        if (missing) {
+            continue;
+        }
+
+        // Shortest list first: it bounds the candidates
+        for (int k = 1; k < key_count; k++) {
+            PostingList list = lists[k];
+            int j = k;
+            while (j > 0 && lists[j - 1].count > list.count) {
+                lists[j] = lists[j - 1];
+                j--;
+            }
+            lists[j] = list;
+        }
+
+        uint32_t cursors[SEARCH_MAX_QUERY_CHARS] = {0};
+        for (uint32_t c = 0; c < lists[0].count; c++) {
+            int doc = lists[0].docs[c];
+            int in_all = 1;
+            for (int k = 1; k < key_count && in_all; k++) {
+                in_all = posting_contains(&lists[k], &cursors[k], doc);
+            }
+            if (!in_all) {
+                continue;
+            }
+
+            uint32_t offset = segment->title_offsets[doc];
+            int score = match_score(segment->titles + offset,
+                                    segment->title_offsets[doc + 1] - offset - 1,
+                                    lowered, query_len);
+            if (score < 0) {
+                continue;  // Grams present, but not as one substring
+            }
+
+            (*total)++;
+            Candidate candidate = {segment, doc, score};
+            heap_offer(heap, &heap_size, max_hits, candidate);
+        }
+    }
+
+    // Heap to ranked order: move the worst remaining candidate to the back
+    for (int end = heap_size - 1; end > 0; end--) {
+        Candidate worst = heap[0];
+        heap_sift_down(heap, end, heap[end]);
+        heap[end] = worst;
+    }
+
+    // Documents to catalog indexes (the index was built from this catalog)
+    int hit_count = 0;
+    for (int h = 0; h < heap_size; h++) {
+        int i = catalog_video_index(catalog, heap[h].segment->doc_ids[heap[h].doc]);
+        if (i >= 0) {
+            hits[hit_count].index = i;
+            hits[hit_count].score = heap[h].score;
+            hit_count++;
+        }
+    }
+
+    free(heap);
+    return hit_count;
+}
@@ -1,7 +1,28 @@
 /*
  * OTT Streaming Server - Session Management with Shared Memory
  *
- * POSIX Shared Memory + Semaphore for multi-process session sharing
+ * Shared mmap segment + process-shared robust mutexes for multi-process
+ * session sharing. The segment is a file (SESSION_STORE_PATH), so
+ * sessions survive a restart or deploy. Sessions live in an open-addressing hash table keyed
+ * by the binary 128-bit session ID; session_lookup() validates,
+ * refreshes and reads a session with a single probe.
+ *
+ * The table is sized at startup (--max-sessions, up to millions) and
+ * split into SESSION_STRIPES independent stripes (chosen by key bits),
+ * each with its own mutex for writers and a sequence counter for
+ * readers (seqlock): writers make it odd while they change slots,
+ * readers copy a session without locking and retry if the counter
+ * moved. A worker that dies holding a stripe lock leaves the sequence
+ * odd; the next locker gets EOWNERDEAD and rebuilds the stripe.
+ * Refreshing last_accessed is a write, so it happens at most once per
+ * SESSION_TOUCH_INTERVAL per session.
+ *
+ * Expired sessions are removed by a background sweeper (and lazily by
+ * lookups); logins never sweep.
+ *
+ * With --session-tokens the public session functions use signed
+ * stateless tokens instead of the table (session_token.h).
+ *
  * Enhancement Phase 2: Database integration
  * Author: Generated for Network Programming Final Project
  * Date: 2025-11-03
@@ -9,330 +30,921 @@
 
 #include "../include/server.h"
 #include "../include/database.h"
+#include "../include/random_pool.h"
 #include "../include/json.h"
 #include "../include/validation.h"
+#include "../include/session_token.h"
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+#if (SESSION_STRIPES & (SESSION_STRIPES - 1)) != 0
+#error "SESSION_STRIPES must be a power of 2"
+#endif
+
+#define STORE_MAGIC "OTTSESS"    // Store file header (with the NUL: 8 bytes)
+#define STORE_VERSION 2         // Bump when Session or the store layout changes
+#define MIN_STRIPE_SLOTS 8
+#define CREATE_ATTEMPTS 8       // New IDs tried when the chosen stripe is full
+#define READ_RETRIES 4          // Optimistic reads before falling back to the lock
 
 // Shared memory structures
 typedef struct {
-    Session sessions[MAX_SESSIONS];
+    pthread_mutex_t lock;               // Writers (process-shared, robust)
+    volatile unsigned int sequence;     // Odd while a writer changes slots
     int session_count;
+} __attribute__((aligned(64))) SessionStripe;
+
+typedef struct {
+    char magic[8];                      // STORE_MAGIC
+    unsigned int version;               // STORE_VERSION
+    unsigned int session_size;          // sizeof(Session) of the build that wrote it
+    unsigned int stripe_count;          // SESSION_STRIPES of the build that wrote it
+    unsigned int stripe_slots;          // Slots per stripe (power of 2)
+    unsigned int stripe_mask;
+    int stripe_max;                     // Sessions per stripe (3/4 load keeps probe runs short)
+    int capacity;                       // Sessions allowed in the store (--max-sessions)
+    int session_count;                  // All stripes (atomic)
+    SessionStripe stripes[SESSION_STRIPES];
+    Session slots[];                    // Stripe i: slots[i * stripe_slots ..], linear probing
 } SharedSessionStore;
 
-// Global variables
-static int shm_id = -1;
+// Global variables (the mapping is inherited by prefork workers)
 static SharedSessionStore* session_store = NULL;
-static sem_t* session_sem = NULL;
+static size_t session_store_size = 0;
+static int store_fd = -1;               // Store file (locked while the server runs)
 
-#define SEM_NAME "/ott_session_sem"
+// Background sweeper (one process runs it, see session_sweeper_start)
+static pthread_t sweeper_thread;
+static int sweeper_running = 0;
+static int sweeper_stop = 0;
+static pthread_mutex_t sweeper_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sweeper_cond = PTHREAD_COND_INITIALIZER;
+
+// ============================================================================
+// Session IDs
+// ============================================================================
 
 /**
- * Initialize shared memory session store
- * Called once by parent process at server startup
+ * Fill key with SESSION_RANDOM_BYTES cryptographically secure random bytes
+ * Drawn from the thread's getrandom() pool: no syscall on most logins.
+ * Returns: 0 on success, -1 if no secure random bytes are available
  */
-void init_session_store() {
-    // Create shared memory segment
-    shm_id = shmget(IPC_PRIVATE,
-                    sizeof(SharedSessionStore),
-                    IPC_CREAT | 0666);
-
-    if (shm_id < 0) {
-        perror("shmget failed");
-        exit(EXIT_FAILURE);
+static int generate_session_key(unsigned char* key) {
+    if (random_bytes(key, SESSION_RANDOM_BYTES) != 0) {
+        fprintf(stderr, "❌ Cannot generate session ID: no secure random bytes\n");
+        return -1;
     }
+    return 0;
+}
+
+/**
+ * Session key to its cookie form (SESSION_HEX_LENGTH lowercase hex chars)
+ */
+static void encode_session_id(const unsigned char* key, char* session_id) {
+    const char* hex_chars = "0123456789abcdef";
 
-    // Attach to shared memory
-    session_store = (SharedSessionStore*)shmat(shm_id, NULL, 0);
-    if (session_store == (void*)-1) {
-        perror("shmat failed");
-        exit(EXIT_FAILURE);
+    for (int i = 0; i < SESSION_RANDOM_BYTES; i++) {
+        session_id[i * HEX_CHARS_PER_BYTE] = hex_chars[(key[i] >> HEX_SHIFT_HIGH) & 0x0F];
+        session_id[i * HEX_CHARS_PER_BYTE + 1] = hex_chars[key[i] & 0x0F];
     }
+    session_id[SESSION_HEX_LENGTH] = '\0';
+}
 
-    // Initialize session store
-    memset(session_store, 0, sizeof(SharedSessionStore));
-    session_store->session_count = 0;
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Cookie value to session key
+ * Returns: 0 on success, -1 if not exactly SESSION_HEX_LENGTH hex chars
+ */
+static int decode_session_id(const char* session_id, unsigned char* key) {
+    if (!session_id) {
+        return -1;
+    }
 
-    // Create/open semaphore for synchronization
-    // Remove existing semaphore first
-    sem_unlink(SEM_NAME);
+    for (int i = 0; i < SESSION_RANDOM_BYTES; i++) {
+        int high = hex_value(session_id[i * HEX_CHARS_PER_BYTE]);
+        int low = high < 0 ? -1 : hex_value(session_id[i * HEX_CHARS_PER_BYTE + 1]);
+        if (low < 0) {
+            return -1;
+        }
+        key[i] = (unsigned char)((high << HEX_SHIFT_HIGH) | low);
+    }
+    return session_id[SESSION_HEX_LENGTH] == '\0' ? 0 : -1;
+}
 
-    session_sem = sem_open(SEM_NAME, O_CREAT | O_EXCL, 0644, 1);
-    if (session_sem == SEM_FAILED) {
-        perror("sem_open failed");
-        shmdt(session_store);
-        shmctl(shm_id, IPC_RMID, NULL);
-        exit(EXIT_FAILURE);
+/**
+ * Generate cryptographically secure session ID
+ * Format: 32 hexadecimal characters (128 bits of entropy)
+ * Returns: 0 on success, -1 if no secure random bytes are available
+ */
+int generate_session_id(char* session_id) {
+    unsigned char key[SESSION_RANDOM_BYTES];  // 128 bits
+    if (generate_session_key(key) != 0) {
+        return -1;
     }
+    encode_session_id(key, session_id);
+    return 0;
+}
 
-    srand(time(NULL));  // Initialize random seed
+// ============================================================================
+// Striped Hash Table
+// ============================================================================
 
-    printf("✓ Session store initialized (shared memory)\n");
-    printf("  - Shared memory ID: %d\n", shm_id);
-    printf("  - Max sessions: %d\n", MAX_SESSIONS);
-    printf("  - Semaphore: %s\n", SEM_NAME);
+/**
+ * Stripe and home slot of a key
+ * Keys are random bytes generated by the server, so their bytes already
+ * are a uniform hash (clients cannot choose keys that collide).
+ */
+static SessionStripe* stripe_of(const unsigned char* key) {
+    unsigned int hash;
+    memcpy(&hash, key + sizeof(hash), sizeof(hash));
+    return &session_store->stripes[hash & (SESSION_STRIPES - 1)];
 }
 
+static unsigned int home_slot(const unsigned char* key) {
+    unsigned int hash;
+    memcpy(&hash, key, sizeof(hash));
+    return hash & session_store->stripe_mask;
+}
+
+static Session* slots_of(const SessionStripe* stripe) {
+    size_t index = stripe - session_store->stripes;
+    return session_store->slots + index * session_store->stripe_slots;
+}
+
+static void repair_stripe(SessionStripe* stripe, time_t now);
+
 /**
- * Cleanup shared memory and semaphore
- * Called at server shutdown
+ * Take a stripe's lock; if its holder died mid-change (odd sequence),
+ * rebuild the stripe first. Readers keep retrying while it stays odd.
  */
-void cleanup_session_store() {
-    if (session_store != NULL) {
-        shmdt(session_store);
-        if (shm_id >= 0) {
-            shmctl(shm_id, IPC_RMID, NULL);
+static void lock_stripe(SessionStripe* stripe) {
+    if (pthread_mutex_lock(&stripe->lock) == EOWNERDEAD) {
+        if (stripe->sequence & 1) {
+            repair_stripe(stripe, time(NULL));
+            __sync_synchronize();
+            stripe->sequence++;
         }
+        pthread_mutex_consistent(&stripe->lock);
     }
+}
 
-    if (session_sem != NULL) {
-        sem_close(session_sem);
-        sem_unlink(SEM_NAME);
-    }
+static void unlock_stripe(SessionStripe* stripe) {
+    pthread_mutex_unlock(&stripe->lock);
+}
 
-    printf("✓ Session store cleaned up\n");
+/**
+ * Begin/end a change to a stripe's slots (writers exclude each other;
+ * the odd sequence tells readers to retry)
+ */
+static void stripe_write_lock(SessionStripe* stripe) {
+    lock_stripe(stripe);
+    stripe->sequence++;
+    __sync_synchronize();
+}
+
+static void stripe_write_unlock(SessionStripe* stripe) {
+    __sync_synchronize();
+    stripe->sequence++;
+    unlock_stripe(stripe);
 }
 
 /**
- * Generate cryptographically secure session ID
- * Uses /dev/urandom for secure randomness (Unix/Linux/macOS)
- * Format: 32 hexadecimal characters (128 bits of entropy)
+ * Slot holding key (bounded: a racing writer may change slots under a reader)
+ * Returns: slot index, or -1 if not found
  */
-void generate_session_id(char* session_id) {
-    unsigned char random_bytes[SESSION_RANDOM_BYTES];  // 128 bits
-    const char* hex_chars = "0123456789abcdef";
+static long find_slot(const SessionStripe* stripe, const unsigned char* key) {
+    const Session* slots = slots_of(stripe);
+    unsigned int mask = session_store->stripe_mask;
+    unsigned int slot = home_slot(key);
+
+    for (unsigned int probes = 0; probes <= mask && slots[slot].is_active; probes++) {
+        if (memcmp(slots[slot].key, key, SESSION_RANDOM_BYTES) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
 
-    // Open /dev/urandom for cryptographically secure random bytes
-    FILE* urandom = fopen("/dev/urandom", "rb");
-    if (!urandom) {
-        // Fallback: use time + process ID for less secure but working alternative
-        fprintf(stderr, "[WARNING] Cannot open /dev/urandom, using weak fallback\n");
-        srand(time(NULL) ^ getpid());
-        for (int i = 0; i < SESSION_RANDOM_BYTES; i++) {
-            random_bytes[i] = (unsigned char)(rand() % MAX_RANDOM_BYTE_VALUE);
+/**
+ * Copy the session for key without taking the stripe lock (seqlock read)
+ * Falls back to the lock if writers keep changing the stripe.
+ * Returns: 1 if found (copied to out), 0 if not found
+ */
+static int read_session(SessionStripe* stripe, const unsigned char* key, Session* out) {
+    const Session* slots = slots_of(stripe);
+
+    for (int attempt = 0; attempt < READ_RETRIES; attempt++) {
+        unsigned int start = stripe->sequence;
+        if (start & 1) {
+            sched_yield();  // A writer is mid-change (possibly preempted)
+            continue;
         }
-    } else {
-        // Read SESSION_RANDOM_BYTES random bytes from /dev/urandom
-        size_t bytes_read = fread(random_bytes, 1, SESSION_RANDOM_BYTES, urandom);
-        fclose(urandom);
-
-        if (bytes_read != SESSION_RANDOM_BYTES) {
-            fprintf(stderr, "[ERROR] Failed to read from /dev/urandom\n");
-            // Fallback to weak randomness
-            srand(time(NULL) ^ getpid());
-            for (int i = 0; i < SESSION_RANDOM_BYTES; i++) {
-                random_bytes[i] = (unsigned char)(rand() % MAX_RANDOM_BYTE_VALUE);
-            }
+        __sync_synchronize();
+
+        long slot = find_slot(stripe, key);
+        if (slot >= 0) {
+            *out = slots[slot];
+        }
+
+        __sync_synchronize();
+        if (stripe->sequence == start) {
+            return slot >= 0;
         }
     }
 
-    // Convert to hexadecimal string (SESSION_HEX_LENGTH chars + null terminator)
-    for (int i = 0; i < SESSION_RANDOM_BYTES; i++) {
-        session_id[i * HEX_CHARS_PER_BYTE] = hex_chars[(random_bytes[i] >> HEX_SHIFT_HIGH) & 0x0F];
-        session_id[i * HEX_CHARS_PER_BYTE + 1] = hex_chars[random_bytes[i] & 0x0F];
+    lock_stripe(stripe);
+    long slot = find_slot(stripe, key);
+    if (slot >= 0) {
+        *out = slots[slot];
     }
-    session_id[SESSION_HEX_LENGTH] = '\0';
+    unlock_stripe(stripe);
+    return slot >= 0;
 }
 
 /**
- * Create new session for user
- * Thread-safe with semaphore
- * Returns: 1 on success, 0 on failure
+ * Empty a slot, moving later entries of the probe run back into the gap
+ * (backward-shift deletion: no tombstones, probe runs stay short)
+ * Caller holds the stripe write lock.
  */
-int create_session(int user_id, const char* username, char* session_id_out, size_t session_id_size) {
-    if (!username || !session_id_out || session_id_size < SESSION_ID_LENGTH) {
-        return 0;
+static void remove_slot_locked(SessionStripe* stripe, unsigned int hole) {
+    Session* slots = slots_of(stripe);
+    unsigned int mask = session_store->stripe_mask;
+    unsigned int slot = hole;
+
+    while (1) {
+        slot = (slot + 1) & mask;
+        Session* entry = &slots[slot];
+        if (!entry->is_active) {
+            break;
+        }
+
+        // Move entry into the hole unless its home lies cyclically in (hole, slot]
+        unsigned int home = home_slot(entry->key);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            slots[hole] = *entry;
+            hole = slot;
+        }
     }
 
-    // Lock semaphore
-    sem_wait(session_sem);
+    slots[hole].is_active = 0;
+    stripe->session_count--;
+    __sync_sub_and_fetch(&session_store->session_count, 1);
+}
 
-    // Check if store is full
-    if (session_store->session_count >= MAX_SESSIONS) {
-        printf("⚠️  Session store full, cleaning up expired sessions...\n");
+/**
+ * Remove sessions idle longer than SESSION_TIMEOUT from slots [start, end)
+ * Caller holds the stripe write lock. An entry shifted back past start
+ * by a removal is left for the next sweep (or a lookup).
+ * Returns: number of sessions removed
+ */
+static int expire_range_locked(SessionStripe* stripe, unsigned int start, unsigned int end, time_t now) {
+    Session* slots = slots_of(stripe);
+    int cleaned = 0;
+    unsigned int i = start;
 
-        // Cleanup without locking (already locked)
-        time_t now = time(NULL);
-        int cleaned = 0;
-        for (int i = 0; i < MAX_SESSIONS; i++) {
-            if (session_store->sessions[i].is_active) {
-                if (now - session_store->sessions[i].last_accessed > SESSION_TIMEOUT) {
-                    session_store->sessions[i].is_active = 0;
-                    session_store->session_count--;
-                    cleaned++;
-                }
-            }
+    while (i < end) {
+        if (slots[i].is_active && now - slots[i].last_accessed > SESSION_TIMEOUT) {
+            remove_slot_locked(stripe, i);
+            cleaned++;
+            continue;  // A later entry may have moved into slot i
         }
+        i++;
+    }
+    return cleaned;
+}
+
+/**
+ * Expire sessions in every stripe, SESSION_SWEEP_BATCH slots per lock
+ * hold so logins and refreshes in the same stripe wait only briefly
+ * Returns: number of sessions removed
+ */
+static int expire_all_sessions(time_t now) {
+    unsigned int stripe_slots = session_store->stripe_slots;
+    int cleaned = 0;
 
-        if (cleaned > 0) {
-            printf("✓ Cleaned %d expired sessions\n", cleaned);
+    for (int i = 0; i < SESSION_STRIPES; i++) {
+        SessionStripe* stripe = &session_store->stripes[i];
+        for (unsigned int start = 0; start < stripe_slots; start += SESSION_SWEEP_BATCH) {
+            unsigned int end = stripe_slots - start > SESSION_SWEEP_BATCH ? start + SESSION_SWEEP_BATCH
+                                                                           : stripe_slots;
+            stripe_write_lock(stripe);
+            cleaned += expire_range_locked(stripe, start, end, now);
+            stripe_write_unlock(stripe);
         }
+    }
+    return cleaned;
+}
 
-        if (session_store->session_count >= MAX_SESSIONS) {
-            printf("❌ Cannot create session: store still full\n");
-            sem_post(session_sem);  // Unlock
-            return 0;
+/**
+ * Refresh or expire the session for key under the stripe lock
+ * (the optimistic read only decided that one of them is due)
+ * Returns: 1 if the session is still live, 0 if it expired or is gone
+ */
+static int touch_session(SessionStripe* stripe, const unsigned char* key, time_t now) {
+    stripe_write_lock(stripe);
+
+    int live = 0;
+    long slot = find_slot(stripe, key);
+    if (slot >= 0) {
+        Session* session = &slots_of(stripe)[slot];
+        if (now - session->last_accessed > SESSION_TIMEOUT) {
+            char session_id[SESSION_ID_LENGTH];
+            encode_session_id(key, session_id);
+            printf("⏰ Session expired: %s (user: %s, ID: %d)\n",
+                   session_id, session->username, session->user_id);
+            remove_slot_locked(stripe, slot);
+        } else {
+            session->last_accessed = now;
+            live = 1;
         }
     }
 
-    // Find empty slot
-    int slot = -1;
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (!session_store->sessions[i].is_active) {
-            slot = i;
+    stripe_write_unlock(stripe);
+    return live;
+}
+
+// ============================================================================
+// Background Sweeper
+// ============================================================================
+
+static void* sweeper_main(void* arg) {
+    (void)arg;
+
+    // Shutdown signals are handled elsewhere; this thread only sweeps
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    pthread_mutex_lock(&sweeper_lock);
+    while (!sweeper_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += SESSION_CLEANUP_INTERVAL;
+
+        pthread_cond_timedwait(&sweeper_cond, &sweeper_lock, &deadline);
+        if (sweeper_stop) {
             break;
         }
+
+        pthread_mutex_unlock(&sweeper_lock);
+        cleanup_expired_sessions();
+        pthread_mutex_lock(&sweeper_lock);
     }
+    pthread_mutex_unlock(&sweeper_lock);
 
-    if (slot == -1) {
-        printf("❌ Cannot create session: no available slot\n");
-        sem_post(session_sem);  // Unlock
-        return 0;
+    return NULL;
+}
+
+/**
+ * Start the background sweeper thread
+ * The store is shared: run it in one process only.
+ * Returns: 0 on success, -1 on failure
+ */
+int session_sweeper_start() {
+    if (sweeper_running || session_token_enabled()) {
+        return 0;  // Token mode leaves the table empty
+    }
+
+    sweeper_stop = 0;
+    if (pthread_create(&sweeper_thread, NULL, sweeper_main, NULL) != 0) {
+        perror("pthread_create (session sweeper)");
+        return -1;
+    }
+    sweeper_running = 1;
+
+    printf("✓ Session sweeper started (every %ds)\n", SESSION_CLEANUP_INTERVAL);
+    return 0;
+}
+
+/**
+ * Stop the sweeper (waits for a sweep in progress)
+ */
+void session_sweeper_stop() {
+    if (!sweeper_running) {
+        return;
     }
 
-    // Generate session ID
-    generate_session_id(session_store->sessions[slot].session_id);
+    pthread_mutex_lock(&sweeper_lock);
+    sweeper_stop = 1;
+    pthread_cond_signal(&sweeper_cond);
+    pthread_mutex_unlock(&sweeper_lock);
 
-    // Set session data
-    session_store->sessions[slot].user_id = user_id;
-    strncpy(session_store->sessions[slot].username, username, USER_ID_LENGTH - 1);
-    session_store->sessions[slot].username[USER_ID_LENGTH - 1] = '\0';
-    session_store->sessions[slot].created_at = time(NULL);
-    session_store->sessions[slot].last_accessed = time(NULL);
-    session_store->sessions[slot].is_active = 1;
+    pthread_join(sweeper_thread, NULL);
+    sweeper_running = 0;
+}
 
-    session_store->session_count++;
+// ============================================================================
+// Store Setup
+// ============================================================================
 
-    // Copy to caller's buffer before unlocking
-    strncpy(session_id_out, session_store->sessions[slot].session_id, session_id_size - 1);
-    session_id_out[session_id_size - 1] = '\0';
+static unsigned int stripe_slots_for(int max_sessions) {
+    unsigned int stripe_slots = MIN_STRIPE_SLOTS;
+    while ((size_t)stripe_slots * SESSION_STRIPES < (size_t)max_sessions * 2) {
+        stripe_slots *= 2;
+    }
+    return stripe_slots;
+}
 
-    printf("✓ Session created: %s for user '%s' (ID: %d, total: %d)\n",
-           session_id_out, username, user_id, session_store->session_count);
+static size_t store_size(unsigned int stripe_slots) {
+    return sizeof(SharedSessionStore) + (size_t)stripe_slots * SESSION_STRIPES * sizeof(Session);
+}
 
-    // Unlock semaphore
-    sem_post(session_sem);
+/**
+ * Write the header of an empty (zeroed) store
+ */
+static void format_store(SharedSessionStore* store, unsigned int stripe_slots) {
+    memcpy(store->magic, STORE_MAGIC, sizeof(store->magic));
+    store->version = STORE_VERSION;
+    store->session_size = sizeof(Session);
+    store->stripe_count = SESSION_STRIPES;
+    store->stripe_slots = stripe_slots;
+}
 
-    return 1;
+/**
+ * Whether a mapped file holds a store this build can use as is
+ */
+static int store_compatible(const SharedSessionStore* store, size_t file_size) {
+    return memcmp(store->magic, STORE_MAGIC, sizeof(store->magic)) == 0 &&
+           store->version == STORE_VERSION &&
+           store->session_size == sizeof(Session) &&
+           store->stripe_count == SESSION_STRIPES &&
+           store->stripe_slots >= MIN_STRIPE_SLOTS &&
+           (store->stripe_slots & (store->stripe_slots - 1)) == 0 &&
+           file_size == store_size(store->stripe_slots);
 }
 
 /**
- * Validate session by session_id
- * Thread-safe with semaphore
- * Returns: 1 if valid, 0 if invalid
+ * Insert a session read back from a file (startup only, no locking)
+ * Expired and duplicate sessions are dropped.
+ * Returns: 1 if inserted, 0 if dropped
  */
-int validate_session(const char* session_id) {
-    if (!session_id || strlen(session_id) == 0) {
+static int restore_session(const Session* entry, time_t now) {
+    if (!entry->is_active || now - entry->last_accessed > SESSION_TIMEOUT) {
+        return 0;
+    }
+
+    SessionStripe* stripe = stripe_of(entry->key);
+    if (stripe->session_count >= session_store->stripe_max || find_slot(stripe, entry->key) >= 0) {
         return 0;
     }
 
-    // Lock semaphore
-    sem_wait(session_sem);
+    Session* slots = slots_of(stripe);
+    unsigned int slot = home_slot(entry->key);
+    while (slots[slot].is_active) {
+        slot = (slot + 1) & session_store->stripe_mask;
+    }
+    slots[slot] = *entry;
+    stripe->session_count++;
+    __sync_add_and_fetch(&session_store->session_count, 1);
+    return 1;
+}
+
+/**
+ * Rebuild a stripe a process left mid-change (odd sequence: it died
+ * holding the stripe lock), so its probe runs are consistent again
+ * Runs at startup, or under the lock when it reports EOWNERDEAD.
+ */
+static void repair_stripe(SessionStripe* stripe, time_t now) {
+    Session* slots = slots_of(stripe);
+    unsigned int stripe_slots = session_store->stripe_slots;
+
+    Session* saved = malloc((size_t)stripe_slots * sizeof(Session));
+    if (saved) {
+        memcpy(saved, slots, (size_t)stripe_slots * sizeof(Session));
+    }
+    memset(slots, 0, (size_t)stripe_slots * sizeof(Session));
+    __sync_sub_and_fetch(&session_store->session_count, stripe->session_count);
+    stripe->session_count = 0;
+
+    int restored = 0;
+    for (unsigned int i = 0; saved && i < stripe_slots; i++) {
+        restored += restore_session(&saved[i], now);
+    }
+    free(saved);
+
+    printf("⚠️  Session stripe %d was left mid-update, %d sessions recovered\n",
+           (int)(stripe - session_store->stripes), restored);
+}
+
+/**
+ * Map the store file, reusing its sessions
+ *
+ * A compatible file of the same size is used in place: nothing is read
+ * up front, and expired sessions go lazily (lookups, sweeper). Otherwise
+ * (other --max-sessions, old format) the live sessions are copied into a
+ * new file that replaces it.
+ * Returns: 0 on success, -1 on failure
+ */
+static int open_store_file(const char* path, int max_sessions) {
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        perror("Cannot open session store file");
+        return -1;
+    }
+
+    // Two servers on one file would corrupt it
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "❌ Session store %s is in use by another server\n", path);
+        close(fd);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat (session store) failed");
+        close(fd);
+        return -1;
+    }
 
+    unsigned int stripe_slots = stripe_slots_for(max_sessions);
+    size_t size = store_size(stripe_slots);
     time_t now = time(NULL);
-    int result = 0;
-
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (session_store->sessions[i].is_active &&
-            strcmp(session_store->sessions[i].session_id, session_id) == 0) {
-
-            // Check if session is expired
-            if (now - session_store->sessions[i].last_accessed > SESSION_TIMEOUT) {
-                printf("⏰ Session expired: %s (user: %s, ID: %d)\n",
-                       session_id, session_store->sessions[i].username, session_store->sessions[i].user_id);
-                session_store->sessions[i].is_active = 0;
-                session_store->session_count--;
-                result = 0;
-            } else {
-                result = 1;  // Valid session
+
+    SharedSessionStore* old = NULL;
+    if ((size_t)st.st_size >= sizeof(SharedSessionStore)) {
+        old = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (old == MAP_FAILED) {
+            old = NULL;
+        } else if (!store_compatible(old, st.st_size)) {
+            printf("⚠️  Session store %s has another format, starting empty\n", path);
+            munmap(old, st.st_size);
+            old = NULL;
+        }
+    }
+
+    if (old && old->stripe_slots == stripe_slots) {
+        session_store = old;
+        session_store_size = size;
+        store_fd = fd;
+        session_store->stripe_mask = stripe_slots - 1;
+        session_store->stripe_max = stripe_slots * 3 / 4;
+
+        session_store->session_count = 0;
+        for (int i = 0; i < SESSION_STRIPES; i++) {
+            session_store->session_count += session_store->stripes[i].session_count;
+        }
+        for (int i = 0; i < SESSION_STRIPES; i++) {
+            if (session_store->stripes[i].sequence & 1) {
+                repair_stripe(&session_store->stripes[i], now);
             }
-            break;
         }
+
+        printf("✓ Restored %d sessions from %s\n", session_store->session_count, path);
+        return 0;
     }
 
-    // Unlock semaphore
-    sem_post(session_sem);
+    // New file next to the old one, renamed over it once filled
+    char tmp_path[MAX_PATH];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
 
-    return result;
+    int new_fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (new_fd < 0 || flock(new_fd, LOCK_EX | LOCK_NB) != 0 || ftruncate(new_fd, size) != 0) {
+        perror("Cannot create session store file");
+        if (new_fd >= 0) {
+            close(new_fd);
+        }
+        if (old) {
+            munmap(old, st.st_size);
+        }
+        close(fd);
+        return -1;
+    }
+
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror("mmap (session store) failed");
+        close(new_fd);
+        unlink(tmp_path);
+        if (old) {
+            munmap(old, st.st_size);
+        }
+        close(fd);
+        return -1;
+    }
+
+    session_store = mapping;
+    session_store_size = size;
+    store_fd = new_fd;
+    format_store(session_store, stripe_slots);
+    session_store->stripe_mask = stripe_slots - 1;
+    session_store->stripe_max = stripe_slots * 3 / 4;
+
+    if (old) {
+        size_t old_slots = (size_t)old->stripe_slots * SESSION_STRIPES;
+        for (size_t i = 0; i < old_slots; i++) {
+            restore_session(&old->slots[i], now);
+        }
+        printf("✓ Moved %d sessions from %s to the new size\n", session_store->session_count, path);
+        munmap(old, st.st_size);
+    }
+
+    if (rename(tmp_path, path) != 0) {
+        perror("Cannot replace session store file");
+    }
+    close(fd);
+    return 0;
 }
 
 /**
- * Refresh session (update last_accessed time)
- * Thread-safe with semaphore
+ * Initialize shared memory session store
+ * Called once by parent process at server startup
+ * @param max_sessions Capacity (the table gets about twice as many slots)
+ * @param path Store file (sessions survive restarts), or NULL for memory only
  */
-void refresh_session(const char* session_id) {
-    if (!session_id) return;
+void init_session_store(int max_sessions, const char* path) {
+    if (path) {
+        if (open_store_file(path, max_sessions) != 0) {
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        unsigned int stripe_slots = stripe_slots_for(max_sessions);
+        size_t size = store_size(stripe_slots);
+
+        // Anonymous pages start zeroed and are only backed once touched
+        void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapping == MAP_FAILED) {
+            perror("mmap (session store) failed");
+            exit(EXIT_FAILURE);
+        }
+
+        session_store = mapping;
+        session_store_size = size;
+        format_store(session_store, stripe_slots);
+        session_store->stripe_mask = stripe_slots - 1;
+        session_store->stripe_max = stripe_slots * 3 / 4;
+    }
+    session_store->capacity = max_sessions;
+
+    // One robust mutex per stripe, shared with forked workers.
+    // Re-created on every start: a restored file holds stale ones.
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    for (int i = 0; i < SESSION_STRIPES; i++) {
+        session_store->stripes[i].sequence = 0;
+        int rc = pthread_mutex_init(&session_store->stripes[i].lock, &attr);
+        if (rc != 0) {
+            fprintf(stderr, "pthread_mutex_init (session stripe) failed: %s\n", strerror(rc));
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_mutexattr_destroy(&attr);
 
-    // Lock semaphore
-    sem_wait(session_sem);
+    size_t slot_count = (size_t)session_store->stripe_slots * SESSION_STRIPES;
+    printf("✓ Session store initialized (%s)\n", path ? path : "shared memory");
+    printf("  - Max sessions: %d (%zu hash slots, %.1f MB reserved)\n",
+           max_sessions, slot_count, session_store_size / (1024.0 * 1024.0));
+    printf("  - Lock stripes: %d (seqlock reads)\n", SESSION_STRIPES);
+}
 
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (session_store->sessions[i].is_active &&
-            strcmp(session_store->sessions[i].session_id, session_id) == 0) {
-            session_store->sessions[i].last_accessed = time(NULL);
-            break;
+/**
+ * Cleanup shared memory and stripe locks
+ * Called at server shutdown; a store file keeps its sessions
+ */
+void cleanup_session_store() {
+    session_sweeper_stop();
+    session_token_cleanup();
+
+    if (session_store != NULL) {
+        for (int i = 0; i < SESSION_STRIPES; i++) {
+            pthread_mutex_destroy(&session_store->stripes[i].lock);
         }
+        munmap(session_store, session_store_size);
+        session_store = NULL;
+    }
+    if (store_fd >= 0) {
+        close(store_fd);
+        store_fd = -1;
     }
 
-    // Unlock semaphore
-    sem_post(session_sem);
+    printf("✓ Session store cleaned up\n");
 }
 
+// ============================================================================
+// Session API
+// ============================================================================
+
 /**
- * Destroy session (logout)
- * Thread-safe with semaphore
+ * Create new session for user
+ * Thread-safe: locks only the stripe the new session goes to. Never
+ * sweeps: expired sessions are the background sweeper's job.
+ * @param session_id_out SESSION_ID_LENGTH bytes (SESSION_COOKIE_LENGTH for tokens)
+ * Returns: 1 on success, 0 on failure
  */
-void destroy_session(const char* session_id) {
-    if (!session_id) return;
-
-    // Lock semaphore
-    sem_wait(session_sem);
-
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (session_store->sessions[i].is_active &&
-            strcmp(session_store->sessions[i].session_id, session_id) == 0) {
-            printf("🚪 Session destroyed: %s (user: %s, ID: %d)\n",
-                   session_id, session_store->sessions[i].username, session_store->sessions[i].user_id);
-            session_store->sessions[i].is_active = 0;
-            session_store->session_count--;
+int create_session(int user_id, const char* username, char* session_id_out, size_t session_id_size) {
+    if (!username || !session_id_out || session_id_size < SESSION_ID_LENGTH) {
+        return 0;
+    }
+
+    if (session_token_enabled()) {
+        if (session_token_issue(user_id, username, session_id_out, session_id_size) != 0) {
+            printf("❌ Cannot issue session token for user '%s'\n", username);
+            return 0;
+        }
+        printf("✓ Session token issued for user '%s' (ID: %d)\n", username, user_id);
+        return 1;
+    }
+
+    // Reserve a place in the store
+    if (__sync_add_and_fetch(&session_store->session_count, 1) > session_store->capacity) {
+        __sync_sub_and_fetch(&session_store->session_count, 1);
+        printf("❌ Cannot create session: store full (%d sessions)\n", session_store->capacity);
+        return 0;
+    }
+
+    // The ID picks the stripe: draw another one if that stripe is full
+    for (int attempt = 0; attempt < CREATE_ATTEMPTS; attempt++) {
+        // Generate session ID (outside the lock: a pool refill is a syscall)
+        unsigned char key[SESSION_RANDOM_BYTES];
+        if (generate_session_key(key) != 0) {
             break;
         }
+
+        SessionStripe* stripe = stripe_of(key);
+        stripe_write_lock(stripe);
+
+        // 128 random bits never repeat in practice; checked anyway
+        if (stripe->session_count >= session_store->stripe_max || find_slot(stripe, key) >= 0) {
+            stripe_write_unlock(stripe);
+            continue;
+        }
+
+        // First free slot of the probe run (the stripe is never full)
+        Session* slots = slots_of(stripe);
+        unsigned int slot = home_slot(key);
+        while (slots[slot].is_active) {
+            slot = (slot + 1) & session_store->stripe_mask;
+        }
+
+        // Set session data
+        Session* session = &slots[slot];
+        memcpy(session->key, key, SESSION_RANDOM_BYTES);
+        session->user_id = user_id;
+        strncpy(session->username, username, USER_ID_LENGTH - 1);
+        session->username[USER_ID_LENGTH - 1] = '\0';
+        session->created_at = time(NULL);
+        session->last_accessed = session->created_at;
+        session->is_active = 1;
+        stripe->session_count++;
+
+        stripe_write_unlock(stripe);
+
+        encode_session_id(key, session_id_out);
+
+        printf("✓ Session created: %s for user '%s' (ID: %d, total: %d)\n",
+               session_id_out, username, user_id, session_store->session_count);
+        return 1;
     }
 
-    // Unlock semaphore
-    sem_post(session_sem);
+    __sync_sub_and_fetch(&session_store->session_count, 1);
+    printf("❌ Cannot create session: no available slot\n");
+    return 0;
 }
 
 /**
- * Clean up expired sessions
- * Thread-safe with semaphore
+ * Validate, refresh and read a session with one hash lookup
+ * Lock-free unless the session is due for a refresh or has expired.
+ * @param user_id Set to the session's user (may be NULL)
+ * @param username Set to the session's username (may be NULL)
+ * Returns: 1 if valid, 0 if invalid or expired
  */
-void cleanup_expired_sessions() {
-    // Lock semaphore
-    sem_wait(session_sem);
+int session_lookup(const char* session_id, int* user_id, char* username, size_t username_size) {
+    if (session_token_enabled()) {
+        return session_token_verify(session_id, user_id, username, username_size);
+    }
+
+    unsigned char key[SESSION_RANDOM_BYTES];
+    if (decode_session_id(session_id, key) != 0) {
+        return 0;  // Not a session ID: no need to look
+    }
+
+    SessionStripe* stripe = stripe_of(key);
+    Session session;
+    if (!read_session(stripe, key, &session)) {
+        return 0;
+    }
 
     time_t now = time(NULL);
-    int cleaned = 0;
+    if (now - session.last_accessed >= SESSION_TOUCH_INTERVAL && !touch_session(stripe, key, now)) {
+        return 0;
+    }
 
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (session_store->sessions[i].is_active) {
-            if (now - session_store->sessions[i].last_accessed > SESSION_TIMEOUT) {
-                printf("🧹 Cleaning expired session: %s (user: %s, ID: %d)\n",
-                       session_store->sessions[i].session_id,
-                       session_store->sessions[i].username,
-                       session_store->sessions[i].user_id);
-                session_store->sessions[i].is_active = 0;
-                session_store->session_count--;
-                cleaned++;
-            }
-        }
+    if (user_id) {
+        *user_id = session.user_id;
+    }
+    if (username && username_size > 0) {
+        strncpy(username, session.username, username_size - 1);
+        username[username_size - 1] = '\0';
+    }
+    return 1;
+}
+
+/**
+ * Validate session by session_id (does not refresh it)
+ * Returns: 1 if valid, 0 if invalid
+ */
+int validate_session(const char* session_id) {
+    if (session_token_enabled()) {
+        return session_token_verify(session_id, NULL, NULL, 0);
+    }
+
+    unsigned char key[SESSION_RANDOM_BYTES];
+    if (decode_session_id(session_id, key) != 0) {
+        return 0;
+    }
+
+    SessionStripe* stripe = stripe_of(key);
+    Session session;
+    if (!read_session(stripe, key, &session)) {
+        return 0;
+    }
+
+    if (time(NULL) - session.last_accessed > SESSION_TIMEOUT) {
+        // Removes it (and logs) unless another request refreshed it meanwhile
+        return touch_session(stripe, key, time(NULL));
+    }
+    return 1;
+}
+
+/**
+ * Refresh session (update last_accessed time)
+ * Thread-safe: locks the session's stripe
+ */
+void refresh_session(const char* session_id) {
+    if (session_token_enabled()) {
+        return;  // Tokens carry a fixed expiry
+    }
+
+    unsigned char key[SESSION_RANDOM_BYTES];
+    if (decode_session_id(session_id, key) != 0) {
+        return;
+    }
+
+    SessionStripe* stripe = stripe_of(key);
+    stripe_write_lock(stripe);
+
+    long slot = find_slot(stripe, key);
+    if (slot >= 0) {
+        slots_of(stripe)[slot].last_accessed = time(NULL);
+    }
+
+    stripe_write_unlock(stripe);
+}
+
+/**
+ * Destroy session (logout)
+ * Thread-safe: locks the session's stripe
+ */
+void destroy_session(const char* session_id) {
+    if (session_token_enabled()) {
+        session_token_revoke(session_id);
+        printf("🚪 Session token revoked\n");
+        return;
+    }
+
+    unsigned char key[SESSION_RANDOM_BYTES];
+    if (decode_session_id(session_id, key) != 0) {
+        return;
     }
 
+    SessionStripe* stripe = stripe_of(key);
+    stripe_write_lock(stripe);
+
+    long slot = find_slot(stripe, key);
+    if (slot >= 0) {
+        Session* session = &slots_of(stripe)[slot];
+        printf("🚪 Session destroyed: %s (user: %s, ID: %d)\n",
+               session_id, session->username, session->user_id);
+        remove_slot_locked(stripe, slot);
+    }
+
+    stripe_write_unlock(stripe);
+}
+
+/**
+ * Clean up expired sessions (background sweeper)
+ * Thread-safe: locks one stripe batch at a time
+ */
+void cleanup_expired_sessions() {
+    int cleaned = expire_all_sessions(time(NULL));
+
     if (cleaned > 0) {
         printf("✓ Cleaned %d expired sessions (remaining: %d)\n",
                cleaned, session_store->session_count);
     }
-
-    // Unlock semaphore
-    sem_post(session_sem);
 }
 
 /**
@@ -427,8 +1039,10 @@ void redirect_to_login(int client_fd) {
              "%s"
              "Location: /login\r\n"
              "Content-Length: 0\r\n"
+             "%s"
              "\r\n",
-             HTTP_302_FOUND);
+             HTTP_302_FOUND,
+             http_connection_header());
 
     write(client_fd, response, strlen(response));
 }
@@ -456,9 +1070,10 @@ void send_login_error(int client_fd, const char* error_message) {
              "%s"
              "Content-Type: text/html; charset=UTF-8\r\n"
              "Content-Length: %zu\r\n"
+             "%s"
              "\r\n"
              "%s",
-             HTTP_200_OK, strlen(html), html);
+             HTTP_200_OK, strlen(html), http_connection_header(), html);
 
     write(client_fd, response, strlen(response));
 }
@@ -510,7 +1125,7 @@ void handle_login(int client_fd, const char* request_body) {
     update_last_login(user_id);
 
     // Create session (thread-safe)
-    char session_id[SESSION_ID_LENGTH];
+    char session_id[SESSION_COOKIE_LENGTH];
     if (!create_session(user_id, username, session_id, sizeof(session_id))) {
         printf("❌ Login failed: cannot create session\n");
         send_login_error(client_fd, "Server error: Cannot create session");
@@ -528,9 +1143,11 @@ void handle_login(int client_fd, const char* request_body) {
              "Location: /\r\n"
              "%s"
              "Content-Length: 0\r\n"
+             "%s"
              "\r\n",
              HTTP_302_FOUND,
-             set_cookie);
+             set_cookie,
+             http_connection_header());
 
     write(client_fd, response, strlen(response));
 
@@ -542,27 +1159,8 @@ void handle_login(int client_fd, const char* request_body) {
  * Returns: user_id (>0) on success, -1 on failure
  */
 int get_user_id_from_session(const char* session_id) {
-    if (!session_id || strlen(session_id) == 0) {
-        return -1;
-    }
-
-    // Lock semaphore
-    sem_wait(session_sem);
-
     int user_id = -1;
-
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (session_store->sessions[i].is_active &&
-            strcmp(session_store->sessions[i].session_id, session_id) == 0) {
-            user_id = session_store->sessions[i].user_id;
-            break;
-        }
-    }
-
-    // Unlock semaphore
-    sem_post(session_sem);
-
-    return user_id;
+    return session_lookup(session_id, &user_id, NULL, 0) ? user_id : -1;
 }
 
 /**
@@ -570,36 +1168,17 @@ int get_user_id_from_session(const char* session_id) {
  * Returns 0 on success, -1 on failure
  */
 int get_username_from_session(const char* session_id, char* username_out, size_t username_size) {
-    if (!session_id || strlen(session_id) == 0 || !username_out || username_size == 0) {
+    if (!username_out || username_size == 0) {
         return -1;
     }
-
-    // Lock semaphore
-    sem_wait(session_sem);
-
-    int found = 0;
-
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (session_store->sessions[i].is_active &&
-            strcmp(session_store->sessions[i].session_id, session_id) == 0) {
-            strncpy(username_out, session_store->sessions[i].username, username_size - 1);
-            username_out[username_size - 1] = '\0';
-            found = 1;
-            break;
-        }
-    }
-
-    // Unlock semaphore
-    sem_post(session_sem);
-
-    return found ? 0 : -1;
+    return session_lookup(session_id, NULL, username_out, username_size) ? 0 : -1;
 }
 
 // ============================================================================
 // User Registration Functions
 // ============================================================================
-// Note: parse_json_string, validate_username, validate_password are now
-//       imported from json.h and validation.h modules
+// Note: JSON body parsing (json_index_*), validate_username, validate_password
+//       are imported from json.h and validation.h modules
 
 /**
  * Handle user registration request
@@ -611,12 +1190,18 @@ void handle_registration(int client_fd, const char* request_body) {
     printf("  [Registration] Processing registration request\n");
 
     // Parse JSON body
-    if (parse_json_string(request_body, "username", username, sizeof(username)) != 0) {
+    JSONIndex json;
+    if (json_index_parse(&json, request_body, strlen(request_body)) != 0) {
+        send_json_error(client_fd, 400, "Invalid JSON body");
+        return;
+    }
+
+    if (json_index_string(&json, "username", username, sizeof(username)) != 0) {
         send_json_error(client_fd, 400, "Invalid JSON: missing username");
         return;
     }
 
-    if (parse_json_string(request_body, "password", password, sizeof(password)) != 0) {
+    if (json_index_string(&json, "password", password, sizeof(password)) != 0) {
         send_json_error(client_fd, 400, "Invalid JSON: missing password");
         return;
     }
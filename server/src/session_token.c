@@ -0,0 +1,448 @@
+/*
+ * OTT Streaming Server - Stateless Session Tokens
+ *
+ * Token bytes before base64url (big-endian integers):
+ *
+ *   [0]       version (TOKEN_VERSION)
+ *   [1..4]    expires (unix time)
+ *   [5..8]    user_id
+ *   [9..16]   nonce (random: two logins never share a token)
+ *   [17]      username length
+ *   [18..]    username
+ *   [...+16]  HMAC-SHA256(key, all of the above), truncated
+ *
+ * The revocation filter has two generations of SESSION_TIMEOUT seconds.
+ * A revoked token expires at most SESSION_TIMEOUT after its logout, so a
+ * generation can be cleared once it is two generations old. Checks read
+ * the filter without locking; revocations (logouts) take its semaphore.
+ *
+ * The filter is a shared file mapping (SESSION_REVOKE_PATH) like the
+ * session table: the key survives a restart, so revocations must too.
+ * Generations are absolute (time / SESSION_TIMEOUT), so a reopened
+ * filter is valid as is.
+ */
+
+#include "../include/session_token.h"
+#include "../include/crypto.h"
+#include "../include/random_pool.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <openssl/crypto.h>
+
+#define TOKEN_VERSION 1
+#define FILTER_MAGIC "OTTREVK"      // File header (8 bytes with the null)
+#define FILTER_VERSION 1
+#define TOKEN_HEADER_BYTES 18
+#define TOKEN_MAX_BYTES (TOKEN_HEADER_BYTES + USERNAME_MAX_LENGTH + SESSION_TOKEN_TAG_BYTES)
+#define TOKEN_MAX_CHARS ((TOKEN_MAX_BYTES * 4 + 2) / 3)
+
+#if TOKEN_MAX_CHARS + 1 > SESSION_COOKIE_LENGTH
+#error "SESSION_COOKIE_LENGTH is too small for a session token"
+#endif
+
+#if (SESSION_REVOKE_BITS & (SESSION_REVOKE_BITS - 1)) != 0
+#error "SESSION_REVOKE_BITS must be a power of 2"
+#endif
+
+typedef struct {
+    char magic[8];                      // FILTER_MAGIC
+    uint32_t version;                   // FILTER_VERSION
+    uint32_t filter_bits;               // SESSION_REVOKE_BITS of the build that wrote it
+    sem_t lock;                         // Revokers (process-shared, re-created on start)
+    volatile long generation[2];        // time / SESSION_TIMEOUT each filter belongs to
+    unsigned char bits[2][SESSION_REVOKE_BITS / 8];
+} RevocationFilter;
+
+static HmacKey* hmac_key = NULL;
+static int enabled = 0;
+static RevocationFilter* revoked = NULL;   // Shared with prefork workers
+static int filter_fd = -1;                  // Filter file (held locked), -1 if anonymous
+
+static const char base64url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+static void put_u32(unsigned char* p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/**
+ * base64url without padding
+ */
+static void encode_base64url(const unsigned char* data, size_t length, char* out) {
+    size_t o = 0;
+    size_t i = 0;
+
+    for (; i + 3 <= length; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2];
+        out[o++] = base64url[v >> 18];
+        out[o++] = base64url[(v >> 12) & 63];
+        out[o++] = base64url[(v >> 6) & 63];
+        out[o++] = base64url[v & 63];
+    }
+    if (length - i == 1) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        out[o++] = base64url[v >> 18];
+        out[o++] = base64url[(v >> 12) & 63];
+    } else if (length - i == 2) {
+        uint32_t v = (uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8;
+        out[o++] = base64url[v >> 18];
+        out[o++] = base64url[(v >> 12) & 63];
+        out[o++] = base64url[(v >> 6) & 63];
+    }
+    out[o] = '\0';
+}
+
+static int base64url_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+/**
+ * Decode base64url without padding
+ * Returns: decoded length, or -1 if malformed or longer than size
+ */
+static int decode_base64url(const char* text, unsigned char* out, size_t size) {
+    size_t length = strlen(text);
+    if (length % 4 == 1 || length * 3 / 4 > size) {
+        return -1;
+    }
+
+    size_t o = 0;
+    uint32_t bits = 0;
+    int bit_count = 0;
+    for (size_t i = 0; i < length; i++) {
+        int value = base64url_value(text[i]);
+        if (value < 0) {
+            return -1;
+        }
+        bits = bits << 6 | value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            out[o++] = (unsigned char)(bits >> bit_count);
+        }
+    }
+    return (int)o;
+}
+
+// ============================================================================
+// Revocation Filter
+// ============================================================================
+
+/**
+ * Filter bits of a token: the tag is an HMAC, so its words already are
+ * independent uniform hashes
+ */
+static uint32_t filter_bit(const unsigned char* tag, int k) {
+    return get_u32(tag + 4 * k) & (SESSION_REVOKE_BITS - 1);
+}
+
+static int filter_has(int f, const unsigned char* tag) {
+    for (int k = 0; k < SESSION_TOKEN_TAG_BYTES / 4; k++) {
+        uint32_t bit = filter_bit(tag, k);
+        if (!(revoked->bits[f][bit / 8] & (1u << (bit % 8)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int is_revoked(const unsigned char* tag, time_t now) {
+    long generation = now / SESSION_TIMEOUT;
+
+    for (int f = 0; f < 2; f++) {
+        long held = revoked->generation[f];
+        if ((held == generation || held == generation - 1) && filter_has(f, tag)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Map the revocation filter, reusing the revocations kept in path
+ * @param path Filter file, or NULL for an anonymous mapping
+ * Returns: 0 on success, -1 on failure
+ */
+static int map_filter(const char* path) {
+    size_t size = sizeof(RevocationFilter);
+
+    if (!path) {
+        void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            perror("mmap (revocation filter) failed");
+            return -1;
+        }
+        revoked = mapping;
+    } else {
+        int fd = open(path, O_RDWR | O_CREAT, 0600);
+        if (fd < 0) {
+            perror("Cannot open revocation filter file");
+            return -1;
+        }
+
+        // Two servers on one file would clear each other's generations
+        struct stat st;
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            fprintf(stderr, "❌ Revocation filter %s is in use by another server\n", path);
+            close(fd);
+            return -1;
+        }
+        if (fstat(fd, &st) != 0 || ((size_t)st.st_size != size && ftruncate(fd, size) != 0)) {
+            perror("Cannot size revocation filter file");
+            close(fd);
+            return -1;
+        }
+
+        void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            perror("mmap (revocation filter) failed");
+            close(fd);
+            return -1;
+        }
+        revoked = mapping;
+        filter_fd = fd;
+
+        if (memcmp(revoked->magic, FILTER_MAGIC, sizeof(revoked->magic)) == 0 &&
+            revoked->version == FILTER_VERSION && revoked->filter_bits == SESSION_REVOKE_BITS &&
+            (size_t)st.st_size == size) {
+            printf("  - Revocations: %s (restored)\n", path);
+        } else {
+            if (st.st_size > 0) {
+                printf("⚠️  Revocation filter %s has another format, starting empty\n", path);
+            }
+            memset(revoked, 0, size);
+            printf("  - Revocations: %s\n", path);
+        }
+    }
+
+    memcpy(revoked->magic, FILTER_MAGIC, sizeof(revoked->magic));
+    revoked->version = FILTER_VERSION;
+    revoked->filter_bits = SESSION_REVOKE_BITS;
+    return 0;
+}
+
+static void unmap_filter(void) {
+    munmap(revoked, sizeof(RevocationFilter));
+    revoked = NULL;
+    if (filter_fd >= 0) {
+        close(filter_fd);
+        filter_fd = -1;
+    }
+}
+
+// ============================================================================
+// Key
+// ============================================================================
+
+/**
+ * Read the key file, or create it with fresh random bytes
+ * @param signing_key Set to SESSION_KEY_BYTES key bytes
+ * Returns: 0 on success, -1 on failure
+ */
+static int load_key(const char* key_path, unsigned char* signing_key) {
+    int fd = open(key_path, O_RDONLY);
+    if (fd >= 0) {
+        ssize_t length = read(fd, signing_key, SESSION_KEY_BYTES);
+        close(fd);
+        if (length != (ssize_t)SESSION_KEY_BYTES) {
+            fprintf(stderr, "❌ Session key %s is not %d bytes\n", key_path, SESSION_KEY_BYTES);
+            return -1;
+        }
+        printf("  - Signing key: %s\n", key_path);
+        return 0;
+    }
+
+    if (random_bytes(signing_key, SESSION_KEY_BYTES) != 0) {
+        fprintf(stderr, "❌ Cannot generate session key\n");
+        return -1;
+    }
+
+    fd = open(key_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 || write(fd, signing_key, SESSION_KEY_BYTES) != (ssize_t)SESSION_KEY_BYTES) {
+        perror("Cannot write session key");
+        if (fd >= 0) {
+            close(fd);
+            unlink(key_path);
+        }
+        return -1;
+    }
+    close(fd);
+
+    printf("  - Signing key: %s (new)\n", key_path);
+    return 0;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int session_token_init(const char* key_path, const char* filter_path) {
+    unsigned char signing_key[SESSION_KEY_BYTES];
+    if (load_key(key_path, signing_key) != 0) {
+        return -1;
+    }
+
+    hmac_key = hmac_sha256_key_create(signing_key, SESSION_KEY_BYTES);
+    OPENSSL_cleanse(signing_key, SESSION_KEY_BYTES);
+    if (!hmac_key) {
+        fprintf(stderr, "❌ Cannot prepare session key\n");
+        return -1;
+    }
+
+    if (map_filter(filter_path) != 0) {
+        hmac_sha256_key_free(hmac_key);
+        hmac_key = NULL;
+        return -1;
+    }
+
+    if (sem_init(&revoked->lock, 1, 1) != 0) {
+        perror("sem_init failed");
+        unmap_filter();
+        hmac_sha256_key_free(hmac_key);
+        hmac_key = NULL;
+        return -1;
+    }
+
+    enabled = 1;
+    printf("✓ Stateless session tokens enabled (HMAC-SHA256, %d KB revocation filter)\n",
+           (int)(sizeof(revoked->bits) / 1024));
+    return 0;
+}
+
+void session_token_cleanup(void) {
+    if (revoked) {
+        sem_destroy(&revoked->lock);
+        unmap_filter();
+    }
+    hmac_sha256_key_free(hmac_key);
+    hmac_key = NULL;
+    enabled = 0;
+}
+
+int session_token_enabled(void) {
+    return enabled;
+}
+
+int session_token_issue(int user_id, const char* username, char* out, size_t out_size) {
+    size_t name_length = strlen(username);
+    if (name_length > USERNAME_MAX_LENGTH || out_size < TOKEN_MAX_CHARS + 1) {
+        return -1;
+    }
+
+    unsigned char token[TOKEN_MAX_BYTES];
+    token[0] = TOKEN_VERSION;
+    put_u32(token + 1, (uint32_t)(time(NULL) + SESSION_TIMEOUT));
+    put_u32(token + 5, (uint32_t)user_id);
+    if (random_bytes(token + 9, 8) != 0) {
+        return -1;
+    }
+    token[17] = (unsigned char)name_length;
+    memcpy(token + TOKEN_HEADER_BYTES, username, name_length);
+
+    size_t payload = TOKEN_HEADER_BYTES + name_length;
+    unsigned char mac[HMAC_SHA256_LENGTH];
+    if (hmac_sha256(hmac_key, token, payload, mac) != 0) {
+        return -1;
+    }
+    memcpy(token + payload, mac, SESSION_TOKEN_TAG_BYTES);
+
+    encode_base64url(token, payload + SESSION_TOKEN_TAG_BYTES, out);
+    return 0;
+}
+
+/**
+ * Decode a token and check its signature
+ * Returns: payload length (the tag follows it), or -1 if invalid
+ */
+static int open_token(const char* text, unsigned char* token) {
+    int length = decode_base64url(text, token, TOKEN_MAX_BYTES);
+    if (length < TOKEN_HEADER_BYTES + SESSION_TOKEN_TAG_BYTES || token[0] != TOKEN_VERSION) {
+        return -1;
+    }
+
+    int payload = length - SESSION_TOKEN_TAG_BYTES;
+    if (token[17] != payload - TOKEN_HEADER_BYTES) {
+        return -1;
+    }
+
+    if (!hmac_sha256_verify(hmac_key, token, payload, token + payload, SESSION_TOKEN_TAG_BYTES)) {
+        return -1;
+    }
+    return payload;
+}
+
+int session_token_verify(const char* text, int* user_id, char* username, size_t username_size) {
+    unsigned char token[TOKEN_MAX_BYTES];
+    int payload = open_token(text, token);
+    if (payload < 0) {
+        return 0;
+    }
+
+    time_t now = time(NULL);
+    if ((time_t)get_u32(token + 1) < now || is_revoked(token + payload, now)) {
+        return 0;
+    }
+
+    if (user_id) {
+        *user_id = (int)get_u32(token + 5);
+    }
+    if (username && username_size > 0) {
+        size_t length = token[17] < username_size - 1 ? token[17] : username_size - 1;
+        memcpy(username, token + TOKEN_HEADER_BYTES, length);
+        username[length] = '\0';
+    }
+    return 1;
+}
+
+void session_token_revoke(const char* text) {
+    unsigned char token[TOKEN_MAX_BYTES];
+    int payload = open_token(text, token);
+    if (payload < 0) {
+        return;
+    }
+
+    const unsigned char* tag = token + payload;
+    long generation = time(NULL) / SESSION_TIMEOUT;
+    int f = generation & 1;
+
+    sem_wait(&revoked->lock);
+
+    // Reuse the generation before last: every token revoked then has expired
+    if (revoked->generation[f] != generation) {
+        memset(revoked->bits[f], 0, sizeof(revoked->bits[f]));
+        __sync_synchronize();
+        revoked->generation[f] = generation;
+    }
+
+    for (int k = 0; k < SESSION_TOKEN_TAG_BYTES / 4; k++) {
+        uint32_t bit = filter_bit(tag, k);
+        revoked->bits[f][bit / 8] |= 1u << (bit % 8);
+    }
+
+    sem_post(&revoked->lock);
+}
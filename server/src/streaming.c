@@ -2,16 +2,119 @@
  * Video Streaming Module with Range Request Support
  *
  * Implements HTTP Range Requests (RFC 7233) for video streaming
+ *
+ * Regular files are sent with sendfile(): the kernel copies page cache
+ * pages straight to the socket, with no user-space buffer. Filesystems
+ * without sendfile support fall back to pread()/send().
+ *
+ * stream_file() does not send a regular file itself: it builds a
+ * FileTransfer (response header, then file ranges and multipart framing)
+ * that the event loop sends on the non-blocking socket as it becomes
+ * writable, so a slow viewer never holds a worker thread. Anything else
+ * (pipes, devices) is sent by the worker with a buffered read()/send() loop.
+ *
+ * Files come from the shared open-file cache, so the descriptor may be in
+ * use by other threads: only positional reads (sendfile offset, pread).
+ *
+ * Responses carry a strong ETag (inode, size, mtime) and Last-Modified.
+ * Conditional GETs are answered from stat() alone: a 304 never opens
+ * the file or touches the cache.
+ *
+ * Text assets are sent from their precompressed .br/.gz sibling when the
+ * client accepts it (compression.h); the sibling has its own inode, so
+ * each encoding gets its own strong ETag.
  */
 
 #include "../include/server.h"
+#include "../include/file_cache.h"
+#include "../include/compression.h"
+#include <errno.h>
+#include <sys/sendfile.h>
+
+// Response header, each part's header and body, closing delimiter
+#define TRANSFER_MAX_SEGMENTS (2 * MAX_RANGE_SPECS + 2)
+
+typedef struct {
+    long offset;                // Into text, or file offset
+    long length;
+    int from_file;
+} TransferSegment;
+
+struct FileTransfer {
+    FileCacheEntry* file;       // Reference held until the transfer is freed
+    char* text;                 // Header and multipart framing
+    size_t text_length;
+    size_t text_capacity;
+    TransferSegment segments[TRANSFER_MAX_SEGMENTS];
+    int segment_count;
+    int current;                // Segment being sent
+    long done;                  // Bytes of the current segment sent
+    long total_sent;
+    int buffered;               // sendfile() unsupported: pread() + send()
+};
+
+// Transfer built by the last stream_file() of this thread (file body pending)
+static __thread FileTransfer* pending_transfer = NULL;
+
+/**
+ * Parse one range spec ("a-b", "a-" or "-n") into spec
+ * Returns: 1 on success, 0 if the spec is syntactically invalid
+ */
+static int parse_range_spec(const char* str, size_t len, ByteRange* spec) {
+    char text[64];
+
+    // Trim optional whitespace around the spec
+    while (len > 0 && (*str == ' ' || *str == '\t')) {
+        str++;
+        len--;
+    }
+    while (len > 0 && (str[len - 1] == ' ' || str[len - 1] == '\t')) {
+        len--;
+    }
+
+    if (len == 0 || len >= sizeof(text)) {
+        return 0;
+    }
+    memcpy(text, str, len);
+    text[len] = '\0';
+
+    char* dash = strchr(text, '-');
+    if (!dash) {
+        return 0;
+    }
+
+    char* endptr;
+    if (dash == text) {
+        // Format: "-500" (last 500 bytes)
+        spec->start = -1;
+        spec->end = strtol(dash + 1, &endptr, 10);
+        return dash[1] != '\0' && *endptr == '\0' && spec->end >= 0;
+    }
+
+    spec->start = strtol(text, &endptr, 10);
+    if (endptr != dash || spec->start < 0) {
+        return 0;
+    }
+
+    if (dash[1] == '\0') {
+        spec->end = -1;  // "to end of file"
+        return 1;
+    }
+
+    spec->end = strtol(dash + 1, &endptr, 10);
+    return *endptr == '\0' && spec->end >= spec->start;
+}
 
 /**
  * Parse Range header
  * Example: "bytes=0-1023" or "bytes=1000-" or "bytes=-500"
+ *          or several specs: "bytes=0-499,1000-1499,-200"
+ *
+ * An invalid or oversized header is ignored (has_range = 0), as RFC 7233
+ * allows: the client then gets the full 200 response.
  */
 Range parse_range(const char* range_header) {
-    Range range = {0, -1, 0};
+    Range range = {0};
 
     if (!range_header) {
         return range;
@@ -22,27 +125,26 @@ Range parse_range(const char* range_header) {
         return range;
     }
 
-    range.has_range = 1;
-    const char* range_str = range_header + 6;  // Skip "bytes="
-
-    // Parse "start-end" format
-    char* dash = strchr(range_str, '-');
-    if (dash) {
-        if (dash == range_str) {
-            // Format: "-500" (last 500 bytes)
-            range.start = -1;
-            range.end = atol(dash + 1);
-        } else {
-            range.start = atol(range_str);
+    const char* spec = range_header + 6;  // Skip "bytes="
 
-            // Check if end is specified
-            if (*(dash + 1) != '\0') {
-                range.end = atol(dash + 1);
-            }
-            // else: range.end = -1 means "to end of file"
+    while (1) {
+        const char* comma = strchr(spec, ',');
+        size_t len = comma ? (size_t)(comma - spec) : strlen(spec);
+
+        if (range.count == MAX_RANGE_SPECS ||
+            !parse_range_spec(spec, len, &range.specs[range.count])) {
+            range.count = 0;
+            return range;
         }
+        range.count++;
+
+        if (!comma) {
+            break;
+        }
+        spec = comma + 1;
     }
 
+    range.has_range = 1;
     return range;
 }
 
@@ -58,98 +160,520 @@ long get_file_size(const char* filename) {
 }
 
 /**
- * Stream file with Range Request support
+ * Strong entity tag for one version of a file: "<inode>-<size>-<mtime>"
+ * A replaced file (new inode) or an in-place rewrite changes the tag.
+ */
+static void format_file_etag(char* out, size_t size, ino_t ino, long file_size, time_t mtime) {
+    snprintf(out, size, "\"%lx-%lx-%lx\"",
+             (unsigned long)ino, (unsigned long)file_size, (unsigned long)mtime);
+}
+
+/**
+ * Answer a conditional GET with 304 if the client's copy is current
+ * Returns: 1 if 304 was sent, 0 if the full response should follow
+ */
+static int try_not_modified(int client_fd, const char* filename, const Conditional* cond, int vary) {
+    if (!cond->if_none_match[0] && cond->if_modified_since == 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;  // The normal path reports the error
+    }
+
+    char etag[MAX_ETAG_LEN];
+    format_file_etag(etag, sizeof(etag), st.st_ino, st.st_size, st.st_mtime);
+    if (!http_not_modified(cond, etag, st.st_mtime)) {
+        return 0;
+    }
+
+    send_304(client_fd, etag, st.st_mtime, vary);
+    return 1;
+}
+
+/**
+ * Send [start, start + length) of fd through a user-space buffer
  *
- * This is the core function that implements video streaming with seeking
+ * @param shared fd may be used concurrently (regular cached file): use pread()
+ * @return Number of bytes sent
  */
-void stream_file(int client_fd, const char* filename, Range range) {
-    // Open file
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        printf("  ✗ File not found: %s\n", filename);
-        send_404(client_fd);
+static long send_file_buffered(int client_fd, int fd, long start, long length, int shared) {
+    if (!shared && start > 0 && lseek(fd, start, SEEK_SET) < 0) {
+        perror("lseek failed");
+        return 0;
+    }
+
+    char buffer[FILE_READ_BUFFER_SIZE];
+    long bytes_sent = 0;
+
+    while (bytes_sent < length) {
+        size_t bytes_to_read = (length - bytes_sent < FILE_READ_BUFFER_SIZE)
+                               ? (size_t)(length - bytes_sent)
+                               : FILE_READ_BUFFER_SIZE;
+
+        ssize_t bytes_read = shared ? pread(fd, buffer, bytes_to_read, start + bytes_sent)
+                                    : read(fd, buffer, bytes_to_read);
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("File read error");
+            return bytes_sent;
+        }
+        if (bytes_read == 0) {
+            printf("  End of file reached\n");
+            return bytes_sent;
+        }
+
+        // send() may accept only part of the chunk
+        ssize_t offset = 0;
+        while (offset < bytes_read) {
+            ssize_t sent = send(client_fd, buffer + offset, bytes_read - offset, 0);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                if (sent < 0) perror("Send failed");
+                return bytes_sent + offset;
+            }
+            offset += sent;
+        }
+
+        bytes_sent += bytes_read;
+    }
+
+    return bytes_sent;
+}
+
+// ============================================================================
+// File Transfers
+// ============================================================================
+
+static FileTransfer* transfer_create(FileCacheEntry* file, size_t text_capacity) {
+    FileTransfer* transfer = calloc(1, sizeof(FileTransfer));
+    if (!transfer) {
+        return NULL;
+    }
+
+    transfer->text = malloc(text_capacity);
+    if (!transfer->text) {
+        free(transfer);
+        return NULL;
+    }
+    transfer->text_capacity = text_capacity;
+    transfer->file = file;
+    return transfer;
+}
+
+static void transfer_add_text(FileTransfer* transfer, const char* text, size_t length) {
+    if (length > transfer->text_capacity - transfer->text_length) {
+        length = transfer->text_capacity - transfer->text_length;  // Sized by the caller
+    }
+    memcpy(transfer->text + transfer->text_length, text, length);
+
+    TransferSegment* segment = &transfer->segments[transfer->segment_count++];
+    segment->offset = (long)transfer->text_length;
+    segment->length = (long)length;
+    segment->from_file = 0;
+    transfer->text_length += length;
+}
+
+static void transfer_add_file(FileTransfer* transfer, long start, long length) {
+    TransferSegment* segment = &transfer->segments[transfer->segment_count++];
+    segment->offset = start;
+    segment->length = length;
+    segment->from_file = 1;
+}
+
+/**
+ * Release the file and free the transfer (NULL is ignored)
+ */
+void file_transfer_free(FileTransfer* transfer) {
+    if (!transfer) {
         return;
     }
+    file_cache_release(transfer->file);
+    free(transfer->text);
+    free(transfer);
+}
 
-    // Get file size
-    long file_size = get_file_size(filename);
-    if (file_size < 0) {
-        printf("  ✗ Cannot get file size\n");
-        fclose(file);
-        send_404(client_fd);
+/**
+ * Take the transfer left by this thread's last stream_file()
+ * Returns: transfer for the caller to send and free, or NULL
+ */
+FileTransfer* stream_take_transfer(void) {
+    FileTransfer* transfer = pending_transfer;
+    pending_transfer = NULL;
+    return transfer;
+}
+
+/**
+ * Send part of a file segment without blocking
+ * Returns: bytes sent, 0 if the socket is full, -1 on error
+ */
+static ssize_t transfer_send_file(FileTransfer* transfer, int client_fd, long offset, size_t length) {
+    if (!transfer->buffered) {
+        off_t position = offset;
+        ssize_t sent = sendfile(client_fd, transfer->file->fd, &position, length);
+        if (sent > 0) {
+            return sent;
+        }
+        if (sent == 0) {
+            printf("  End of file reached\n");  // File truncated while sending
+            return -1;
+        }
+        if (errno == EAGAIN || errno == EINTR) {
+            return 0;
+        }
+        if (errno != EINVAL && errno != ENOSYS) {
+            perror("sendfile failed");
+            return -1;
+        }
+        transfer->buffered = 1;
+    }
+
+    // Positional reads: only the bytes the socket took count as sent
+    char buffer[FILE_READ_BUFFER_SIZE];
+    if (length > sizeof(buffer)) {
+        length = sizeof(buffer);
+    }
+    ssize_t bytes_read = pread(transfer->file->fd, buffer, length, offset);
+    if (bytes_read <= 0) {
+        if (bytes_read < 0 && errno == EINTR) {
+            return 0;
+        }
+        perror("File read error");
+        return -1;
+    }
+
+    ssize_t sent = send(client_fd, buffer, bytes_read, MSG_DONTWAIT);
+    if (sent < 0) {
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    }
+    return sent;
+}
+
+/**
+ * Send as much of the transfer as the non-blocking socket takes, up to
+ * SENDFILE_CHUNK_SIZE bytes per call so one fast client cannot hold the loop
+ * Returns: 1 when complete, 0 to wait for EPOLLOUT, -1 on error (close)
+ */
+int file_transfer_send(FileTransfer* transfer, int client_fd) {
+    long budget = SENDFILE_CHUNK_SIZE;
+
+    while (transfer->current < transfer->segment_count) {
+        const TransferSegment* segment = &transfer->segments[transfer->current];
+        long remaining = segment->length - transfer->done;
+
+        if (remaining > 0 && budget <= 0) {
+            return 0;  // Let the loop serve other connections; EPOLLOUT fires again
+        }
+
+        ssize_t sent = 0;
+        if (remaining > 0 && segment->from_file) {
+            size_t chunk = remaining < budget ? (size_t)remaining : (size_t)budget;
+            sent = transfer_send_file(transfer, client_fd, segment->offset + transfer->done, chunk);
+        } else if (remaining > 0) {
+            int more = transfer->current + 1 < transfer->segment_count ? MSG_MORE : 0;
+            sent = send(client_fd, transfer->text + segment->offset + transfer->done, remaining,
+                        MSG_DONTWAIT | more);
+            if (sent < 0) {
+                sent = (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+            }
+        }
+
+        if (sent < 0) {
+            printf("  ✗ Transfer aborted after %ld bytes\n", transfer->total_sent);
+            return -1;
+        }
+        if (remaining > 0 && sent == 0) {
+            return 0;
+        }
+
+        transfer->done += sent;
+        transfer->total_sent += sent;
+        budget -= sent;
+        if (transfer->done == segment->length) {
+            transfer->current++;
+            transfer->done = 0;
+        }
+    }
+
+    printf("  ✓ Sent %ld bytes\n", transfer->total_sent);
+    return 1;
+}
+
+/**
+ * Send a transfer of a non-regular file from the worker (blocking socket)
+ * Clears keep-alive if the body was cut short.
+ */
+static void transfer_send_inline(FileTransfer* transfer, int client_fd) {
+    for (int i = 0; i < transfer->segment_count; i++) {
+        const TransferSegment* segment = &transfer->segments[i];
+        long sent;
+
+        if (segment->from_file) {
+            sent = send_file_buffered(client_fd, transfer->file->fd, segment->offset, segment->length, 0);
+        } else {
+            int more = i + 1 < transfer->segment_count ? MSG_MORE : 0;
+            sent = send(client_fd, transfer->text + segment->offset, segment->length, more);
+        }
+
+        if (sent != segment->length) {
+            // Body cut short: the response is unframed, the connection must close
+            http_set_keep_alive(0);
+            printf("  ✗ Transfer aborted after %ld bytes\n", transfer->total_sent);
+            return;
+        }
+        transfer->total_sent += sent;
+    }
+
+    printf("  ✓ Sent %ld bytes\n", transfer->total_sent);
+}
+
+/**
+ * Send the transfer: leave regular files to the event loop, send anything
+ * else now. Takes ownership of transfer.
+ */
+static void start_transfer(FileTransfer* transfer, int client_fd) {
+    if (S_ISREG(transfer->file->mode)) {
+        file_transfer_free(pending_transfer);
+        pending_transfer = transfer;
         return;
     }
 
-    // Determine range to send
-    long start = 0, end = file_size - 1;
+    transfer_send_inline(transfer, client_fd);
+    file_transfer_free(transfer);
+}
 
-    if (range.has_range) {
-        // Handle "last N bytes" format
-        if (range.start == -1) {
-            start = file_size - range.end;
-            if (start < 0) start = 0;
+/**
+ * Resolve range specs against the file size: drop unsatisfiable specs,
+ * sort, and coalesce overlapping or adjacent ranges
+ *
+ * @param out Resolved ranges (absolute, inclusive end)
+ * @return Number of ranges in out (0 = not satisfiable)
+ */
+static int resolve_ranges(const Range* range, long file_size, ByteRange* out) {
+    int count = 0;
+
+    for (int i = 0; i < range->count; i++) {
+        const ByteRange* spec = &range->specs[i];
+        long start, end;
+
+        if (spec->start == -1) {
+            // Handle "last N bytes" format
+            if (spec->end == 0 || file_size == 0) {
+                continue;
+            }
+            start = (spec->end < file_size) ? file_size - spec->end : 0;
             end = file_size - 1;
         } else {
-            start = range.start;
-            end = (range.end == -1) ? file_size - 1 : range.end;
-
-            // Validate range
-            if (start < 0 || start >= file_size) {
-                printf("  ✗ Invalid range: start=%ld, file_size=%ld\n", start, file_size);
-
-                // Send 416 Range Not Satisfiable
-                char response[256];
-                snprintf(response, sizeof(response),
-                    "HTTP/1.1 416 Range Not Satisfiable\r\n"
-                    "Content-Range: bytes */%ld\r\n"
-                    "Connection: close\r\n"
-                    "\r\n",
-                    file_size);
-                send(client_fd, response, strlen(response), 0);
-
-                fclose(file);
-                return;
+            if (spec->start >= file_size) {
+                continue;
             }
+            start = spec->start;
+            end = (spec->end == -1 || spec->end >= file_size) ? file_size - 1 : spec->end;
+        }
 
-            // Adjust end if beyond file size
-            if (end >= file_size) {
-                end = file_size - 1;
-            }
+        // Insertion sort by start (at most MAX_RANGE_SPECS entries)
+        int pos = count++;
+        while (pos > 0 && out[pos - 1].start > start) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos].start = start;
+        out[pos].end = end;
+    }
 
-            // Check if end < start
-            if (end < start) {
-                printf("  ✗ Invalid range: end < start\n");
-
-                char response[256];
-                snprintf(response, sizeof(response),
-                    "HTTP/1.1 416 Range Not Satisfiable\r\n"
-                    "Content-Range: bytes */%ld\r\n"
-                    "Connection: close\r\n"
-                    "\r\n",
-                    file_size);
-                send(client_fd, response, strlen(response), 0);
-
-                fclose(file);
-                return;
+    // Coalesce: merge a range into the previous one if they overlap or touch
+    int merged = 0;
+    for (int i = 0; i < count; i++) {
+        if (merged > 0 && out[i].start <= out[merged - 1].end + 1) {
+            if (out[i].end > out[merged - 1].end) {
+                out[merged - 1].end = out[i].end;
             }
+        } else {
+            out[merged++] = out[i];
         }
     }
 
-    long content_length = end - start + 1;
+    return merged;
+}
+
+/**
+ * Send 416 Range Not Satisfiable
+ */
+static void send_416(int client_fd, long file_size) {
+    char response[256];
+    snprintf(response, sizeof(response),
+        "HTTP/1.1 416 Range Not Satisfiable\r\n"
+        "Content-Range: bytes */%ld\r\n"
+        "Content-Length: 0\r\n"
+        "%s"
+        "\r\n",
+        file_size, http_connection_header());
+    send(client_fd, response, strlen(response), 0);
+}
+
+/**
+ * Build the part header that precedes each range in a multipart body
+ * Returns: header length
+ */
+static int format_part_header(char* buf, size_t size, const char* boundary,
+                              const char* mime_type, const ByteRange* part, long file_size) {
+    return snprintf(buf, size,
+        "\r\n--%s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Range: bytes %ld-%ld/%ld\r\n"
+        "\r\n",
+        boundary, mime_type, part->start, part->end, file_size);
+}
+
+/**
+ * Send a multipart/byteranges response (RFC 7233 section 4.1)
+ * Part headers go into the transfer's text; part bodies are file segments.
+ * Takes ownership of file.
+ */
+static void stream_multipart(int client_fd, FileCacheEntry* file, const char* mime_type,
+                             const char* extra_headers, const ByteRange* parts, int count) {
+    static unsigned long boundary_counter = 0;
+    char boundary[40];
+    char part_header[256];
+
+    // Boundary only has to be unlikely inside the file data
+    snprintf(boundary, sizeof(boundary), "OTT_BYTERANGES_%08lx%08lx",
+             (unsigned long)time(NULL), __sync_fetch_and_add(&boundary_counter, 1));
+
+    // Content-Length: every part header + data, plus the closing delimiter
+    long content_length = 0;
+    for (int i = 0; i < count; i++) {
+        content_length += format_part_header(part_header, sizeof(part_header), boundary,
+                                             mime_type, &parts[i], file->size);
+        content_length += parts[i].end - parts[i].start + 1;
+    }
+    content_length += (long)strlen(boundary) + 8;  // "\r\n--" boundary "--\r\n"
+
+    FileTransfer* transfer = transfer_create(file, sizeof(part_header) * (count + 3));
+    if (!transfer) {
+        file_cache_release(file);
+        send_503(client_fd);
+        return;
+    }
+
+    char header[512];
+    int len = snprintf(header, sizeof(header),
+        "HTTP/1.1 206 Partial Content\r\n"
+        "Content-Type: multipart/byteranges; boundary=%s\r\n"
+        "Content-Length: %ld\r\n"
+        "Accept-Ranges: bytes\r\n"
+        "%s"
+        "%s"
+        "\r\n",
+        boundary, content_length, extra_headers, http_connection_header());
+    transfer_add_text(transfer, header, len);
+    printf("  → 206 Partial Content: %d ranges (multipart, %ld bytes)\n", count, content_length);
+
+    for (int i = 0; i < count; i++) {
+        len = format_part_header(part_header, sizeof(part_header), boundary,
+                                 mime_type, &parts[i], file->size);
+        transfer_add_text(transfer, part_header, len);
+        transfer_add_file(transfer, parts[i].start, parts[i].end - parts[i].start + 1);
+    }
+
+    char trailer[64];
+    len = snprintf(trailer, sizeof(trailer), "\r\n--%s--\r\n", boundary);
+    transfer_add_text(transfer, trailer, len);
+
+    start_transfer(transfer, client_fd);
+}
+
+/**
+ * Stream file with Range Request support
+ *
+ * This is the core function that implements video streaming with seeking
+ */
+void stream_file(int client_fd, const char* filename, const HTTPRequest* req) {
+    // Precompressed sibling (not for ranges: their offsets refer to the original)
+    char variant[MAX_PATH];
+    ContentEncoding encoding = ENCODING_IDENTITY;
+    if (!req->range.has_range) {
+        encoding = find_static_variant(filename, req->accept_encoding, variant, sizeof(variant));
+    }
+    const char* path = (encoding != ENCODING_IDENTITY) ? variant : filename;
+
+    int vary = encoding != ENCODING_IDENTITY || is_compressible_file(filename);
+    if (try_not_modified(client_fd, path, &req->conditional, vary)) {
+        return;
+    }
+
+    // Open file (cached fd + size: no path lookup for hot files)
+    FileCacheEntry* file = file_cache_acquire(path);
+    if (!file) {
+        printf("  ✗ File not found: %s\n", filename);
+        send_404(client_fd);
+        return;
+    }
+
+    long file_size = file->size;
     const char* mime_type = get_mime_type(filename);
+    const Range* range = &req->range;
+
+    // Validators of the open file (the bytes actually sent)
+    char etag[MAX_ETAG_LEN];
+    char extra_headers[MAX_ETAG_LEN + HTTP_DATE_LEN + 96];
+    format_file_etag(etag, sizeof(etag), file->ino, file->size, file->mtime);
+    int extra_len = http_format_validators(extra_headers, sizeof(extra_headers), etag, file->mtime);
+
+    if (encoding != ENCODING_IDENTITY) {
+        snprintf(extra_headers + extra_len, sizeof(extra_headers) - extra_len,
+                 "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n", encoding_name(encoding));
+    } else if (vary) {
+        snprintf(extra_headers + extra_len, sizeof(extra_headers) - extra_len,
+                 "Vary: Accept-Encoding\r\n");
+    }
+
+    // Determine range(s) to send
+    ByteRange parts[MAX_RANGE_SPECS];
+    int part_count = 0;
+
+    if (range->has_range) {
+        part_count = resolve_ranges(range, file_size, parts);
+
+        if (part_count == 0) {
+            printf("  ✗ Invalid range: no satisfiable range, file_size=%ld\n", file_size);
+            send_416(client_fd, file_size);
+            file_cache_release(file);
+            return;
+        }
+
+        if (part_count > 1) {
+            stream_multipart(client_fd, file, mime_type, extra_headers, parts, part_count);
+            return;
+        }
+    }
+
+    long start = 0, end = file_size - 1;
+    if (part_count == 1) {
+        start = parts[0].start;
+        end = parts[0].end;
+    }
+
+    long content_length = end - start + 1;
 
     // Build HTTP response header
     char header[512];
-    if (range.has_range) {
+    if (range->has_range) {
         snprintf(header, sizeof(header),
             "HTTP/1.1 206 Partial Content\r\n"
             "Content-Type: %s\r\n"
             "Content-Length: %ld\r\n"
             "Content-Range: bytes %ld-%ld/%ld\r\n"
             "Accept-Ranges: bytes\r\n"
-            "Connection: close\r\n"
+            "%s"
+            "%s"
             "\r\n",
-            mime_type, content_length, start, end, file_size);
+            mime_type, content_length, start, end, file_size, extra_headers, http_connection_header());
         printf("  → 206 Partial Content: bytes %ld-%ld/%ld (%ld bytes)\n",
                start, end, file_size, content_length);
     } else {
@@ -158,57 +682,23 @@ void stream_file(int client_fd, const char* filename, Range range) {
             "Content-Type: %s\r\n"
             "Content-Length: %ld\r\n"
             "Accept-Ranges: bytes\r\n"
-            "Connection: close\r\n"
+            "%s"
+            "%s"
             "\r\n",
-            mime_type, content_length);
+            mime_type, content_length, extra_headers, http_connection_header());
         printf("  → 200 OK: %ld bytes\n", content_length);
     }
 
-    // Send response header
-    if (send(client_fd, header, strlen(header), 0) < 0) {
-        perror("Send header failed");
-        fclose(file);
-        return;
-    }
-
-    // Seek to start position
-    if (fseek(file, start, SEEK_SET) != 0) {
-        perror("fseek failed");
-        fclose(file);
+    // Header and body go out together from the event loop
+    FileTransfer* transfer = transfer_create(file, strlen(header));
+    if (!transfer) {
+        file_cache_release(file);
+        send_503(client_fd);
         return;
     }
-
-    // Send file content in chunks
-    char buffer[BUFFER_SIZE];
-    long bytes_sent = 0;
-
-    while (bytes_sent < content_length) {
-        size_t bytes_to_send = (content_length - bytes_sent < BUFFER_SIZE)
-                               ? (content_length - bytes_sent)
-                               : BUFFER_SIZE;
-
-        size_t bytes_read = fread(buffer, 1, bytes_to_send, file);
-        if (bytes_read == 0) {
-            if (feof(file)) {
-                printf("  End of file reached\n");
-                break;
-            }
-            if (ferror(file)) {
-                perror("File read error");
-                break;
-            }
-        }
-
-        ssize_t sent = send(client_fd, buffer, bytes_read, 0);
-        if (sent <= 0) {
-            if (sent < 0) perror("Send failed");
-            break;
-        }
-
-        bytes_sent += sent;
+    transfer_add_text(transfer, header, strlen(header));
+    if (content_length > 0) {
+        transfer_add_file(transfer, start, content_length);
     }
-
-    printf("  ✓ Sent %ld bytes\n", bytes_sent);
-
-    fclose(file);
+    start_transfer(transfer, client_fd);
 }
@@ -0,0 +1,383 @@
+/*
+ * OTT Streaming Server - Title Autocomplete Trie
+ *
+ * Built from the titles sorted bytewise: every node covers a contiguous
+ * range of them, its label runs to the longest prefix the range shares,
+ * and its children split the rest of the range by the next byte. Titles
+ * that end at a node sort first in its range.
+ *
+ * Node ranked lists are merged bottom-up (the node's own titles plus the
+ * children's lists), so each holds at most SUGGEST_MAX_RESULTS entries.
+ * The build uses growable arrays and then copies them into one block:
+ *
+ *   [SuggestTrie][nodes ...][ranked lists ...][labels ...]
+ */
+
+#include "../include/suggest_trie.h"
+#include "../include/catalog.h"
+#include "../include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t label;         // Edge label: labels[label .. label + label_length)
+    uint16_t label_length;
+    uint16_t child_count;   // Children are contiguous, ordered by first label byte
+    uint32_t first_child;
+    uint32_t top;           // Ranked list: tops[top .. top + top_count)
+    uint32_t top_count;
+} SuggestNode;
+
+struct SuggestTrie {
+    size_t size;            // Bytes in this allocation
+    uint32_t node_count;
+    const SuggestNode* nodes;   // nodes[0] is the root
+    const int* tops;        // Video indexes, most popular first per node
+    const char* labels;
+};
+
+typedef struct {
+    const char* text;       // Normalized title
+    int length;
+    int video;              // Catalog index
+} Entry;
+
+typedef struct {
+    const Entry* entries;   // Sorted bytewise
+    const int* views;
+    SuggestNode* nodes;
+    uint32_t node_count, node_capacity;
+    int* tops;              // Entry positions until the final copy
+    uint32_t top_count, top_capacity;
+    char* labels;
+    uint32_t label_size, label_capacity;
+} Builder;
+
+// ============================================================================
+// Normalization
+// ============================================================================
+
+/**
+ * ASCII lowercase and collapse whitespace runs to one space
+ * Leading whitespace is dropped; trailing whitespace too unless
+ * keep_trailing (a typed "money " should not complete to "moneyball").
+ * Returns: normalized length
+ */
+static int normalize(const char* text, char* out, size_t size, int keep_trailing) {
+    size_t length = 0;
+    int pending_space = 0;
+
+    for (const unsigned char* p = (const unsigned char*)text; *p && length + 1 < size; p++) {
+        unsigned char c = *p;
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            pending_space = length > 0;
+            continue;
+        }
+        if (pending_space && length + 2 < size) {
+            out[length++] = ' ';
+        }
+        pending_space = 0;
+        out[length++] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    if (pending_space && keep_trailing && length + 1 < size) {
+        out[length++] = ' ';
+    }
+    out[length] = '\0';
+    return (int)length;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const Entry* x = a;
+    const Entry* y = b;
+    int shorter = x->length < y->length ? x->length : y->length;
+
+    int order = memcmp(x->text, y->text, shorter);
+    if (order == 0) {
+        order = x->length - y->length;
+    }
+    return order != 0 ? order : x->video - y->video;
+}
+
+// ============================================================================
+// Build
+// ============================================================================
+
+/**
+ * Make room for n more items
+ * Returns: index of the first new item, or UINT32_MAX on allocation failure
+ */
+static uint32_t grow(void** array, uint32_t* count, uint32_t* capacity, uint32_t n, size_t item) {
+    if (*count + n > *capacity) {
+        uint32_t wanted = *capacity ? *capacity * 2 : 1024;
+        while (wanted < *count + n) {
+            wanted *= 2;
+        }
+        void* grown = realloc(*array, (size_t)wanted * item);
+        if (!grown) {
+            return UINT32_MAX;
+        }
+        *array = grown;
+        *capacity = wanted;
+    }
+
+    uint32_t first = *count;
+    *count += n;
+    return first;
+}
+
+/**
+ * Whether entry position a ranks above b (more views, then sort order)
+ */
+static int ranks_above(const Builder* b, int a, int c) {
+    int views_a = b->views ? b->views[b->entries[a].video] : 0;
+    int views_c = b->views ? b->views[b->entries[c].video] : 0;
+    return views_a != views_c ? views_a > views_c : a < c;
+}
+
+/**
+ * Insert an entry position into a ranked list of at most SUGGEST_MAX_RESULTS
+ */
+static void offer(const Builder* b, int* best, int* count, int position) {
+    int i = *count < SUGGEST_MAX_RESULTS ? (*count)++ : SUGGEST_MAX_RESULTS;
+    while (i > 0 && ranks_above(b, position, best[i - 1])) {
+        if (i < SUGGEST_MAX_RESULTS) {
+            best[i] = best[i - 1];
+        }
+        i--;
+    }
+    if (i < SUGGEST_MAX_RESULTS) {
+        best[i] = position;
+    }
+}
+
+/**
+ * Fill nodes[slot] for entries [lo, hi), which share their first `depth` bytes
+ * Returns: 0 on success, -1 on allocation failure
+ */
+static int build_node(Builder* b, uint32_t slot, int lo, int hi, int depth) {
+    const Entry* entries = b->entries;
+    const Entry* first = &entries[lo];
+    const Entry* last = &entries[hi - 1];
+
+    // Sorted range: its common prefix is the one of the first and last entries
+    int end = depth;
+    while (end < first->length && end < last->length && first->text[end] == last->text[end]) {
+        end++;
+    }
+
+    uint32_t label = grow((void**)&b->labels, &b->label_size, &b->label_capacity, end - depth, 1);
+    if (label == UINT32_MAX) {
+        return -1;
+    }
+    if (end > depth) {
+        memcpy(b->labels + label, first->text + depth, end - depth);
+    }
+
+    // Titles ending here, then one child per distinct next byte
+    int terminals = lo;
+    while (terminals < hi && entries[terminals].length == end) {
+        terminals++;
+    }
+
+    int child_count = 0;
+    for (int i = terminals; i < hi; child_count++) {
+        unsigned char c = entries[i].text[end];
+        while (i < hi && (unsigned char)entries[i].text[end] == c) {
+            i++;
+        }
+    }
+
+    uint32_t first_child = grow((void**)&b->nodes, &b->node_count, &b->node_capacity,
+                                child_count, sizeof(SuggestNode));
+    if (first_child == UINT32_MAX) {
+        return -1;
+    }
+
+    int best[SUGGEST_MAX_RESULTS];
+    int best_count = 0;
+    for (int i = lo; i < terminals; i++) {
+        offer(b, best, &best_count, i);
+    }
+
+    uint32_t child = first_child;
+    for (int i = terminals; i < hi; child++) {
+        unsigned char c = entries[i].text[end];
+        int j = i;
+        while (j < hi && (unsigned char)entries[j].text[end] == c) {
+            j++;
+        }
+        if (build_node(b, child, i, j, end) != 0) {
+            return -1;
+        }
+
+        const SuggestNode* built = &b->nodes[child];
+        for (uint32_t t = 0; t < built->top_count; t++) {
+            offer(b, best, &best_count, b->tops[built->top + t]);
+        }
+        i = j;
+    }
+
+    uint32_t top = grow((void**)&b->tops, &b->top_count, &b->top_capacity, best_count, sizeof(int));
+    if (top == UINT32_MAX) {
+        return -1;
+    }
+    if (best_count > 0) {
+        memcpy(b->tops + top, best, best_count * sizeof(int));
+    }
+
+    // Children may have moved the node array: index it only now
+    SuggestNode* node = &b->nodes[slot];
+    node->label = label;
+    node->label_length = (uint16_t)(end - depth);
+    node->child_count = (uint16_t)child_count;
+    node->first_child = first_child;
+    node->top = top;
+    node->top_count = best_count;
+    return 0;
+}
+
+/**
+ * Copy the build arrays into one allocation
+ */
+static SuggestTrie* pack(const Builder* b) {
+    size_t nodes_size = (size_t)b->node_count * sizeof(SuggestNode);
+    size_t tops_size = (size_t)b->top_count * sizeof(int);
+    size_t size = sizeof(SuggestTrie) + nodes_size + tops_size + b->label_size;
+
+    SuggestTrie* trie = malloc(size);
+    if (!trie) {
+        return NULL;
+    }
+
+    char* block = (char*)(trie + 1);
+    SuggestNode* nodes = (SuggestNode*)block;
+    int* tops = (int*)(block + nodes_size);
+    char* labels = block + nodes_size + tops_size;
+
+    memcpy(nodes, b->nodes, nodes_size);
+    for (uint32_t i = 0; i < b->top_count; i++) {
+        tops[i] = b->entries[b->tops[i]].video;
+    }
+    if (b->label_size > 0) {
+        memcpy(labels, b->labels, b->label_size);
+    }
+
+    trie->size = size;
+    trie->node_count = b->node_count;
+    trie->nodes = nodes;
+    trie->tops = tops;
+    trie->labels = labels;
+    return trie;
+}
+
+SuggestTrie* suggest_trie_build(const Catalog* catalog, const int* views) {
+    int count = catalog->video_count;
+    Entry* entries = malloc((count + 1) * sizeof(Entry));
+    char* text = malloc((size_t)count * sizeof(((Video*)0)->title) + 1);
+    if (!entries || !text) {
+        free(entries);
+        free(text);
+        return NULL;
+    }
+
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        entries[i].text = text + used;
+        entries[i].length = normalize(catalog->videos[i].title, text + used,
+                                      sizeof(catalog->videos[i].title), 0);
+        entries[i].video = i;
+        used += entries[i].length + 1;
+    }
+    qsort(entries, count, sizeof(Entry), compare_entries);
+
+    Builder b;
+    memset(&b, 0, sizeof(b));
+    b.entries = entries;
+    b.views = views;
+
+    SuggestTrie* trie = NULL;
+    uint32_t root = grow((void**)&b.nodes, &b.node_count, &b.node_capacity, 1, sizeof(SuggestNode));
+    if (root != UINT32_MAX) {
+        if (count == 0) {
+            memset(&b.nodes[root], 0, sizeof(SuggestNode));
+            trie = pack(&b);
+        } else if (build_node(&b, root, 0, count, 0) == 0) {
+            trie = pack(&b);
+        }
+    }
+
+    free(b.nodes);
+    free(b.tops);
+    free(b.labels);
+    free(text);
+    free(entries);
+    return trie;
+}
+
+void suggest_trie_free(SuggestTrie* trie) {
+    free(trie);
+}
+
+size_t suggest_trie_size(const SuggestTrie* trie) {
+    return trie ? trie->size : 0;
+}
+
+// ============================================================================
+// Lookup
+// ============================================================================
+
+/**
+ * Child of node whose label starts with byte c
+ * Returns: child, or NULL if none
+ */
+static const SuggestNode* find_child(const SuggestTrie* trie, const SuggestNode* node, unsigned char c) {
+    int low = 0;
+    int high = node->child_count - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        const SuggestNode* child = &trie->nodes[node->first_child + mid];
+        unsigned char first = (unsigned char)trie->labels[child->label];
+        if (first == c) {
+            return child;
+        }
+        if (first < c) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+int suggest_trie_lookup(const SuggestTrie* trie, const char* prefix, int* videos, int max_results) {
+    char normalized[sizeof(((Video*)0)->title) + 1];
+    int length = normalize(prefix, normalized, sizeof(normalized), 1);
+
+    // Walk the prefix: it may end inside a node's label
+    const SuggestNode* node = &trie->nodes[0];
+    int matched = 0;
+    while (1) {
+        int remaining = length - matched;
+        int compare = remaining < node->label_length ? remaining : node->label_length;
+        if (memcmp(trie->labels + node->label, normalized + matched, compare) != 0) {
+            return 0;
+        }
+        matched += compare;
+        if (matched == length) {
+            break;
+        }
+
+        node = find_child(trie, node, (unsigned char)normalized[matched]);
+        if (!node) {
+            return 0;
+        }
+    }
+
+    int count = (int)node->top_count < max_results ? (int)node->top_count : max_results;
+    memcpy(videos, trie->tops + node->top, count * sizeof(int));
+    return count;
+}
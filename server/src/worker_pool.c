@@ -0,0 +1,140 @@
+/*
+ * OTT Streaming Server - Worker Thread Pool
+ *
+ * Fixed-size ring buffer of jobs protected by a mutex/condition variable.
+ */
+
+#include "../include/worker_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct {
+    WorkerJob job;
+    void* arg;
+} QueuedJob;
+
+struct WorkerPool {
+    pthread_t* threads;
+    int num_threads;
+
+    QueuedJob* queue;           // Ring buffer of pending jobs
+    int capacity;
+    int head;                   // Next job to run
+    int count;                  // Jobs currently queued
+
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+};
+
+/**
+ * Worker thread main loop: pop and run jobs until the pool stops
+ */
+static void* worker_main(void* arg) {
+    WorkerPool* pool = (WorkerPool*)arg;
+
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+        }
+
+        if (pool->count == 0 && pool->stopping) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+
+        QueuedJob item = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        item.job(item.arg);
+    }
+
+    return NULL;
+}
+
+WorkerPool* worker_pool_create(int num_threads, int queue_capacity) {
+    if (num_threads <= 0 || queue_capacity <= 0) {
+        return NULL;
+    }
+
+    WorkerPool* pool = calloc(1, sizeof(WorkerPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->queue = calloc(queue_capacity, sizeof(QueuedJob));
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    if (!pool->queue || !pool->threads) {
+        free(pool->queue);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+
+    pool->capacity = queue_capacity;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            perror("pthread_create (worker pool)");
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        worker_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+int worker_pool_submit(WorkerPool* pool, WorkerJob job, void* arg) {
+    if (!pool || !job) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->stopping || pool->count == pool->capacity) {
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+
+    int tail = (pool->head + pool->count) % pool->capacity;
+    pool->queue[tail].job = job;
+    pool->queue[tail].arg = arg;
+    pool->count++;
+
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+void worker_pool_destroy(WorkerPool* pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->not_empty);
+    free(pool->queue);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,85 @@
+#!/bin/bash
+
+# OTT Streaming Server - Read Latency under Concurrent Writes
+# Measures /api/videos latency (p50/p95/p99) twice: on an idle server and
+# while background clients hammer POST /api/watch-progress. Run it against
+# two builds to compare SQLite storage settings.
+#
+# Usage: ./benchmark_db_contention.sh [reads] [writers]
+#   ./benchmark_db_contention.sh 2000 8
+
+SERVER_URL="${SERVER_URL:-http://localhost:8080}"
+NUM_READS="${1:-2000}"
+NUM_WRITERS="${2:-8}"
+READ_PATH="/api/videos"
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m'
+
+echo "========================================"
+echo "OTT Server - DB 경합 벤치마크"
+echo "========================================"
+echo "  Reads:   ${NUM_READS} x GET ${READ_PATH}"
+echo "  Writers: ${NUM_WRITERS} parallel POST /api/watch-progress"
+echo ""
+
+cookie=$(curl -s -i -d "username=alice&password=password123" "${SERVER_URL}/login" \
+         | grep -i "^Set-Cookie:" | sed 's/.*session_id=\([^;]*\).*/\1/')
+if [ -z "$cookie" ]; then
+    echo -e "${RED}✗ 로그인 실패 - 서버가 실행 중인지 확인해주세요${NC}"
+    exit 1
+fi
+
+read_config=$(mktemp)
+write_config=$(mktemp)
+writes_done=$(mktemp)
+trap 'rm -f "$read_config" "$write_config" "$writes_done"; kill $(jobs -p) 2>/dev/null' EXIT
+
+for i in $(seq 1 "$NUM_READS"); do
+    echo "url = \"${SERVER_URL}${READ_PATH}\"" >> "$read_config"
+    echo "output = /dev/null" >> "$read_config"
+done
+
+for i in $(seq 1 500); do
+    echo "url = \"${SERVER_URL}/api/watch-progress\"" >> "$write_config"
+    echo "data = \"{\\\"video_id\\\":1,\\\"position\\\":${i}}\"" >> "$write_config"
+    echo "output = /dev/null" >> "$write_config"
+done
+
+# Sequential reads, one latency sample (ms) per request
+measure_reads() {
+    curl -s --no-progress-meter -b "session_id=${cookie}" \
+         -w "%{time_total}\n" -K "$read_config" \
+        | awk '{ printf "%.3f\n", $1 * 1000 }' | sort -n \
+        | awk '{ v[NR] = $1 }
+               END {
+                   printf "  p50 %7.2f ms   p95 %7.2f ms   p99 %7.2f ms   max %7.2f ms\n",
+                          v[int(NR * 0.50)], v[int(NR * 0.95)], v[int(NR * 0.99)], v[NR]
+               }'
+}
+
+echo "[1] Idle server"
+measure_reads
+
+echo "[2] With ${NUM_WRITERS} concurrent writers"
+(
+    while true; do
+        curl -s --no-progress-meter --parallel --parallel-max "$NUM_WRITERS" \
+             -b "session_id=${cookie}" -H "Content-Type: application/json" \
+             -w "%{http_code}\n" -K "$write_config" >> "$writes_done"
+    done
+) &
+sleep 0.5
+start=$(date +%s%N)
+measure_reads
+end=$(date +%s%N)
+kill %1 2>/dev/null
+wait 2>/dev/null
+
+writes=$(grep -c "^200$" "$writes_done")
+failed=$(grep -v -c "^200$" "$writes_done")
+wps=$(awk -v n="$writes" -v ns="$((end - start))" 'BEGIN { printf "%.0f", n / (ns / 1e9) }')
+
+echo -e "${GREEN}  Writes:  ${writes} ok (~${wps}/s), ${failed} failed${NC}"
+echo "========================================"
@@ -0,0 +1,148 @@
+/*
+ * OTT Streaming Server - Request Body Parsing Micro-Benchmark
+ *
+ * Parses POST /api/watch-progress bodies as the player sends them
+ * ({"video_id":N,"position":N}, JSON.stringify output) with the previous
+ * strstr-based parse_json_int() lookups and with json_index_parse() plus
+ * json_index_int(), checks that both read the same values and prints
+ * the time per body. Also checks that bodies with malformed nested
+ * values are rejected.
+ *
+ * Build and run from server/:
+ *   make bench-json-parse BUILD_MODE=RELEASE
+ *   ./build/benchmark_json_parse [rounds]
+ */
+
+#include "../server/include/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#define BODY_COUNT 1024
+#define BODY_SIZE 64
+
+static char bodies[BODY_COUNT][BODY_SIZE];
+
+// Nested values are validated, not just bracket-matched
+static const struct {
+    const char* body;
+    int valid;
+} nested_cases[] = {
+    {"{\"a\":{\"b\":[1,2.5,-3e2,true,false,null,\"x\\u00e9\\n\"]},\"c\":[]}", 1},
+    {"{\"a\":[{}, [ ], {\"k\" : [ {\"z\":\"\"} ] }]}", 1},
+    {"{\"a\":[1 2]}", 0},
+    {"{\"a\":[1,]}", 0},
+    {"{\"a\":{\"b\"}}", 0},
+    {"{\"a\":{\"b\":1,}}", 0},
+    {"{\"a\":{b:1}}", 0},
+    {"{\"a\":[tru]}", 0},
+    {"{\"a\":[01x]}", 0},
+    {"{\"a\":[\"\\q\"]}", 0},
+    {"{\"a\":[\"\\u12g4\"]}", 0},
+    {"{\"a\":[}", 0},
+    {"{\"a\":[1]]}", 0},
+};
+
+/**
+ * Lookup before the tokenizer (reference, verbatim)
+ */
+static int parse_json_int(const char* json, const char* key) {
+    if (!json || !key) {
+        return -1;
+    }
+
+    // Create search pattern: "key":
+    char search_pattern[256];
+    snprintf(search_pattern, sizeof(search_pattern), "\"%s\":", key);
+
+    const char* pos = strstr(json, search_pattern);
+    if (!pos) {
+        return -1;
+    }
+
+    // Move past the key to the value
+    pos += strlen(search_pattern);
+
+    // Skip whitespace
+    while (*pos && isspace(*pos)) {
+        pos++;
+    }
+
+    // Parse integer
+    return atoi(pos);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 5000;
+
+    srand(42);
+    for (int i = 0; i < BODY_COUNT; i++) {
+        snprintf(bodies[i], BODY_SIZE, "{\"video_id\":%d,\"position\":%d}",
+                 1 + rand() % 5000, rand() % 7200);
+    }
+
+    // Same values from both parsers
+    for (int i = 0; i < BODY_COUNT; i++) {
+        JSONIndex index;
+        if (json_index_parse(&index, bodies[i], strlen(bodies[i])) != 0 ||
+            json_index_int(&index, "video_id", -1) != parse_json_int(bodies[i], "video_id") ||
+            json_index_int(&index, "position", -1) != parse_json_int(bodies[i], "position")) {
+            fprintf(stderr, "❌ Parsers disagree on %s\n", bodies[i]);
+            return 1;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(nested_cases) / sizeof(nested_cases[0]); i++) {
+        JSONIndex index;
+        const char* body = nested_cases[i].body;
+        int valid = json_index_parse(&index, body, strlen(body)) == 0;
+        if (valid != nested_cases[i].valid) {
+            fprintf(stderr, "❌ %s accepted as %s\n", body, valid ? "valid" : "invalid");
+            return 1;
+        }
+    }
+
+    printf("Watch-progress body parsing: %d bodies x %d rounds\n", BODY_COUNT, rounds);
+
+    long sum_old = 0;
+    double start = now_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < BODY_COUNT; i++) {
+            sum_old += parse_json_int(bodies[i], "video_id");
+            sum_old += parse_json_int(bodies[i], "position");
+        }
+    }
+    double old_time = now_seconds() - start;
+
+    long sum_new = 0;
+    start = now_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < BODY_COUNT; i++) {
+            // Handlers call strlen() on the NUL terminated body as well
+            JSONIndex index;
+            json_index_parse(&index, bodies[i], strlen(bodies[i]));
+            sum_new += json_index_int(&index, "video_id", -1);
+            sum_new += json_index_int(&index, "position", -1);
+        }
+    }
+    double new_time = now_seconds() - start;
+
+    double bodies_parsed = (double)BODY_COUNT * rounds;
+    printf("  strstr lookups (2 keys)    %6.1f ns/body\n", old_time * 1e9 / bodies_parsed);
+    printf("  json_index_parse + 2 keys  %6.1f ns/body\n", new_time * 1e9 / bodies_parsed);
+    printf("  speedup                    %6.2fx\n", old_time / new_time);
+
+    if (sum_old != sum_new) {
+        fprintf(stderr, "❌ Checksums differ\n");
+        return 1;
+    }
+    return 0;
+}
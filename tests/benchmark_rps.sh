@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# OTT Streaming Server - Requests-per-second Benchmark
+# Fires N requests at one endpoint with C parallel connections (curl --parallel)
+# and reports throughput. Run it against two builds to compare them.
+#
+# Usage: ./benchmark_rps.sh [path] [requests] [concurrency]
+#   ./benchmark_rps.sh /login 5000 8
+#   ./benchmark_rps.sh /api/genres 5000 8     (logs in as alice first)
+
+SERVER_URL="${SERVER_URL:-http://localhost:8080}"
+REQ_PATH="${1:-/login}"
+NUM_REQUESTS="${2:-2000}"
+CONCURRENCY="${3:-8}"
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m'
+
+echo "========================================"
+echo "OTT Server - RPS 벤치마크"
+echo "========================================"
+echo "  URL:         ${SERVER_URL}${REQ_PATH}"
+echo "  Requests:    ${NUM_REQUESTS}"
+echo "  Concurrency: ${CONCURRENCY}"
+echo ""
+
+# Log in so protected API routes can be measured too
+cookie=$(curl -s -i -d "username=alice&password=password123" "${SERVER_URL}/login" \
+         | grep -i "^Set-Cookie:" | sed 's/.*session_id=\([^;]*\).*/\1/')
+if [ -z "$cookie" ]; then
+    echo -e "${RED}✗ 로그인 실패 - 서버가 실행 중인지 확인해주세요${NC}"
+    exit 1
+fi
+
+# Build a curl config with one "url" line per request
+config=$(mktemp)
+trap 'rm -f "$config"' EXIT
+for i in $(seq 1 "$NUM_REQUESTS"); do
+    echo "url = \"${SERVER_URL}${REQ_PATH}\"" >> "$config"
+    echo "output = /dev/null" >> "$config"
+done
+
+start=$(date +%s%N)
+codes=$(curl -s --no-progress-meter --parallel --parallel-max "$CONCURRENCY" \
+             -b "session_id=${cookie}" -w "%{http_code}\n" -K "$config")
+end=$(date +%s%N)
+
+ok=$(echo "$codes" | grep -c -E "^(200|206|304)$")
+elapsed=$(awk -v ns="$((end - start))" 'BEGIN { printf "%.3f", ns / 1e9 }')
+rps=$(awk -v n="$NUM_REQUESTS" -v s="$elapsed" 'BEGIN { printf "%.0f", n / s }')
+
+printf "  Elapsed:     %.2f s\n" "$elapsed"
+printf "  Successful:  %d / %d\n" "$ok" "$NUM_REQUESTS"
+echo -e "${GREEN}  Throughput:  ${rps} req/s${NC}"
+echo "========================================"
@@ -0,0 +1,314 @@
+/*
+ * OTT Streaming Server - Title Search Micro-Benchmark
+ *
+ * Builds a synthetic catalog of mixed Korean/English titles, indexes it
+ * with search_index_build() (full build, then an incremental build that
+ * adds 1% new videos), and runs a set of queries with the previous
+ * linear title_contains() scan and with search_index_query(). Checks
+ * that both find the same titles and prints the time per query.
+ *
+ * Then builds the autocomplete trie with random view counts and times
+ * prefix lookups against a scan that sorts every matching title, which
+ * must return the same ranked list.
+ *
+ * Build and run from server/:
+ *   make bench-search BUILD_MODE=RELEASE
+ *   ./build/benchmark_search [titles] [rounds]
+ */
+
+#include "../server/include/catalog.h"
+#include "../server/include/search_index.h"
+#include "../server/include/suggest_trie.h"
+#include "../server/include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+
+static const char* korean_words[] = {
+    "사랑", "머니", "게임", "전쟁", "여행", "요리", "바다", "하늘", "도시", "비밀",
+    "시간", "우주", "학교", "가족", "친구", "겨울", "여름", "기억", "약속", "마지막",
+};
+
+static const char* english_words[] = {
+    "Money", "Game", "Love", "War", "City", "Night", "Secret", "Ocean", "Space", "Time",
+    "Planet", "Story", "Winter", "Summer", "Family", "Friends", "Kitchen", "Journey", "Dream", "Last",
+};
+
+static const char* queries[] = {
+    "머니", "사랑 이야기", "전", "마지막 약속", "game", "Ocean", "space time", "EP 12",
+    "x", "이", "zzz", "우주 Planet",
+};
+
+static const char* prefixes[] = {
+    "m", "머", "머니", "money g", "사랑 ", "the", "ocean sp", "zzz", "우주 planet", "여행 바다 ",
+};
+
+#define WORD_COUNT (int)(sizeof(korean_words) / sizeof(korean_words[0]))
+#define QUERY_COUNT (int)(sizeof(queries) / sizeof(queries[0]))
+#define PREFIX_COUNT (int)(sizeof(prefixes) / sizeof(prefixes[0]))
+
+static const Catalog* sort_catalog;
+static const int* sort_views;
+
+/**
+ * Substring test before the index (reference, verbatim)
+ */
+static int title_contains(const char* title, const char* query) {
+    size_t query_len = strlen(query);
+
+    for (const char* start = title; *start; start++) {
+        size_t i = 0;
+        while (i < query_len && start[i] &&
+               tolower((unsigned char)start[i]) == tolower((unsigned char)query[i])) {
+            i++;
+        }
+        if (i == query_len) {
+            return 1;
+        }
+    }
+    return query_len == 0;
+}
+
+/**
+ * Suggestion order: more views, then title bytewise (lowercase), then id
+ * Titles are generated already normalized apart from case.
+ */
+static int compare_suggestions(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    if (sort_views[x] != sort_views[y]) {
+        return sort_views[y] - sort_views[x];
+    }
+
+    const char* tx = sort_catalog->videos[x].title;
+    const char* ty = sort_catalog->videos[y].title;
+    for (; *tx && tolower((unsigned char)*tx) == tolower((unsigned char)*ty); tx++, ty++) {
+    }
+    int order = tolower((unsigned char)*tx) - tolower((unsigned char)*ty);
+    return order != 0 ? order : x - y;
+}
+
+/**
+ * Reference: collect every title starting with prefix and sort them all
+ * Returns: number of suggestions written (at most SUGGEST_MAX_RESULTS)
+ */
+static int scan_suggestions(const Catalog* catalog, const char* prefix, int* matches, int* out) {
+    size_t prefix_len = strlen(prefix);
+    int count = 0;
+
+    for (int i = 0; i < catalog->video_count; i++) {
+        if (strncasecmp(catalog->videos[i].title, prefix, prefix_len) == 0) {
+            matches[count++] = i;
+        }
+    }
+
+    sort_catalog = catalog;
+    qsort(matches, count, sizeof(int), compare_suggestions);
+
+    int kept = count < SUGGEST_MAX_RESULTS ? count : SUGGEST_MAX_RESULTS;
+    memcpy(out, matches, kept * sizeof(int));
+    return kept;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Fill videos[0 .. count) with titles of 2-4 words and an episode number
+ */
+static void make_titles(Video* videos, int count) {
+    srand(42);
+    for (int i = 0; i < count; i++) {
+        Video* video = &videos[i];
+        int words = 2 + rand() % 3;
+        size_t used = 0;
+
+        for (int w = 0; w < words; w++) {
+            const char* word = rand() % 2 ? korean_words[rand() % WORD_COUNT]
+                                          : english_words[rand() % WORD_COUNT];
+            used += snprintf(video->title + used, sizeof(video->title) - used, "%s%s",
+                             w ? " " : "", word);
+        }
+        if (rand() % 4 == 0) {
+            used += snprintf(video->title + used, sizeof(video->title) - used, " 이야기");
+        }
+        snprintf(video->title + used, sizeof(video->title) - used, " EP %d", 1 + rand() % 200);
+
+        video->video_id = i + 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int title_count = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    Catalog catalog;
+    memset(&catalog, 0, sizeof(catalog));
+    catalog.videos = calloc(title_count, sizeof(Video));
+    if (!catalog.videos) {
+        fprintf(stderr, "❌ Out of memory\n");
+        return 1;
+    }
+    make_titles(catalog.videos, title_count);
+
+    // Full build, then a snapshot that registers the last 1% as new videos
+    int base_count = title_count - title_count / 100;
+    catalog.video_count = base_count;
+    double start = now_seconds();
+    SearchIndex* base = search_index_build(&catalog, NULL);
+    double base_time = now_seconds() - start;
+
+    catalog.video_count = title_count;
+    start = now_seconds();
+    SearchIndex* index = search_index_build(&catalog, base);
+    double delta_time = now_seconds() - start;
+
+    start = now_seconds();
+    SearchIndex* full = search_index_build(&catalog, NULL);
+    double full_time = now_seconds() - start;
+
+    if (!base || !index || !full) {
+        fprintf(stderr, "❌ Index build failed\n");
+        return 1;
+    }
+    search_index_free(base);
+    search_index_free(full);
+
+    printf("Title search: %d titles, %d queries x %d rounds\n", title_count, QUERY_COUNT, rounds);
+    printf("  full build           %8.1f ms\n", full_time * 1e3);
+    printf("  build %d titles  %8.1f ms\n", base_count, base_time * 1e3);
+    printf("  + %d new titles    %8.1f ms (incremental)\n", title_count - base_count, delta_time * 1e3);
+
+    // Same matches from both: every title the scan finds, and nothing else
+    SearchHit* all_hits = malloc(title_count * sizeof(SearchHit));
+    char* found = calloc(title_count, 1);
+    for (int q = 0; q < QUERY_COUNT; q++) {
+        int total;
+        int hit_count = search_index_query(index, &catalog, queries[q], all_hits, title_count, &total);
+
+        memset(found, 0, title_count);
+        for (int h = 0; h < hit_count; h++) {
+            found[all_hits[h].index] = 1;
+        }
+
+        int expected = 0;
+        for (int i = 0; i < title_count; i++) {
+            int contains = title_contains(catalog.videos[i].title, queries[q]);
+            expected += contains;
+            if (contains != found[i]) {
+                fprintf(stderr, "❌ '%s': scan %s \"%s\", index does not\n", queries[q],
+                        contains ? "matches" : "skips", catalog.videos[i].title);
+                return 1;
+            }
+        }
+        if (total != expected || hit_count != expected) {
+            fprintf(stderr, "❌ '%s': %d matches, index reports %d\n", queries[q], expected, total);
+            return 1;
+        }
+    }
+
+    printf("  %-14s %8s %12s %12s\n", "query", "matches", "scan", "index");
+
+    double scan_sum = 0;
+    double index_sum = 0;
+    for (int q = 0; q < QUERY_COUNT; q++) {
+        int matches = 0;
+        start = now_seconds();
+        for (int r = 0; r < rounds; r++) {
+            matches = 0;
+            for (int i = 0; i < title_count; i++) {
+                matches += title_contains(catalog.videos[i].title, queries[q]);
+            }
+        }
+        double scan_time = (now_seconds() - start) / rounds;
+
+        SearchHit hits[SEARCH_MAX_RESULTS];
+        int total = 0;
+        start = now_seconds();
+        for (int r = 0; r < rounds; r++) {
+            search_index_query(index, &catalog, queries[q], hits, SEARCH_MAX_RESULTS, &total);
+        }
+        double index_time = (now_seconds() - start) / rounds;
+
+        if (total != matches) {
+            fprintf(stderr, "❌ '%s': totals differ\n", queries[q]);
+            return 1;
+        }
+
+        printf("  %-14s %8d %9.1f us %9.1f us\n", queries[q], matches,
+               scan_time * 1e6, index_time * 1e6);
+        scan_sum += scan_time;
+        index_sum += index_time;
+    }
+
+    printf("  mean                    %9.1f us %9.1f us (%.1fx)\n",
+           scan_sum * 1e6 / QUERY_COUNT, index_sum * 1e6 / QUERY_COUNT, scan_sum / index_sum);
+
+    // Autocomplete trie with random popularity
+    int* views = malloc(title_count * sizeof(int));
+    for (int i = 0; i < title_count; i++) {
+        views[i] = rand() % 1000;
+    }
+    sort_views = views;
+
+    start = now_seconds();
+    SuggestTrie* trie = suggest_trie_build(&catalog, views);
+    double trie_time = now_seconds() - start;
+    if (!trie) {
+        fprintf(stderr, "❌ Trie build failed\n");
+        return 1;
+    }
+
+    printf("Autocomplete: trie build %.1f ms, %zu KB in one block\n",
+           trie_time * 1e3, suggest_trie_size(trie) / 1024);
+    printf("  %-14s %8s %12s %12s\n", "prefix", "matches", "scan+sort", "trie");
+
+    int* matches = malloc(title_count * sizeof(int));
+    int suggest_rounds = rounds * 5000;
+    for (int p = 0; p < PREFIX_COUNT; p++) {
+        int expected[SUGGEST_MAX_RESULTS];
+        int actual[SUGGEST_MAX_RESULTS];
+
+        start = now_seconds();
+        int expected_count = 0;
+        for (int r = 0; r < rounds; r++) {
+            expected_count = scan_suggestions(&catalog, prefixes[p], matches, expected);
+        }
+        double scan_time = (now_seconds() - start) / rounds;
+
+        int actual_count = 0;
+        start = now_seconds();
+        for (int r = 0; r < suggest_rounds; r++) {
+            actual_count = suggest_trie_lookup(trie, prefixes[p], actual, SUGGEST_MAX_RESULTS);
+        }
+        double trie_time_per = (now_seconds() - start) / suggest_rounds;
+
+        if (actual_count != expected_count ||
+            memcmp(actual, expected, actual_count * sizeof(int)) != 0) {
+            fprintf(stderr, "❌ '%s': trie and scan rank different titles\n", prefixes[p]);
+            return 1;
+        }
+
+        int match_count = 0;
+        for (int i = 0; i < title_count; i++) {
+            match_count += strncasecmp(catalog.videos[i].title, prefixes[p], strlen(prefixes[p])) == 0;
+        }
+        printf("  %-14s %8d %9.1f us %9.3f us\n", prefixes[p], match_count,
+               scan_time * 1e6, trie_time_per * 1e6);
+    }
+
+    suggest_trie_free(trie);
+    free(matches);
+    free(views);
+    search_index_free(index);
+    free(found);
+    free(all_hits);
+    free(catalog.videos);
+    return 0;
+}
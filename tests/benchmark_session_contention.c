@@ -0,0 +1,234 @@
+/*
+ * OTT Streaming Server - Session Store Contention Benchmark
+ *
+ * Creates a store of twice the given number of sessions and fills half
+ * of it, then forks reader processes (prefork workers) that resolve
+ * random session IDs with get_user_id_from_session() as every
+ * authenticated request does, and optional writer processes that log in
+ * and out (create_session() + destroy_session()) at the same time.
+ * Readers check that every lookup returns the user the session was
+ * created for. Prints the aggregate lookups per second, the slowest
+ * login, and the time of one full sweep (cleanup_expired_sessions()).
+ * With 0 readers the writers alone are a login storm.
+ *
+ * Also times drawing a session ID's random bytes the previous way
+ * (fopen/fread/fclose of /dev/urandom per login) and from random_pool.h.
+ *
+ * With "tokens" as the last argument the same runs use stateless signed
+ * tokens (session_token.h): lookups verify an HMAC, logouts revoke.
+ *
+ * Build and run from server/:
+ *   make bench-sessions BUILD_MODE=RELEASE
+ *   ./build/benchmark_session_contention [processes] [seconds] [writers] [sessions] [table|tokens]
+ */
+
+#include "../server/include/server.h"
+#include "../server/include/session_token.h"
+#include "../server/include/random_pool.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+typedef struct {
+    long lookups;
+    long logins;
+    long failures;
+    double slowest_login;
+} WorkerResult;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define KEY_PATH "build/benchmark_session.key"
+#define ID_ROUNDS 200000
+
+/**
+ * Session ID bytes before the pool (reference, without the rand() fallback)
+ */
+static int urandom_key(unsigned char* key) {
+    FILE* urandom = fopen("/dev/urandom", "rb");
+    if (!urandom) {
+        return -1;
+    }
+    size_t bytes_read = fread(key, 1, SESSION_RANDOM_BYTES, urandom);
+    fclose(urandom);
+    return bytes_read == SESSION_RANDOM_BYTES ? 0 : -1;
+}
+
+static void run_reader(char (*ids)[SESSION_COOKIE_LENGTH], int count, double seconds, unsigned int seed,
+                       WorkerResult* result) {
+    double deadline = now_seconds() + seconds;
+    long lookups = 0;
+
+    while (1) {
+        // Check the clock every 1024 lookups
+        for (int i = 0; i < 1024; i++) {
+            seed = seed * 1103515245 + 12345;
+            int k = (seed >> 16) % count;
+            if (get_user_id_from_session(ids[k]) != 1000 + k) {
+                result->failures++;
+            }
+        }
+        lookups += 1024;
+        if (now_seconds() >= deadline) {
+            break;
+        }
+    }
+    result->lookups = lookups;
+}
+
+static void run_writer(double seconds, int writer, WorkerResult* result) {
+    double deadline = now_seconds() + seconds;
+    char session_id[SESSION_COOKIE_LENGTH];
+
+    // Keep the session log out of the results
+    if (!freopen("/dev/null", "w", stdout)) {
+        return;
+    }
+
+    while (1) {
+        double start = now_seconds();
+        if (start >= deadline) {
+            break;
+        }
+        if (!create_session(-1 - writer, "writer", session_id, sizeof(session_id))) {
+            result->failures++;
+            continue;
+        }
+        double elapsed = now_seconds() - start;
+        if (elapsed > result->slowest_login) {
+            result->slowest_login = elapsed;
+        }
+        destroy_session(session_id);
+        result->logins++;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int processes = argc > 1 ? atoi(argv[1]) : 32;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    int writers = argc > 3 ? atoi(argv[3]) : 0;
+    int count = argc > 4 ? atoi(argv[4]) : 50;
+    int tokens = argc > 5 && strcmp(argv[5], "tokens") == 0;
+
+    if (processes < 0 || writers < 0 || processes + writers < 1 || seconds <= 0 || count < 1 || count > SESSION_CAPACITY_LIMIT / 2) {
+        fprintf(stderr, "Usage: %s [processes] [seconds] [writers] [sessions] [table|tokens]\n", argv[0]);
+        return 1;
+    }
+
+    int workers = processes + writers;
+    WorkerResult* results = mmap(NULL, workers * sizeof(WorkerResult), PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        perror("mmap failed");
+        return 1;
+    }
+    memset(results, 0, workers * sizeof(WorkerResult));
+
+    init_session_store(count * 2, NULL);
+    if (tokens && session_token_init(KEY_PATH, NULL) != 0) {
+        return 1;
+    }
+
+    // Keep the session log out of the results while filling the store
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    char (*ids)[SESSION_COOKIE_LENGTH] = malloc((size_t)count * sizeof(*ids));
+    double fill_start = now_seconds();
+    for (int k = 0; k < count; k++) {
+        char username[32];
+        snprintf(username, sizeof(username), "user%d", k);
+        if (!create_session(1000 + k, username, ids[k], SESSION_COOKIE_LENGTH)) {
+            fprintf(stderr, "❌ create_session failed\n");
+            return 1;
+        }
+    }
+    double fill_time = now_seconds() - fill_start;
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    double start = now_seconds();
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork failed");
+            return 1;
+        }
+        if (pid == 0) {
+            if (w < processes) {
+                run_reader(ids, count, seconds, 7919u * (w + 1), &results[w]);
+            } else {
+                run_writer(seconds, w - processes, &results[w]);
+            }
+            _exit(0);
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+    double elapsed = now_seconds() - start;
+
+    WorkerResult total = {0, 0, 0, 0};
+    for (int w = 0; w < workers; w++) {
+        total.lookups += results[w].lookups;
+        total.logins += results[w].logins;
+        total.failures += results[w].failures;
+        if (results[w].slowest_login > total.slowest_login) {
+            total.slowest_login = results[w].slowest_login;
+        }
+    }
+
+    // Nothing has expired: this is the cost of scanning the whole table
+    double sweep_start = now_seconds();
+    cleanup_expired_sessions();
+    double sweep_time = now_seconds() - sweep_start;
+
+    printf("Session contention (%s): %d reader processes, %d writer processes, %.1f s, %d sessions\n",
+           tokens ? "tokens" : "table", processes, writers, seconds, count);
+    if (processes > 0) {
+        printf("  lookups   %12.0f /s  (%.0f /s per process)\n",
+               total.lookups / elapsed, total.lookups / elapsed / processes);
+    }
+    if (writers > 0) {
+        printf("  logins    %12.0f /s  (create + destroy, slowest create %.2f ms)\n",
+               total.logins / elapsed, total.slowest_login * 1e3);
+    }
+    printf("  fill      %12.1f ms  (%d creates)\n", fill_time * 1e3, count);
+    printf("  sweep     %12.1f ms  (all slots, %d per lock hold)\n", sweep_time * 1e3, SESSION_SWEEP_BATCH);
+
+    // Random bytes of one session ID: the previous way, then the pool
+    unsigned char key[SESSION_RANDOM_BYTES];
+    double id_start = now_seconds();
+    for (int i = 0; i < ID_ROUNDS; i++) {
+        total.failures += urandom_key(key) != 0;
+    }
+    double urandom_time = (now_seconds() - id_start) / ID_ROUNDS;
+
+    id_start = now_seconds();
+    for (int i = 0; i < ID_ROUNDS; i++) {
+        total.failures += random_bytes(key, sizeof(key)) != 0;
+    }
+    double pool_time = (now_seconds() - id_start) / ID_ROUNDS;
+
+    printf("  id bytes  %9.0f ns /dev/urandom, %.0f ns pool (%.0fx)\n",
+           urandom_time * 1e9, pool_time * 1e9, urandom_time / pool_time);
+
+    cleanup_session_store();
+    if (tokens) {
+        unlink(KEY_PATH);
+    }
+    free(ids);
+    munmap(results, workers * sizeof(WorkerResult));
+
+    if (total.failures > 0) {
+        fprintf(stderr, "❌ %ld lookups or logins failed\n", total.failures);
+        return 1;
+    }
+    return 0;
+}